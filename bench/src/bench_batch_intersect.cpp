@@ -0,0 +1,78 @@
+#include "bench_utils.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <nitro/batch_intersect.hpp>
+#include <nitro/partition_tree.hpp>
+#include <nitro/sweep_line.hpp>
+
+#include <algorithm>
+
+using namespace nitro;
+
+namespace {
+rectangles_list input(benchmark::State const& state)
+{
+    return state.range(0) == 0 ? bench::uniform_rectangles(state.range(1))
+                               : bench::concentric_rectangles(state.range(1));
+}
+
+void set_counters(benchmark::State& state, partition_tree::intersection_set const& set)
+{
+    std::size_t constituents = 0;
+    for (const auto& i : set)
+        constituents += i.constituents().size();
+    state.counters["intersections"] = static_cast<double>(set.size());
+    state.counters["constituents"]  = static_cast<double>(constituents);
+    state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * set.size()));
+}
+
+// the fold over rectangle::intersect calculate() used before the batch kernel
+void BM_fold_calculate(benchmark::State& state)
+{
+    sweep_line sl(input(state));
+    for (auto _ : state) {
+        for (const auto& i : sl.intersections()) {
+            const auto& rects  = i.constituents();
+            auto        result = std::make_optional(*rects.front()->root());
+            for (auto it = rng::next(rects.begin()); it != rects.end(); ++it)
+                result = rectangle::intersect(*(*it)->root(), result);
+            benchmark::DoNotOptimize(result);
+        }
+    }
+    set_counters(state, sl.intersections());
+}
+
+void BM_calculate(benchmark::State& state)
+{
+    sweep_line sl(input(state));
+    for (auto _ : state) {
+        for (const auto& i : sl.intersections())
+            benchmark::DoNotOptimize(i.calculate());
+    }
+    set_counters(state, sl.intersections());
+}
+
+void BM_calculate_all(benchmark::State& state)
+{
+    sweep_line sl(input(state));
+    for (auto _ : state)
+        benchmark::DoNotOptimize(partition_tree::calculate_all(sl.intersections()));
+    set_counters(state, sl.intersections());
+}
+
+// {0: uniform, 1: concentric} x rectangle count
+void arguments(benchmark::internal::Benchmark* b)
+{
+    b->ArgNames({ "concentric", "n" })
+        ->Args({ 0, 2000 })
+        ->Args({ 0, 20000 })
+        ->Args({ 1, 200 })
+        ->Args({ 1, 1000 })
+        ->Unit(benchmark::kMicrosecond);
+}
+}
+
+BENCHMARK(BM_fold_calculate)->Apply(arguments);
+BENCHMARK(BM_calculate)->Apply(arguments);
+BENCHMARK(BM_calculate_all)->Apply(arguments);
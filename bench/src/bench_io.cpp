@@ -0,0 +1,171 @@
+#include "bench_utils.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <nitro/binary_io.hpp>
+#include <nitro/io.hpp>
+#include <nitro/partition_tree.hpp>
+#include <nitro/sweep_line.hpp>
+#include <nitro/text_writer.hpp>
+
+#include <nlohmann/json.hpp>
+
+#include <filesystem>
+#include <fstream>
+#include <ostream>
+#include <sstream>
+#include <streambuf>
+#include <string>
+
+using namespace nitro;
+
+namespace {
+std::string json_text(std::size_t count)
+{
+    std::string text = "{\"rects\": [\n";
+    for (const auto& r : bench::uniform_rectangles(count)) {
+        text += (r.id() == 1 ? "" : ",\n");
+        text += "{\"x\": " + std::to_string(r.origin().x) + ", \"y\": "
+            + std::to_string(r.origin().y) + ", \"w\": " + std::to_string(r.width())
+            + ", \"h\": " + std::to_string(r.height()) + " }";
+    }
+    return text + "\n]}\n";
+}
+
+void set_counters(benchmark::State& state, std::string const& text)
+{
+    state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations() * text.size()));
+    state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * state.range(0)));
+}
+
+// the DOM is built in full before the rectangles are read out of it
+void BM_dom_parse(benchmark::State& state)
+{
+    const auto text = json_text(state.range(0));
+    for (auto _ : state)
+        benchmark::DoNotOptimize(to_rectangle_store(nlohmann::json::parse(text), state.range(0)));
+    set_counters(state, text);
+}
+
+void BM_sax_read(benchmark::State& state)
+{
+    const auto text = json_text(state.range(0));
+    for (auto _ : state)
+        benchmark::DoNotOptimize(read_rectangle_store(std::string_view(text), state.range(0)));
+    set_counters(state, text);
+}
+
+void BM_sax_read_stream(benchmark::State& state)
+{
+    const auto text = json_text(state.range(0));
+    for (auto _ : state) {
+        std::istringstream is(text);
+        benchmark::DoNotOptimize(read_rectangle_store(is, state.range(0)));
+    }
+    set_counters(state, text);
+}
+
+// maps a binary file written from the same rectangles and copies it into a store
+void BM_binary_load(benchmark::State& state)
+{
+    const auto path = std::filesystem::temp_directory_path() / "nitro_bench_load.bin";
+    {
+        std::ofstream ofs(path, std::ios::binary);
+        write_binary_rectangles(ofs, rectangle_store(bench::uniform_rectangles(state.range(0))));
+    }
+    for (auto _ : state)
+        benchmark::DoNotOptimize(to_rectangle_store(mapped_rectangles(path), state.range(0)));
+    state.SetBytesProcessed(
+        static_cast<std::int64_t>(state.iterations() * std::filesystem::file_size(path)));
+    state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * state.range(0)));
+    std::filesystem::remove(path);
+}
+
+// counts what is written to it and drops it, so that only the formatting is timed
+struct null_buffer : std::streambuf {
+    std::size_t bytes {};
+
+protected:
+    int_type overflow(int_type c) override
+    {
+        ++bytes;
+        return traits_type::not_eof(c);
+    }
+    std::streamsize xsputn(const char*, std::streamsize n) override
+    {
+        bytes += static_cast<std::size_t>(n);
+        return n;
+    }
+};
+
+// the output of nitro_app for clustered rectangles, which have many intersections each
+struct output_fixture {
+    explicit output_fixture(std::size_t count)
+        : engine(bench::clustered_rectangles(count))
+        , rects(bench::clustered_rectangles(count))
+        , areas(partition_tree::calculate_all(engine.intersections()))
+    {
+    }
+    sweep_line      engine;
+    rectangle_store rects;
+    rectangle_store areas;
+};
+
+void set_output_counters(
+    benchmark::State& state, output_fixture const& out, null_buffer const& sink)
+{
+    state.SetBytesProcessed(static_cast<std::int64_t>(sink.bytes));
+    state.SetItemsProcessed(static_cast<std::int64_t>(
+        state.iterations() * (out.rects.size() + out.engine.intersections().size())));
+}
+
+// every field through operator<< of std::ostream, as nitro_app printed before text_writer
+void BM_print_ostream(benchmark::State& state)
+{
+    const output_fixture out(state.range(0));
+    null_buffer          sink;
+    std::ostream         os(&sink);
+    for (auto _ : state) {
+        os << "Input:\n";
+        for (std::size_t i = 0; i < out.rects.size(); ++i)
+            os << out.rects.rect(i) << '\n';
+        os << "\nIntersections\n";
+        std::size_t row = 0;
+        for (const auto& i : out.engine.intersections()) {
+            os << "    Between rectangle ";
+            const auto c = i.constituents();
+            for (auto it = c.begin(); it != c.end(); ++it) {
+                os << (*it)->id();
+                if (rng::next(it) != c.end())
+                    os << (rng::next(it, 2) != c.end() ? ", " : " and ");
+            }
+            const auto r = out.areas.rect(row++);
+            os << " at " << r.origin() << ", w=" << r.width() << ", h=" << r.height() << ".\n";
+        }
+    }
+    set_output_counters(state, out, sink);
+}
+
+void BM_print_text_writer(benchmark::State& state)
+{
+    const output_fixture out(state.range(0));
+    null_buffer          sink;
+    std::ostream         os(&sink);
+    for (auto _ : state) {
+        text_writer w(os);
+        write_input(w, out.rects);
+        write_intersections(w, out.engine.intersections(), out.areas);
+    }
+    set_output_counters(state, out, sink);
+}
+}
+
+BENCHMARK(BM_dom_parse)->RangeMultiplier(10)->Range(1000, 100000)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_sax_read)->RangeMultiplier(10)->Range(1000, 100000)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_sax_read_stream)
+    ->RangeMultiplier(10)
+    ->Range(1000, 100000)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_binary_load)->RangeMultiplier(10)->Range(1000, 100000)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_print_ostream)->Arg(1000)->Arg(10000)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_print_text_writer)->Arg(1000)->Arg(10000)->Unit(benchmark::kMillisecond);
@@ -0,0 +1,73 @@
+#include "bench_utils.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <nitro/partition_tree.hpp>
+#include <nitro/rectangle_store.hpp>
+#include <nitro/sweep_line.hpp>
+
+#include <algorithm>
+#include <memory_resource>
+
+using namespace nitro;
+
+namespace {
+// installs the counting resource as the default one, which every container of the engines
+// allocates from, for the lifetime of the guard
+struct default_resource_guard {
+    explicit default_resource_guard(std::pmr::memory_resource* r)
+        : previous(std::pmr::set_default_resource(r))
+    {
+    }
+    ~default_resource_guard() { std::pmr::set_default_resource(previous); }
+    std::pmr::memory_resource* previous;
+};
+
+template <typename Engine, typename Input>
+void scaling(benchmark::State& state, Input make_input)
+{
+    bench::counting_resource res;
+    std::size_t              intersections {}, set_bytes {};
+    for (auto _ : state) {
+        state.PauseTiming();
+        default_resource_guard guard(&res);
+        auto                   input = make_input(state.range(0));
+        state.ResumeTiming();
+        Engine engine(std::move(input));
+        intersections = engine.intersections().size();
+        set_bytes     = engine.intersections().memory_usage();
+        benchmark::DoNotOptimize(intersections);
+    }
+    const auto n                      = static_cast<double>(state.range(0));
+    state.counters["intersections"]   = static_cast<double>(intersections);
+    state.counters["peak_bytes"]      = static_cast<double>(res.peak);
+    state.counters["peak_bytes_rect"] = static_cast<double>(res.peak) / n;
+    state.counters["set_bytes_isec"]  = static_cast<double>(set_bytes)
+        / static_cast<double>(std::max<std::size_t>(1, intersections));
+    state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations()) * state.range(0));
+}
+
+void BM_scaling_tree(benchmark::State& state)
+{
+    scaling<partition_tree>(
+        state, [](auto n) { return rectangle_store(bench::scaled_rectangles(n)); });
+}
+
+void BM_scaling_sweep(benchmark::State& state)
+{
+    scaling<sweep_line>(state, [](auto n) { return bench::scaled_rectangles(n); });
+}
+}
+
+// 10^3 .. 10^7 rectangles at a constant density, a single iteration each; the tree grows
+// superlinearly and stops at 10^6, where a run already takes minutes
+BENCHMARK(BM_scaling_tree)
+    ->RangeMultiplier(10)
+    ->Range(1000, 1000000)
+    ->Iterations(1)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_scaling_sweep)
+    ->RangeMultiplier(10)
+    ->Range(1000, 10000000)
+    ->Iterations(1)
+    ->Unit(benchmark::kMillisecond);
@@ -0,0 +1,141 @@
+#include "bench_utils.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <nitro/partition_tree.hpp>
+#include <nitro/sorting_and_orientation.hpp>
+#include <nitro/utils.hpp>
+
+#include <list>
+#include <set>
+#include <vector>
+
+using namespace nitro;
+
+namespace {
+// the node based container sorted_rectangles replaced, kept as the baseline
+using set_rectangles = std::pmr::set<rect_ptr, ordering_t>;
+
+auto pointers(rectangles_list const& rects)
+{
+    std::vector<rect_ptr> ptrs;
+    rng::copy(rects | views::transform(address_of_f {}), std::back_inserter(ptrs));
+    return ptrs;
+}
+
+void report(benchmark::State& state, bench::counting_resource const& res)
+{
+    const auto iterations         = static_cast<double>(state.iterations());
+    state.counters["allocs"]      = static_cast<double>(res.allocations) / iterations;
+    state.counters["alloc_bytes"] = static_cast<double>(res.bytes) / iterations;
+}
+
+void BM_set_construct(benchmark::State& state)
+{
+    const auto               rects = bench::uniform_rectangles(state.range(0));
+    const auto               ptrs  = pointers(rects);
+    bench::counting_resource res;
+    for (auto _ : state) {
+        set_rectangles s(ptrs.begin(), ptrs.end(), ordering_t { horizontal_sort {} }, &res);
+        benchmark::DoNotOptimize(s);
+    }
+    report(state, res);
+}
+
+void BM_flat_construct(benchmark::State& state)
+{
+    const auto               rects = bench::uniform_rectangles(state.range(0));
+    const auto               ptrs  = pointers(rects);
+    bench::counting_resource res;
+    for (auto _ : state) {
+        auto s = sorted<vertical>(ptrs, &res);
+        benchmark::DoNotOptimize(s);
+    }
+    report(state, res);
+}
+
+// the same construction with the ordering only known at runtime, as sorted<>() did before
+// sorted_rectangles was templated on the ordering: every comparison goes through std::visit
+void BM_variant_construct(benchmark::State& state)
+{
+    const auto               rects = bench::uniform_rectangles(state.range(0));
+    const auto               ptrs  = pointers(rects);
+    bench::counting_resource res;
+    for (auto _ : state) {
+        sorted_rectangles s(ptrs, ordering_t { horizontal_sort {} }, &res);
+        benchmark::DoNotOptimize(s);
+    }
+    report(state, res);
+}
+
+template <typename Container>
+void lower_bound_sweep(benchmark::State& state, Container const& s)
+{
+    for (auto _ : state) {
+        for (coordinate_t x = 0; x < 100000; x += 97)
+            benchmark::DoNotOptimize(s.lower_bound(x));
+    }
+}
+
+void BM_set_lower_bound(benchmark::State& state)
+{
+    const auto     rects = bench::uniform_rectangles(state.range(0));
+    const auto     ptrs  = pointers(rects);
+    set_rectangles s(ptrs.begin(), ptrs.end(), ordering_t { horizontal_sort {} });
+    lower_bound_sweep(state, s);
+}
+
+void BM_flat_lower_bound(benchmark::State& state)
+{
+    const auto rects = bench::uniform_rectangles(state.range(0));
+    const auto s     = sorted<vertical>(pointers(rects));
+    lower_bound_sweep(state, s);
+}
+
+// the split of a single partition_tree node at its split point, as it was done on the set
+void BM_set_split(benchmark::State& state)
+{
+    const auto               rects = bench::uniform_rectangles(state.range(0));
+    const auto               ptrs  = pointers(rects);
+    bench::counting_resource res;
+    set_rectangles s(ptrs.begin(), ptrs.end(), ordering_t { horizontal_sort {} }, &res);
+    const vertical           v { 50000 };
+    res.allocations = res.bytes = 0;
+    for (auto _ : state) {
+        const auto                from = s.lower_bound(v.val);
+        std::pmr::list<rectangle> rect_list(&res);
+        set_rectangles            below(s.key_comp(), &res);
+        set_rectangles            above(from, s.end(), s.key_comp(), &res);
+        for (auto it = s.begin(); it != from; ++it) {
+            auto [r_below, r_above] = (*it)->slice(v);
+            if (r_below)
+                below.insert(below.end(), &*rect_list.insert(rect_list.end(), *r_below));
+            if (r_above)
+                above.insert(above.begin(), &*rect_list.insert(rect_list.end(), *r_above));
+        }
+        benchmark::DoNotOptimize(above);
+    }
+    report(state, res);
+}
+
+void BM_flat_split(benchmark::State& state)
+{
+    const auto               rects = bench::uniform_rectangles(state.range(0));
+    bench::counting_resource res;
+    const auto               s = sorted<vertical>(pointers(rects), &res);
+    res.allocations = res.bytes = 0;
+    for (auto _ : state) {
+        auto sliced = partition_tree::slice(vertical { 50000 }, s);
+        benchmark::DoNotOptimize(sliced);
+    }
+    report(state, res);
+}
+}
+
+BENCHMARK(BM_set_construct)->RangeMultiplier(10)->Range(1000, 100000);
+BENCHMARK(BM_flat_construct)->RangeMultiplier(10)->Range(1000, 100000);
+BENCHMARK(BM_variant_construct)->RangeMultiplier(10)->Range(1000, 100000);
+BENCHMARK(BM_set_lower_bound)->RangeMultiplier(10)->Range(1000, 100000);
+BENCHMARK(BM_flat_lower_bound)->RangeMultiplier(10)->Range(1000, 100000);
+BENCHMARK(BM_set_split)->RangeMultiplier(10)->Range(1000, 100000);
+BENCHMARK(BM_flat_split)->RangeMultiplier(10)->Range(1000, 100000);
@@ -0,0 +1,182 @@
+#pragma once
+#include <nitro/fwd.hpp>
+#include <nitro/rectangle.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <memory_resource>
+#include <random>
+#include <vector>
+
+namespace bench {
+
+// forwards to an upstream resource while counting the calls, so that the benchmarks can report
+// the allocations per iteration next to the timings, and the largest amount held at once
+struct counting_resource : public std::pmr::memory_resource {
+    explicit counting_resource(
+        std::pmr::memory_resource* upstream = std::pmr::new_delete_resource())
+        : m_upstream(upstream)
+    {
+    }
+    std::size_t allocations {};
+    std::size_t bytes {};
+    std::size_t in_use {};
+    std::size_t peak {};
+
+private:
+    void* do_allocate(std::size_t n, std::size_t align) override
+    {
+        ++allocations;
+        bytes += n;
+        in_use += n;
+        peak = std::max(peak, in_use);
+        return m_upstream->allocate(n, align);
+    }
+    void do_deallocate(void* p, std::size_t n, std::size_t align) override
+    {
+        in_use -= n;
+        m_upstream->deallocate(p, n, align);
+    }
+    [[nodiscard]] bool do_is_equal(const std::pmr::memory_resource& o) const noexcept override
+    {
+        return this == &o;
+    }
+    std::pmr::memory_resource* m_upstream;
+};
+
+inline nitro::rectangles_list uniform_rectangles(std::size_t count, unsigned seed = 42)
+{
+    std::mt19937                                       gen(seed);
+    std::uniform_int_distribution<nitro::coordinate_t> pos(0, 100000);
+    std::uniform_int_distribution<nitro::coordinate_t> len(1, 5000);
+    nitro::rectangles_list                             rects;
+    for (std::size_t i = 1; i <= count; ++i)
+        rects.push_back(nitro::rectangle { { pos(gen), pos(gen) }, { len(gen), len(gen) }, i });
+    return rects;
+}
+
+// rectangles of 1..100 on a square growing with the count, so that the expected number of
+// rectangles covering a point, and so the intersections per rectangle, stay the same at any size
+inline nitro::rectangles_list scaled_rectangles(std::size_t count, unsigned seed = 42)
+{
+    const auto side = static_cast<nitro::coordinate_t>(50 * std::sqrt(static_cast<double>(count)));
+    std::mt19937                                       gen(seed);
+    std::uniform_int_distribution<nitro::coordinate_t> pos(0, side);
+    std::uniform_int_distribution<nitro::coordinate_t> len(1, 100);
+    nitro::rectangles_list                             rects;
+    for (std::size_t i = 1; i <= count; ++i)
+        rects.push_back(nitro::rectangle { { pos(gen), pos(gen) }, { len(gen), len(gen) }, i });
+    return rects;
+}
+
+
+// nested squares: n - 1 intersections of up to n constituents
+inline nitro::rectangles_list concentric_rectangles(std::size_t count)
+{
+    const auto             n = static_cast<nitro::coordinate_t>(count);
+    nitro::rectangles_list rects;
+    for (nitro::coordinate_t i = 0; i < n; ++i)
+        rects.push_back(nitro::rectangle { { i, i }, { 2 * (n - i) - 1, 2 * (n - i) - 1 },
+            static_cast<std::size_t>(i + 1) });
+    return rects;
+}
+
+// rectangles of 1..100 around a few dozen centers, normally distributed, so that dense spots
+// next to empty space make for unbalanced splits
+inline nitro::rectangles_list clustered_rectangles(std::size_t count, unsigned seed = 42)
+{
+    const auto side = static_cast<nitro::coordinate_t>(50 * std::sqrt(static_cast<double>(count)));
+    std::mt19937                                       gen(seed);
+    std::uniform_int_distribution<nitro::coordinate_t> center(0, side);
+    std::normal_distribution<double>                   offset(0, side / 40.0);
+    std::uniform_int_distribution<nitro::coordinate_t> len(1, 100);
+    std::vector<nitro::point>                          centers(32);
+    for (auto& c : centers)
+        c = { center(gen), center(gen) };
+    std::uniform_int_distribution<std::size_t> pick(0, centers.size() - 1);
+    nitro::rectangles_list                     rects;
+    for (std::size_t i = 1; i <= count; ++i) {
+        const auto c = centers[pick(gen)];
+        const auto x = c.x + static_cast<nitro::coordinate_t>(offset(gen));
+        const auto y = c.y + static_cast<nitro::coordinate_t>(offset(gen));
+        rects.push_back(nitro::rectangle { { x, y }, { len(gen), len(gen) }, i });
+    }
+    return rects;
+}
+
+// equal squares on a lattice, each overlapping its neighbours by half: every coordinate is
+// shared by many rectangles, which is where the orderings have to break ties
+inline nitro::rectangles_list grid_rectangles(std::size_t count)
+{
+    const auto columns = static_cast<std::size_t>(std::ceil(std::sqrt(static_cast<double>(count))));
+    nitro::rectangles_list rects;
+    for (std::size_t i = 0; i < count; ++i) {
+        const auto x = static_cast<nitro::coordinate_t>(i % columns) * 10;
+        const auto y = static_cast<nitro::coordinate_t>(i / columns) * 10;
+        rects.push_back(nitro::rectangle { { x, y }, { 20, 20 }, i + 1 });
+    }
+    return rects;
+}
+
+// long and thin rectangles, every other one lying across the ones before it, which makes for
+// wide rows and subtrees that can only be split along one axis
+inline nitro::rectangles_list strip_rectangles(std::size_t count, unsigned seed = 42)
+{
+    const auto side = static_cast<nitro::coordinate_t>(100 * std::sqrt(static_cast<double>(count)));
+    std::mt19937                                       gen(seed);
+    std::uniform_int_distribution<nitro::coordinate_t> pos(0, side);
+    std::uniform_int_distribution<nitro::coordinate_t> len(side / 40, side / 20);
+    std::uniform_int_distribution<nitro::coordinate_t> thickness(1, 10);
+    nitro::rectangles_list                             rects;
+    for (std::size_t i = 1; i <= count; ++i) {
+        const nitro::point origin { pos(gen), pos(gen) };
+        const auto         l = len(gen), t = thickness(gen);
+        rects.push_back(i % 2 ? nitro::rectangle { origin, { l, t }, i }
+                              : nitro::rectangle { origin, { t, l }, i });
+    }
+    return rects;
+}
+
+// the inputs the workload benchmarks run on
+enum class workload { uniform, clustered, concentric, grid, strips };
+inline constexpr std::array workloads { workload::uniform, workload::clustered,
+    workload::concentric, workload::grid, workload::strips };
+
+inline const char* name_of(workload w)
+{
+    switch (w) {
+    case workload::uniform:
+        return "uniform";
+    case workload::clustered:
+        return "clustered";
+    case workload::concentric:
+        return "concentric";
+    case workload::grid:
+        return "grid";
+    case workload::strips:
+        return "strips";
+    }
+    return "unknown";
+}
+
+// the same rectangles for the same workload and count on every run
+inline nitro::rectangles_list make_workload(workload w, std::size_t count)
+{
+    switch (w) {
+    case workload::uniform:
+        return uniform_rectangles(count);
+    case workload::clustered:
+        return clustered_rectangles(count);
+    case workload::concentric:
+        return concentric_rectangles(count);
+    case workload::grid:
+        return grid_rectangles(count);
+    case workload::strips:
+        return strip_rectangles(count);
+    }
+    return {};
+}
+
+}
@@ -0,0 +1,200 @@
+#include "bench_utils.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <nitro/io.hpp>
+#include <nitro/partition_tree.hpp>
+#include <nitro/rectangle_store.hpp>
+#include <nitro/sorting_and_orientation.hpp>
+#include <nitro/spatial_index.hpp>
+#include <nitro/tiled_tree.hpp>
+#include <nitro/utils.hpp>
+
+#include <nlohmann/json.hpp>
+
+#include <string>
+#include <vector>
+
+using namespace nitro;
+
+// Every hot path over every generated workload, registered as BM_<path>/<workload>/<count>.
+// The inputs are seeded, so runs of different versions compare, see the bench_json target.
+namespace {
+nlohmann::json json_of(rectangles_list const& rects)
+{
+    auto array = nlohmann::json::array();
+    for (const auto& r : rects)
+        array.push_back({ { "x", r.origin().x }, { "y", r.origin().y }, { "w", r.width() },
+            { "h", r.height() } });
+    return { { "rects", std::move(array) } };
+}
+
+auto pointers(rectangles_list const& rects)
+{
+    std::vector<rect_ptr> ptrs;
+    rng::copy(rects | views::transform(address_of_f {}), std::back_inserter(ptrs));
+    return ptrs;
+}
+
+void set_items(benchmark::State& state, std::size_t items)
+{
+    state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * items));
+}
+
+void BM_to_rectangles(benchmark::State& state, bench::workload w)
+{
+    const auto json = json_of(bench::make_workload(w, state.range(0)));
+    for (auto _ : state)
+        benchmark::DoNotOptimize(to_rectangles(json));
+    set_items(state, state.range(0));
+}
+
+void BM_sorted(benchmark::State& state, bench::workload w)
+{
+    const auto rects = bench::make_workload(w, state.range(0));
+    const auto ptrs  = pointers(rects);
+    for (auto _ : state)
+        benchmark::DoNotOptimize(sorted<vertical>(ptrs));
+    set_items(state, state.range(0));
+}
+
+// the first split of the build, at the split point of the whole input
+void BM_slice(benchmark::State& state, bench::workload w)
+{
+    const auto rects = bench::make_workload(w, state.range(0));
+    const auto s     = sorted<vertical>(pointers(rects));
+    const auto at    = vertical { partition_tree::split_point<vertical>(s) };
+    for (auto _ : state)
+        benchmark::DoNotOptimize(partition_tree::slice(at, s));
+    set_items(state, state.range(0));
+}
+
+void BM_build(benchmark::State& state, bench::workload w)
+{
+    const auto  rects = rectangle_store(bench::make_workload(w, state.range(0)));
+    std::size_t intersections {};
+    for (auto _ : state) {
+        partition_tree pt(rects);
+        intersections = pt.intersections().size();
+        benchmark::DoNotOptimize(intersections);
+    }
+    state.counters["intersections"] = static_cast<double>(intersections);
+    set_items(state, state.range(0));
+}
+
+// the same over a grid of 4 x 4 tiles
+void BM_build_tiled(benchmark::State& state, bench::workload w)
+{
+    const auto      rects = rectangle_store(bench::make_workload(w, state.range(0)));
+    const tile_grid grid(rects, 4, 4);
+    std::size_t     intersections {};
+    for (auto _ : state) {
+        tiled_tree tt(rects, grid);
+        intersections = tt.intersections().size();
+        benchmark::DoNotOptimize(intersections);
+    }
+    state.counters["intersections"] = static_cast<double>(intersections);
+    set_items(state, state.range(0));
+}
+
+// what an intersection_stream takes to the first 100 intersections, against BM_build for all
+void BM_stream_first(benchmark::State& state, bench::workload w)
+{
+    const auto rects = rectangle_store(bench::make_workload(w, state.range(0)));
+    for (auto _ : state) {
+        intersection_stream stream(rects);
+        for (const auto& found : stream | views::take(100))
+            benchmark::DoNotOptimize(found.area);
+    }
+    set_items(state, state.range(0));
+}
+
+// one rectangle of the input replaced, erased and inserted again, against BM_build for
+// rebuilding the tree; at 10000 rectangles that is a churn of one in 10k
+void BM_update(benchmark::State& state, bench::workload w)
+{
+    const auto     rects = bench::make_workload(w, state.range(0));
+    partition_tree pt(rects);
+    std::size_t    next {};
+    for (auto _ : state) {
+        const auto& r = rects[next++ % rects.size()];
+        pt.erase(r.id());
+        pt.insert(r);
+    }
+    state.counters["intersections"] = static_cast<double>(pt.intersections().size());
+    set_items(state, 1);
+}
+
+void BM_calculate(benchmark::State& state, bench::workload w)
+{
+    const partition_tree pt(bench::make_workload(w, state.range(0)));
+    for (auto _ : state) {
+        for (const auto& i : pt.intersections())
+            benchmark::DoNotOptimize(i.calculate());
+    }
+    state.counters["intersections"] = static_cast<double>(pt.intersections().size());
+    set_items(state, pt.intersections().size());
+}
+
+// the rectangles covering the centers of the input, one point after the other
+void BM_query(benchmark::State& state, bench::workload w)
+{
+    const auto                               rects = bench::make_workload(w, state.range(0));
+    const spatial_index                      index { rectangle_store(rects) };
+    std::vector<point>                       centers;
+    std::pmr::vector<spatial_index::index_t> found;
+    std::size_t                              hits {};
+    for (const auto& r : rects)
+        centers.push_back({ r.origin().x + r.width() / 2, r.origin().y + r.height() / 2 });
+    for (auto _ : state) {
+        for (const auto p : centers) {
+            index.covering(p, found);
+            hits += found.size();
+        }
+    }
+    benchmark::DoNotOptimize(hits);
+    set_items(state, centers.size());
+}
+
+// the same points as one batch
+void BM_query_batch(benchmark::State& state, bench::workload w)
+{
+    const auto          rects = bench::make_workload(w, state.range(0));
+    const spatial_index index { rectangle_store(rects) };
+    std::vector<point>  centers;
+    for (const auto& r : rects)
+        centers.push_back({ r.origin().x + r.width() / 2, r.origin().y + r.height() / 2 });
+    for (auto _ : state)
+        benchmark::DoNotOptimize(index.covering(centers));
+    set_items(state, centers.size());
+}
+
+// registers bench for every workload; the concentric one, with n - 1 intersections of up to n
+// rectangles, is run on fewer rectangles
+template <typename Bench> void add(std::string const& name, Bench bench)
+{
+    for (auto w : bench::workloads) {
+        auto b = benchmark::RegisterBenchmark(
+            (name + "/" + bench::name_of(w)).c_str(), [=](benchmark::State& s) { bench(s, w); });
+        if (w == bench::workload::concentric)
+            b->Arg(100)->Arg(1000);
+        else
+            b->Arg(1000)->Arg(10000);
+        b->Unit(benchmark::kMicrosecond);
+    }
+}
+
+const int registered = [] {
+    add("BM_to_rectangles", BM_to_rectangles);
+    add("BM_sorted", BM_sorted);
+    add("BM_slice", BM_slice);
+    add("BM_build", BM_build);
+    add("BM_build_tiled", BM_build_tiled);
+    add("BM_stream_first", BM_stream_first);
+    add("BM_update", BM_update);
+    add("BM_calculate", BM_calculate);
+    add("BM_query", BM_query);
+    add("BM_query_batch", BM_query_batch);
+    return 0;
+}();
+}
@@ -2,14 +2,32 @@
 #include "nitro/exceptions.hpp"
 #include "nitro/fwd.hpp"
 #include "nitro/rectangle.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <cstdlib>
+#include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <iterator>
 #include <nitro/nitro.hpp>
+#include <nitro/task_pool.hpp>
 
 #include <exception>
-#include <nlohmann/json_fwd.hpp>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <span>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <csignal>
+#endif
+
+#include <nlohmann/json.hpp>
 
 auto open_file(auto&& path)
 {
@@ -18,71 +36,429 @@ auto open_file(auto&& path)
     return ifs;
 }
 
-std::ostream& print_input(std::ostream& os, const nitro::rectangles_list rects)
+void print_help(int argc, char* argv[])
 {
-    os << "Input:\n";
-    for (const auto& r : rects)
-        os << r << '\n';
-    os << '\n';
-    return os;
+    std::cerr << "Usage: " << argv[0]
+              << " [--engine=<tree|sweep|tiles>] [--tiles=<n>] [--threads=<n>] [--max-rects=<n>] "
+                 "[--stats] [--anytime] <json or binary file> "
+                 "[<optional timeout value in seconds>]\n"
+              << "       " << argv[0] << " convert <json file> <binary file>\n"
+              << "       " << argv[0]
+              << " batch [--jobs=<n>] [--timeout=<seconds>] [<options as above>] "
+                 "<output directory> <input file or @manifest>...\n"
+              << "       " << argv[0]
+              << " serve [--jobs=<n>] [--threads=<n>] [--timeout=<seconds>] [--max-rects=<n>] "
+                 "<socket>\n"
+              << "       " << argv[0]
+              << " client [--timeout=<seconds>] <socket> <json or binary file>...\n"
+              << "       " << argv[0]
+              << " tile [--tiles=<n>] [--timeout=<seconds>] [--max-rects=<n>] "
+                 "<json or binary file> <tile> <tile file>\n"
+              << "       " << argv[0]
+              << " merge [--max-rects=<n>] <json or binary file> <tile file>...\n";
 }
 
-std::ostream& print_intersection(std::ostream& os, const nitro::partition_tree::intersection& i)
+struct app_options {
+    std::vector<std::string_view> positional;
+    std::string_view              engine { "tree" };
+    // columns and rows of the tiles engine
+    std::size_t                   tiles { 4 };
+    std::size_t                   threads { 1 };
+    std::size_t                   max_rects { nitro::unlimited };
+    bool                          stats {};
+    // keep what the tree found when the timeout passes
+    bool                          anytime {};
+    // inputs run at once by batch
+    std::size_t                   jobs { std::max(1u, std::thread::hardware_concurrency()) };
+    std::optional<nitro::partition_tree::secs> timeout;
+};
+
+auto get_options(int argc, char* argv[])
 {
-    const auto r = i.calculate();
+    app_options opts;
+    for (std::string_view arg : std::span(argv + 1, argc - 1)) {
+        if (!arg.starts_with("--")) {
+            opts.positional.push_back(arg);
+        } else if (arg.starts_with("--engine=")) {
+            opts.engine = arg.substr(arg.find('=') + 1);
+        } else if (arg.starts_with("--tiles=")) {
+            opts.tiles = std::max(1ul, std::stoul(std::string(arg.substr(arg.find('=') + 1))));
+        } else if (arg.starts_with("--threads=")) {
+            opts.threads = std::stoul(std::string(arg.substr(arg.find('=') + 1)));
+        } else if (arg.starts_with("--max-rects=")) {
+            opts.max_rects = std::stoull(std::string(arg.substr(arg.find('=') + 1)));
+        } else if (arg == "--stats") {
+            opts.stats = true;
+        } else if (arg == "--anytime") {
+            opts.anytime = true;
+        } else if (arg.starts_with("--jobs=")) {
+            opts.jobs = std::max(1ul, std::stoul(std::string(arg.substr(arg.find('=') + 1))));
+        } else if (arg.starts_with("--timeout=")) {
+            opts.timeout = nitro::partition_tree::secs { std::stoul(
+                std::string(arg.substr(arg.find('=') + 1))) };
+        } else {
+            throw nitro::invalid_arg("unknown option: " + std::string(arg));
+        }
+    }
+    if (opts.positional.empty())
+        throw nitro::invalid_arg("missing input file");
+    return opts;
+}
 
-    os << "    " << "Between rectangle ";
-    auto last_elem_it = std::prev(i.constituents().end());
-    for (auto it = i.constituents().begin(); it != i.constituents().end(); ++it) {
-        os << (*it)->id();
-        if (it != last_elem_it)
-            os << (std::next(it) != last_elem_it ? ", " : " and ");
+auto get_timeout(app_options const& opts)
+{
+    auto timeout = opts.timeout.value_or(nitro::partition_tree::default_timeout);
+    if (opts.positional.size() > 1) {
+        timeout = nitro::partition_tree::secs { std::stoul(std::string(opts.positional[1])) };
     }
-    os << " at " << r.origin() << ", w=" << r.width() << ", h=" << r.height() << '.';
-    return os;
+    return timeout;
+}
+
+// binary files are mapped, anything else is streamed as JSON
+nitro::rectangle_store load_rectangles(std::string const& path, std::size_t max_cnt,
+    nitro::rectangle_store::allocator_type alloc = {})
+{
+    auto ifs = open_file(path);
+    // the format probe may run into the end of a short file
+    ifs.exceptions(std::ifstream::badbit);
+    if (nitro::is_binary_rectangles(ifs))
+        return nitro::to_rectangle_store(nitro::mapped_rectangles(path), max_cnt, alloc);
+    return nitro::read_rectangle_store(ifs, max_cnt, alloc);
+}
+
+void convert(app_options const& opts)
+{
+    if (opts.positional.size() != 3)
+        throw nitro::invalid_arg("convert needs a JSON input and a binary output file");
+    auto       ifs   = open_file(std::string(opts.positional[1]));
+    const auto rects = nitro::read_rectangle_store(ifs, opts.max_rects);
+    std::ofstream ofs(std::string(opts.positional[2]), std::ios::binary);
+    ofs.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+    nitro::write_binary_rectangles(ofs, rects);
+    std::cout << "Converted " << rects.size() << " rectangles\n";
 }
 
-std::ostream& print_output(
-    std::ostream& os, const std::pmr::set<nitro::partition_tree::intersection>& interections)
+// the phase times and the counters of the build, if the engine has any, as JSON on stderr
+template <typename Engine>
+void print_stats(std::ostream& os, const nitro::phase_times& times, const Engine& engine)
 {
-    std::cout << "Intersections\n";
-    for (const auto& i : interections) {
-        print_intersection(std::cout, i);
-        os << '\n';
+    nlohmann::json stats { { "phases", times } };
+    if constexpr (requires { engine.stats(); })
+        stats["build"] = engine.stats();
+    if constexpr (requires { engine.complete(); })
+        stats["complete"] = engine.complete();
+    os << stats.dump(2) << '\n';
+}
+
+// false if the engine kept what it found when it reached its deadline, see --anytime
+template <typename Engine> bool is_complete(const Engine& engine)
+{
+    if constexpr (requires { engine.complete(); })
+        return engine.complete();
+    return true;
+}
+
+// the regions a partial build didn't get to, on stderr next to the intersections it found
+template <typename Engine> void print_unexplored(std::ostream& os, const Engine& engine)
+{
+    if constexpr (requires { engine.complete(); }) {
+        if (is_complete(engine))
+            return;
+        os << "Timed out, intersections are missing within:\n";
+        for (const auto& r : engine.unexplored()) {
+            os << "    " << r.bounds.origin() << ", w=" << r.bounds.width()
+               << ", h=" << r.bounds.height() << " (" << r.rects << " rectangles)\n";
+        }
     }
-    return os;
 }
 
-void print_help(int argc, char* argv[])
+// builds the engine the options ask for from rects and hands it to f
+template <typename F>
+void with_engine(app_options const& opts, nitro::phase_times& times, nitro::rectangle_store rects,
+    nitro::partition_tree::secs timeout, std::size_t threads, std::pmr::memory_resource* resource,
+    F&& f)
 {
-    std::cerr << "Usage: " << argv[0] << " <json file> [<optional timeout value in seconds>]\n";
+    if (opts.engine == "tree") {
+        using nitro::partition_tree;
+        const auto           mode   = opts.anytime ? partition_tree::on_deadline::keep_partial
+                                                   : partition_tree::on_deadline::raise;
+        const partition_tree engine = times.time("build", [&] {
+            return partition_tree(std::move(rects), timeout, threads, {}, resource, {}, mode);
+        });
+        f(engine);
+    } else if (opts.anytime) {
+        throw nitro::invalid_arg("--anytime needs the tree engine");
+    } else if (opts.engine == "sweep") {
+        const nitro::sweep_line engine = times.time("build",
+            [&] { return nitro::sweep_line(nitro::to_rectangles(rects), timeout, resource); });
+        f(engine);
+    } else if (opts.engine == "tiles") {
+        const nitro::tile_grid  grid(rects, opts.tiles, opts.tiles);
+        const nitro::tiled_tree engine = times.time("build", [&] {
+            return nitro::tiled_tree(std::move(rects), grid, timeout, threads, resource);
+        });
+        f(engine);
+    } else {
+        throw nitro::invalid_arg("unknown engine: " + std::string(opts.engine));
+    }
+}
+
+// the intersections of the engine with their areas, as the output lists them
+template <typename Engine>
+void write_results(std::ostream& os, nitro::phase_times& times, const Engine& engine,
+    std::pmr::memory_resource* resource)
+{
+    const auto& intersections = engine.intersections();
+    const auto  areas         = times.time("calculate",
+        [&] { return nitro::partition_tree::calculate_all(intersections, resource); });
+    times.time("print", [&] {
+        nitro::text_writer w(os);
+        nitro::write_intersections(w, intersections, areas);
+    });
 }
 
-auto get_timeout(int argc, char* argv[])
+// the inputs of a batch: the files given, and those listed one per line in the manifests given
+// as @<manifest>
+std::vector<std::filesystem::path> batch_inputs(std::span<const std::string_view> args)
 {
-    auto timeout = nitro::partition_tree::default_timeout;
-    if (argc > 2) {
-        timeout = nitro::partition_tree::secs { std::stoul(argv[2]) };
+    std::vector<std::filesystem::path> inputs;
+    for (auto arg : args) {
+        if (!arg.starts_with('@')) {
+            inputs.emplace_back(arg);
+            continue;
+        }
+        auto ifs = open_file(std::string(arg.substr(1)));
+        ifs.exceptions(std::ifstream::badbit);
+        for (std::string line; std::getline(ifs, line);) {
+            if (!line.empty())
+                inputs.emplace_back(line);
+        }
     }
-    return timeout;
+    return inputs;
+}
+
+// Runs every input of the batch as a job of its own on opts.jobs workers, writing the output of
+// each to <output directory>/<input file name>.txt. A worker keeps its memory pool from job to
+// job. A job failing is reported on stderr without stopping the others, its output removed, as
+// is one cut short by --anytime, its partial output kept. Returns how many of either there were.
+std::size_t batch(app_options const& opts)
+{
+    namespace fs = std::filesystem;
+    if (opts.positional.size() < 3)
+        throw nitro::invalid_arg("batch needs an output directory and at least one input");
+    const fs::path out_dir(opts.positional[1]);
+    const auto     inputs = batch_inputs(std::span(opts.positional).subspan(2));
+    std::set<fs::path> names;
+    for (const auto& input : inputs) {
+        if (!names.insert(input.filename()).second)
+            throw nitro::invalid_arg("inputs with the same file name: " + input.string());
+    }
+    fs::create_directories(out_dir);
+
+    const auto          timeout = opts.timeout.value_or(nitro::partition_tree::default_timeout);
+    nitro::thread_pools pools;
+    std::atomic_size_t  rects {}, intersections {}, failed {}, incomplete {};
+    std::mutex          errors_mx;
+    const auto          start = std::chrono::steady_clock::now();
+    const auto          job   = [&](fs::path const& input) {
+        const auto out = out_dir / input.filename().concat(".txt");
+        try {
+            const auto         resource = pools.for_threads(opts.threads);
+            nitro::phase_times times;
+            auto               store = load_rectangles(input.string(), opts.max_rects, resource);
+            std::ofstream      ofs(out, std::ios::binary);
+            ofs.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+            {
+                nitro::text_writer w(ofs);
+                nitro::write_input(w, store);
+            }
+            rects += store.size();
+            with_engine(opts, times, std::move(store), timeout, opts.threads, resource,
+                [&](auto const& engine) {
+                    write_results(ofs, times, engine, resource);
+                    intersections += engine.intersections().size();
+                    if (!is_complete(engine)) {
+                        std::lock_guard l(errors_mx);
+                        std::cerr << input.string() << ": ";
+                        print_unexplored(std::cerr, engine);
+                        ++incomplete;
+                    }
+                });
+        } catch (const std::exception& ex) {
+            std::error_code ec;
+            fs::remove(out, ec);
+            std::lock_guard l(errors_mx);
+            std::cerr << input.string() << ": " << ex.what() << '\n';
+            ++failed;
+        }
+    };
+    {
+        nitro::task_pool workers(opts.jobs);
+        workers.run([&] {
+            for (const auto& input : inputs)
+                workers.push([&] { job(input); });
+        });
+    }
+
+    const std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+    std::cout << "Processed " << inputs.size() << " files, " << failed << " failed, "
+              << incomplete << " incomplete, " << rects << " rectangles and " << intersections
+              << " intersections in " << seconds.count() << " s: "
+              << static_cast<double>(inputs.size()) / seconds.count() << " files/s, "
+              << static_cast<double>(rects) / seconds.count() << " rectangles/s\n";
+    return failed + incomplete;
+}
+
+// Serves the socket until SIGINT or SIGTERM, which only the main thread takes, waiting for them
+// while the server runs on a thread of its own.
+void serve(app_options const& opts)
+{
+    if (opts.positional.size() != 2)
+        throw nitro::invalid_arg("serve needs a socket path");
+#ifdef _WIN32
+    throw nitro::invalid_arg("serve needs Unix domain sockets");
+#else
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+    nitro::server_options server_opts;
+    server_opts.workers   = opts.jobs;
+    server_opts.threads   = opts.threads;
+    server_opts.timeout   = opts.timeout.value_or(nitro::partition_tree::default_timeout);
+    server_opts.max_rects = opts.max_rects;
+    nitro::server server(std::string(opts.positional[1]), server_opts);
+    std::jthread  runner([&](std::stop_token stop) { server.run(stop); });
+    std::cerr << "Serving at " << opts.positional[1] << '\n';
+    int signal {};
+    sigwait(&signals, &signal);
+    std::cerr << "Stopping ...\n";
+#endif
+}
+
+// Sends every input to the server at once and prints the answers in order; returns how many
+// requests failed.
+std::size_t client(app_options const& opts)
+{
+    if (opts.positional.size() < 3)
+        throw nitro::invalid_arg("client needs a socket path and at least one input");
+    // 0 leaves it to the server
+    const auto timeout = static_cast<std::uint32_t>(
+        opts.timeout.value_or(nitro::partition_tree::secs {}).count());
+    const auto    inputs = std::span(opts.positional).subspan(2);
+    nitro::client connection(std::string(opts.positional[1]));
+    for (auto input : inputs) {
+        auto ifs = open_file(std::string(input));
+        ifs.exceptions(std::ifstream::badbit);
+        const auto format = nitro::is_binary_rectangles(ifs) ? nitro::input_format::binary
+                                                             : nitro::input_format::json;
+        const std::string bytes(std::istreambuf_iterator<char>(ifs), {});
+        connection.send(std::as_bytes(std::span(bytes)), format, timeout);
+    }
+    std::size_t failed = 0;
+    for (auto input : inputs) {
+        const auto answer = connection.receive();
+        if (answer.status == nitro::response_status::ok) {
+            std::cout << answer.text;
+        } else {
+            std::cerr << input << ": " << answer.text << '\n';
+            ++failed;
+        }
+    }
+    return failed;
+}
+
+// Builds one tile of the input as the tiles engine would and writes what it found to a tile
+// file, for merge to put together; the tiles of an input can so be built by separate processes,
+// each holding no more than the input and its tile.
+void tile(app_options const& opts)
+{
+    if (opts.positional.size() != 4)
+        throw nitro::invalid_arg("tile needs an input, the number of the tile and a tile file");
+    const auto rects = load_rectangles(std::string(opts.positional[1]), opts.max_rects);
+    const nitro::tile_grid grid(rects, opts.tiles, opts.tiles);
+    const auto             i    = std::stoul(std::string(opts.positional[2]));
+    const auto             part = nitro::build_tile(rects, grid, i,
+        opts.timeout.value_or(nitro::partition_tree::default_timeout));
+    std::ofstream          ofs(std::string(opts.positional[3]), std::ios::binary);
+    ofs.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+    nitro::write_tile_intersections(ofs, part);
+    std::cout << "Tile " << i << " of " << grid.size() << ": " << part.size()
+              << " intersections\n";
+}
+
+// Merges the tile files of every tile of the input, printing what a run over the whole of it
+// prints.
+void merge(app_options const& opts)
+{
+    if (opts.positional.size() < 3)
+        throw nitro::invalid_arg("merge needs an input and at least one tile file");
+    nitro::thread_pools pools;
+    const auto          resource = pools.local();
+    nitro::phase_times  times;
+    auto                rects = times.time("parse",
+        [&] { return load_rectangles(std::string(opts.positional[1]), opts.max_rects); });
+    std::vector<nitro::tile_intersections> parts;
+    for (auto path : std::span(opts.positional).subspan(2)) {
+        auto ifs = open_file(std::string(path));
+        ifs.exceptions(std::ifstream::badbit);
+        parts.push_back(nitro::read_tile_intersections(ifs));
+    }
+    times.time("print", [&] {
+        nitro::text_writer w(std::cout);
+        nitro::write_input(w, rects);
+    });
+    const nitro::tiled_tree engine = times.time(
+        "build", [&] { return nitro::tiled_tree(std::move(rects), parts, resource); });
+    write_results(std::cout, times, engine, resource);
+    if (opts.stats)
+        print_stats(std::cerr, times, engine);
 }
 
 int main(int argc, char* argv[])
 try {
-    if (argc < 2)
-        throw nitro::invalid_arg("missing JSON file input");
-    const auto timeout = get_timeout(argc, argv);
-
-    auto ifs          = open_file(argv[1]);
-    auto jtext        = nlohmann::json::parse(ifs);
-    auto old_resource = std::pmr::get_default_resource();
-    auto pool         = nitro::get_default_memory_resource(old_resource);
-    std::pmr::set_default_resource(&pool);
-    auto rects = nitro::to_rectangles(jtext);
-    print_input(std::cout, rects);
-    nitro::partition_tree pt(std::move(rects), timeout);
-    auto                  interections = pt.intersections();
-    print_output(std::cout, interections);
+    const auto opts = get_options(argc, argv);
+    if (opts.positional[0] == "convert") {
+        convert(opts);
+        return 0;
+    }
+    if (opts.positional[0] == "batch")
+        return batch(opts) == 0 ? 0 : -1;
+    if (opts.positional[0] == "serve") {
+        serve(opts);
+        return 0;
+    }
+    if (opts.positional[0] == "client")
+        return client(opts) == 0 ? 0 : -1;
+    if (opts.positional[0] == "tile") {
+        tile(opts);
+        return 0;
+    }
+    if (opts.positional[0] == "merge") {
+        merge(opts);
+        return 0;
+    }
+    const auto timeout = get_timeout(opts);
+
+    // the engine allocates from pools of its own, the global default resource is left alone
+    nitro::thread_pools pools;
+    const auto          resource = pools.for_threads(opts.threads);
+    nitro::phase_times  times;
+    auto                rects = times.time("parse",
+        [&] { return load_rectangles(std::string(opts.positional[0]), opts.max_rects); });
+    times.time("print", [&] {
+        nitro::text_writer w(std::cout);
+        nitro::write_input(w, rects);
+    });
+    with_engine(opts, times, std::move(rects), timeout, opts.threads, resource,
+        [&](auto const& engine) {
+            write_results(std::cout, times, engine, resource);
+            print_unexplored(std::cerr, engine);
+            if (opts.stats)
+                print_stats(std::cerr, times, engine);
+        });
     return 0;
 
 } catch (const std::exception& ex) {
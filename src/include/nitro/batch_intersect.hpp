@@ -0,0 +1,31 @@
+#pragma once
+
+#include <nitro/fwd.hpp>
+#include <nitro/rectangle.hpp>
+#include <nitro/rectangle_store.hpp>
+
+#include <optional>
+#include <span>
+
+namespace nitro {
+
+// Bounds of the common part of many segments along one axis: the largest origin and the smallest
+// far end (origin + extent). The segments overlap when first < last; over no segment at all the
+// bounds are the whole coordinate range.
+struct overlap_bounds {
+    coordinate_t first, last;
+};
+
+// reduces the two columns in one pass, with std::experimental::simd where the standard library
+// has it (unless built with NITRO_NO_SIMD), otherwise with a plain loop left to the vectorizer
+[[nodiscard]] overlap_bounds overlap(
+    std::span<const coordinate_t> origins, std::span<const coordinate_t> extents) noexcept;
+
+// common area of the rectangles given column by column, nullopt if there are none or any two of
+// them are disjoint; same result as folding them with rectangle::intersect
+[[nodiscard]] std::optional<rectangle> intersect(std::span<const coordinate_t> xs,
+    std::span<const coordinate_t> ys, std::span<const coordinate_t> widths,
+    std::span<const coordinate_t> heights);
+[[nodiscard]] std::optional<rectangle> intersect(rectangle_store const& rows);
+
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include <nitro/fwd.hpp>
+#include <nitro/io.hpp>
+#include <nitro/rectangle.hpp>
+#include <nitro/rectangle_store.hpp>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <istream>
+#include <ostream>
+#include <span>
+
+namespace nitro {
+
+// Binary rectangle files, little endian throughout:
+//   header   magic "NITRORCT", u32 version, u32 flags, u64 count
+//   columns  count int64 x, then y, w and h
+//   ids      count u64, only with flags & binary_header::has_ids, otherwise ids are 1..count;
+//            above 0 and distinct
+// Every column starts 8 byte aligned, so a mapped file is used in place.
+struct binary_header {
+    static constexpr std::array<char, 8> magic_value { 'N', 'I', 'T', 'R', 'O', 'R', 'C', 'T' };
+    static constexpr std::uint32_t       current_version = 1;
+    static constexpr std::uint32_t       has_ids         = 1;
+
+    std::array<char, 8> magic;
+    std::uint32_t       version;
+    std::uint32_t       flags;
+    std::uint64_t       count;
+};
+static_assert(sizeof(binary_header) == 24);
+
+// true if the stream starts with the binary magic, the read position is left untouched
+[[nodiscard]] bool is_binary_rectangles(std::istream& is);
+
+// writes the rows of the store, with the id column only when the ids differ from 1..n
+void write_binary_rectangles(std::ostream& os, rectangle_store const& store);
+
+// Read-only mapping of a binary rectangle file, exposing the columns in place: opening costs
+// one pass checking the extents and the ids, no element is copied or allocated unless the ids
+// aren't ascending, which are then sorted in a copy to find duplicates. Throws invalid_arg on a
+// malformed file, zero or duplicate ids included, and std::system_error when the file can't be
+// mapped.
+struct mapped_rectangles {
+    explicit mapped_rectangles(std::filesystem::path const& path);
+    mapped_rectangles(const mapped_rectangles&) = delete;
+    mapped_rectangles(mapped_rectangles&& other) noexcept;
+    mapped_rectangles& operator=(const mapped_rectangles&) = delete;
+    mapped_rectangles& operator=(mapped_rectangles&& other) noexcept;
+    ~mapped_rectangles();
+
+    [[nodiscard]] std::size_t size() const noexcept { return m_x.size(); }
+    [[nodiscard]] bool        empty() const noexcept { return m_x.empty(); }
+    [[nodiscard]] bool        has_ids() const noexcept { return !m_id.empty(); }
+
+    [[nodiscard]] std::span<const coordinate_t>  xs() const noexcept { return m_x; }
+    [[nodiscard]] std::span<const coordinate_t>  ys() const noexcept { return m_y; }
+    [[nodiscard]] std::span<const coordinate_t>  widths() const noexcept { return m_w; }
+    [[nodiscard]] std::span<const coordinate_t>  heights() const noexcept { return m_h; }
+    // empty without an id column
+    [[nodiscard]] std::span<const std::uint64_t> ids() const noexcept { return m_id; }
+
+    [[nodiscard]] std::size_t id(std::size_t i) const noexcept
+    {
+        return has_ids() ? static_cast<std::size_t>(m_id[i]) : i + 1;
+    }
+    [[nodiscard]] rectangle rect(std::size_t i) const
+    {
+        return rectangle { { m_x[i], m_y[i] }, { m_w[i], m_h[i] }, id(i) };
+    }
+
+private:
+    void unmap() noexcept;
+
+    void*                          m_data {};
+    std::size_t                    m_bytes {};
+    std::span<const coordinate_t>  m_x, m_y, m_w, m_h;
+    std::span<const std::uint64_t> m_id;
+};
+
+// copies the first max_cnt rows column by column into a store
+[[nodiscard]] rectangle_store to_rectangle_store(mapped_rectangles const& mapped,
+    size_t max_cnt = unlimited, rectangle_store::allocator_type alloc = {});
+// the same for the bytes of a binary rectangle file in memory, which have to be 8 byte aligned
+[[nodiscard]] rectangle_store to_rectangle_store(std::span<const std::byte> bytes,
+    size_t max_cnt = unlimited, rectangle_store::allocator_type alloc = {});
+
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <nitro/exceptions.hpp>
+#include <optional>
+#include <stop_token>
+
+namespace nitro {
+
+// When an engine has to give up: once the timeout has passed since the deadline was set, on the
+// steady clock so that adjusting the wall clock doesn't move it, or once stop is requested on the
+// token, whichever comes first. The token is how a service cancels a build from another thread,
+// keeping the std::stop_source it was taken from.
+struct deadline {
+    using clock = std::chrono::steady_clock;
+
+    // never passes
+    deadline() = default;
+    explicit deadline(std::optional<clock::duration> timeout, std::stop_token stop = {});
+
+    // reads the clock
+    [[nodiscard]] bool passed() const noexcept;
+    // throws cancelled if stop was requested, else timeout if the time is up
+    void check() const;
+
+private:
+    std::optional<clock::time_point> m_end;
+    std::stop_token                  m_stop;
+};
+
+// Polls a deadline from a hot loop: only every check_interval-th poll checks it, the others
+// cost a decrement. The first poll always checks. Not shared between threads, every thread
+// polls through its own.
+struct deadline_poller {
+    static constexpr std::uint32_t check_interval = 64;
+
+    explicit deadline_poller(deadline const& d) noexcept
+        : m_deadline(d)
+    {
+    }
+
+    // throws as deadline::check() does
+    void poll()
+    {
+        if (expired())
+            m_deadline.check();
+    }
+    // for loops that stop rather than throw
+    [[nodiscard]] bool expired() noexcept
+    {
+        if (--m_left != 0)
+            return false;
+        m_left = check_interval;
+        return m_deadline.passed();
+    }
+
+private:
+    deadline const& m_deadline;
+    std::uint32_t   m_left = 1;
+};
+
+}
@@ -8,4 +8,8 @@ struct invalid_arg : public std::invalid_argument {
 struct timeout : public std::runtime_error {
     using std::runtime_error::runtime_error;
 };
+// stop was requested on the token an engine was built with
+struct cancelled : public std::runtime_error {
+    using std::runtime_error::runtime_error;
+};
 }
\ No newline at end of file
@@ -14,12 +14,14 @@ using coordinate_t = int64_t;
 
 struct point;
 struct rectangle;
+struct rectangle_store;
 
 struct vertical;
 struct rev_vertical;
 struct horizontal;
 struct rev_horizontal;
 struct partition_tree;
+struct sweep_line;
 
 using rect_ptr = gsl::not_null<rectangle const*>;
 
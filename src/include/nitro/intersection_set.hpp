@@ -0,0 +1,219 @@
+#pragma once
+
+#include <nitro/fwd.hpp>
+#include <nitro/rectangle.hpp>
+#include <nitro/rectangle_store.hpp>
+
+#include <compare>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory_resource>
+#include <ranges>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace nitro {
+
+// An overlap between rectangles, seen through the storage of the intersection_set holding it:
+// the constituents are indices of the engine's root rectangles, sorted by their id. Cheap to
+// copy, valid as long as the set and the roots are.
+struct intersection {
+    using index_t = rectangle_store::index_t;
+
+    static constexpr auto id_comp() noexcept
+    {
+        return [](auto&& lhs, auto&& rhs) { return lhs->id() < rhs->id(); };
+    }
+    static constexpr auto to_id() noexcept
+    {
+        return [](auto&& t) { return t->id(); };
+    }
+
+    intersection(std::span<const index_t> members, std::span<const rect_ptr> roots) noexcept
+        : m_members(members)
+        , m_roots(roots)
+    {
+    }
+
+    // the root indices of the constituents
+    [[nodiscard]] std::span<const index_t> members() const noexcept { return m_members; }
+    // the constituents ordered by id; iterators refer to the returned view, so keep it around
+    // while iterating
+    [[nodiscard]] auto constituents() const noexcept
+    {
+        return m_members | views::transform([roots = m_roots](index_t i) { return roots[i]; });
+    }
+
+    // by size first, then lexicographically by the ids of the constituents
+    bool operator<(const intersection& other) const noexcept;
+    bool operator==(const intersection& other) const noexcept;
+
+    // the common area of the constituents, throws std::logic_error if there is none
+    [[nodiscard]] rectangle calculate() const;
+    // the same, gathering the coordinates into buffer, which can be reused over many calls
+    [[nodiscard]] rectangle calculate(std::pmr::vector<coordinate_t>& buffer) const;
+
+private:
+    std::span<const index_t>  m_members;
+    std::span<const rect_ptr> m_roots;
+};
+
+// The distinct intersections found by an engine. The constituents of all of them are stored as
+// runs of 32 bit root indices back to back in one arena, deduplicated through an open addressing
+// index over the hash of their ids; an intersection costs its indices plus about 30 bytes.
+// Iterates in insertion order until sort() puts it into the order of intersection::operator<.
+struct intersection_set {
+    using index_t        = intersection::index_t;
+    using value_type     = intersection;
+    using size_type      = std::size_t;
+    using allocator_type = std::pmr::polymorphic_allocator<>;
+
+    // random access over the intersections, yielding them by value
+    struct iterator {
+        using iterator_category = std::input_iterator_tag;
+        using iterator_concept  = std::random_access_iterator_tag;
+        using value_type        = intersection;
+        using difference_type   = std::ptrdiff_t;
+        using reference         = intersection;
+        struct pointer {
+            intersection        value;
+            intersection const* operator->() const noexcept { return &value; }
+        };
+
+        iterator() = default;
+        iterator(intersection_set const* set, std::size_t pos) noexcept
+            : m_set(set)
+            , m_pos(pos)
+        {
+        }
+
+        reference operator*() const noexcept { return m_set->at(m_set->m_order[m_pos]); }
+        pointer   operator->() const noexcept { return { **this }; }
+        reference operator[](difference_type n) const noexcept { return *(*this + n); }
+
+        iterator& operator++() noexcept { return *this += 1; }
+        iterator  operator++(int) noexcept { return std::exchange(*this, *this + 1); }
+        iterator& operator--() noexcept { return *this -= 1; }
+        iterator  operator--(int) noexcept { return std::exchange(*this, *this - 1); }
+        iterator& operator+=(difference_type n) noexcept
+        {
+            m_pos = static_cast<std::size_t>(static_cast<difference_type>(m_pos) + n);
+            return *this;
+        }
+        iterator& operator-=(difference_type n) noexcept { return *this += -n; }
+
+        friend iterator operator+(iterator it, difference_type n) noexcept { return it += n; }
+        friend iterator operator+(difference_type n, iterator it) noexcept { return it += n; }
+        friend iterator operator-(iterator it, difference_type n) noexcept { return it -= n; }
+        friend difference_type operator-(iterator const& lhs, iterator const& rhs) noexcept
+        {
+            return static_cast<difference_type>(lhs.m_pos)
+                - static_cast<difference_type>(rhs.m_pos);
+        }
+        friend bool operator==(iterator const& lhs, iterator const& rhs) noexcept
+        {
+            return lhs.m_pos == rhs.m_pos;
+        }
+        friend auto operator<=>(iterator const& lhs, iterator const& rhs) noexcept
+        {
+            return lhs.m_pos <=> rhs.m_pos;
+        }
+
+    private:
+        intersection_set const* m_set {};
+        std::size_t             m_pos {};
+    };
+    using const_iterator         = iterator;
+    using reverse_iterator       = std::reverse_iterator<iterator>;
+    using const_reverse_iterator = reverse_iterator;
+
+    // constituents are indices into roots, which has to outlive the set
+    explicit intersection_set(std::span<const rect_ptr> roots = {}, allocator_type alloc = {});
+
+    // Zobrist key of a rectangle id; the hash of an intersection is the sum of the keys of its
+    // constituents, so it can be summed up in any order while they are enumerated
+    [[nodiscard]] static constexpr std::uint64_t id_key(std::uint64_t id) noexcept
+    {
+        // splitmix64 finalizer
+        id += 0x9e3779b97f4a7c15;
+        id = (id ^ (id >> 30)) * 0xbf58476d1ce4e5b9;
+        id = (id ^ (id >> 27)) * 0x94d049bb133111eb;
+        return id ^ (id >> 31);
+    }
+
+    [[nodiscard]] std::size_t               size() const noexcept { return m_hashes.size(); }
+    [[nodiscard]] bool                      empty() const noexcept { return m_hashes.empty(); }
+    [[nodiscard]] std::span<const rect_ptr> roots() const noexcept { return m_roots; }
+    [[nodiscard]] allocator_type get_allocator() const noexcept { return m_ids.get_allocator(); }
+    // bytes held by the set, for every intersection together
+    [[nodiscard]] std::size_t memory_usage() const noexcept;
+
+    [[nodiscard]] iterator         begin() const noexcept { return { this, 0 }; }
+    [[nodiscard]] iterator         end() const noexcept { return { this, size() }; }
+    [[nodiscard]] reverse_iterator rbegin() const noexcept { return reverse_iterator(end()); }
+    [[nodiscard]] reverse_iterator rend() const noexcept { return reverse_iterator(begin()); }
+
+    // the i-th intersection inserted
+    [[nodiscard]] intersection at(std::size_t i) const noexcept
+    {
+        return { std::span(m_ids).subspan(m_offsets[i], m_offsets[i + 1] - m_offsets[i]), m_roots };
+    }
+
+    // adds the intersection of the given roots unless the set has it already, true if added;
+    // members is sorted by id and cleared of repeated ids in place, throws invalid_arg if
+    // fewer than two distinct ids remain
+    bool insert(std::span<index_t> members);
+    // adds every intersection of other, which has to refer to the same roots
+    void merge(intersection_set const& other);
+    // true if same_as holds for any of the intersections with the hash, only those are compared
+    template <typename Pred> [[nodiscard]] bool contains(std::uint64_t hash, Pred&& same_as) const
+    {
+        if (m_slots.empty())
+            return false;
+        const auto mask = m_slots.size() - 1;
+        for (auto slot = hash & mask; m_slots[slot] != 0; slot = (slot + 1) & mask) {
+            const auto i = m_slots[slot] - 1;
+            if (m_hashes[i] == hash && same_as(at(i)))
+                return true;
+        }
+        return false;
+    }
+    // removes the intersections pred holds for, the others keeping their order; compacts the
+    // arena and rebuilds the index, a pass over the whole set. Returns how many were removed.
+    template <typename Pred> std::size_t erase_if(Pred&& pred)
+    {
+        std::pmr::vector<std::uint8_t> erased(size(), 0, m_order.get_allocator());
+        for (std::size_t i = 0; i < size(); ++i)
+            erased[i] = pred(at(i)) ? 1 : 0;
+        return erase(erased);
+    }
+    // the roots moved or grew, the indices in the set staying valid
+    void rebind(std::span<const rect_ptr> roots) noexcept { m_roots = roots; }
+    // makes every intersection with the root at index from refer to the one at to instead,
+    // which has to have the same id
+    void replace_root(index_t from, index_t to) noexcept;
+    // puts the intersections into the order of intersection::operator<
+    void sort();
+    // the same, the first sorted of them being in that order already
+    void sort(std::size_t sorted);
+
+private:
+    bool        insert_run(std::uint64_t hash, std::span<const index_t> members);
+    std::size_t erase(std::span<const std::uint8_t> erased);
+    void        grow();
+    void        reindex(std::size_t slots);
+
+    std::span<const rect_ptr> m_roots;
+    // the runs of constituents back to back, the i-th one being [m_offsets[i], m_offsets[i + 1])
+    std::pmr::vector<index_t>       m_ids;
+    std::pmr::vector<std::size_t>   m_offsets;
+    std::pmr::vector<std::uint64_t> m_hashes;
+    // the index, 1 + the intersection in a slot or 0 for an empty one; a power of two in size
+    std::pmr::vector<std::uint32_t> m_slots;
+    // the iteration order, as intersection numbers
+    std::pmr::vector<std::uint32_t> m_order;
+};
+
+}
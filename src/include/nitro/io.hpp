@@ -1,16 +1,35 @@
 #pragma once
 #include <nitro/fwd.hpp>
 #include <nitro/rectangle.hpp>
+#include <nitro/rectangle_store.hpp>
 
 #include <nlohmann/json.hpp>
 #include <nlohmann/json_fwd.hpp>
 
+#include <istream>
+#include <limits>
 #include <ostream>
+#include <string_view>
 #include <vector>
 namespace nitro {
 
-[[nodiscard]] rectangle                 to_rectangle(nlohmann::json, std::size_t id = 0);
-[[nodiscard]] std::pmr::list<rectangle> to_rectangles(nlohmann::json, size_t max_cnt = 1000);
+// max_cnt of the readers below: keep every rectangle of the input
+inline constexpr std::size_t unlimited = std::numeric_limits<std::size_t>::max();
+
+[[nodiscard]] rectangle       to_rectangle(nlohmann::json, std::size_t id = 0);
+[[nodiscard]] rectangles_list to_rectangles(nlohmann::json, size_t max_cnt = unlimited);
+[[nodiscard]] rectangle_store to_rectangle_store(nlohmann::json, size_t max_cnt = unlimited);
+// every row of the store as a root, ids kept
+[[nodiscard]] rectangles_list to_rectangles(rectangle_store const& store);
+
+// Streaming counterparts of to_rectangle_store: the SAX parser feeds the rectangles of the
+// top level "rects" array straight into the store, so no DOM is ever built and memory scales
+// with the rectangles kept rather than with the text. Other keys are skipped, parsing stops
+// after max_cnt rectangles. Malformed input throws invalid_arg.
+[[nodiscard]] rectangle_store read_rectangle_store(std::istream& is, size_t max_cnt = unlimited,
+    rectangle_store::allocator_type alloc = {});
+[[nodiscard]] rectangle_store read_rectangle_store(std::string_view text,
+    size_t max_cnt = unlimited, rectangle_store::allocator_type alloc = {});
 
 std::ostream& operator<<(std::ostream& os, const point& p);
 std::ostream& operator<<(std::ostream& os, const rectangle& p);
@@ -1,14 +1,98 @@
 #pragma once
 
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
 #include <memory_resource>
 
 namespace nitro {
 
+// pool sizes fitting the small vectors of the engines
+inline std::pmr::pool_options default_pool_options() noexcept
+{
+    return { .max_blocks_per_chunk = 65536, .largest_required_pool_block = 1024 };
+}
+
 inline auto get_default_memory_resource(
     std::pmr::memory_resource* upstream = std::pmr::get_default_resource())
 {
-    std::pmr::pool_options opts { .max_blocks_per_chunk = 65536,
-        .largest_required_pool_block                    = 1024 };
-    return std::pmr::unsynchronized_pool_resource(opts, upstream);
+    return std::pmr::unsynchronized_pool_resource(default_pool_options(), upstream);
+}
+
+// what went through a stats_resource so far
+struct memory_stats {
+    std::size_t allocations {};
+    std::size_t deallocations {};
+    // bytes allocated in total
+    std::size_t bytes_allocated {};
+    // bytes allocated and not given back yet
+    std::size_t bytes_in_use {};
+    // the most bytes in use at any time
+    std::size_t peak_bytes {};
+};
+
+// Forwards to upstream, counting allocations and bytes on the way. The counters are atomic, so
+// it's as thread safe as upstream is; a peak raced by two threads may be missed by a few bytes.
+struct stats_resource : std::pmr::memory_resource {
+    explicit stats_resource(
+        std::pmr::memory_resource* upstream = std::pmr::new_delete_resource()) noexcept
+        : m_upstream(upstream)
+    {
+    }
+
+    [[nodiscard]] memory_stats               stats() const noexcept;
+    [[nodiscard]] std::pmr::memory_resource* upstream() const noexcept { return m_upstream; }
+    // zeroes the counters but bytes_in_use, the peak starting over from it
+    void reset() noexcept;
+
+private:
+    void* do_allocate(std::size_t bytes, std::size_t align) override;
+    void  do_deallocate(void* p, std::size_t bytes, std::size_t align) override;
+    [[nodiscard]] bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+    {
+        return this == &other;
+    }
+
+    std::pmr::memory_resource* m_upstream;
+    std::atomic_size_t         m_allocations {};
+    std::atomic_size_t         m_deallocations {};
+    std::atomic_size_t         m_bytes {};
+    std::atomic_size_t         m_in_use {};
+    std::atomic_size_t         m_peak {};
+};
+
+// Memory for a multi-threaded process that doesn't touch the global default resource: an
+// unsynchronized pool per thread for memory allocated and released by that very thread, as by
+// an engine built with a single thread, and a synchronized pool shared by all of them for memory
+// crossing threads. All pools take from upstream, which has to be thread safe. The pool of a
+// thread is released when the thread exits, the others together with the thread_pools.
+struct thread_pools {
+    explicit thread_pools(std::pmr::memory_resource* upstream = std::pmr::new_delete_resource(),
+        std::pmr::pool_options opts = default_pool_options());
+    thread_pools(const thread_pools&) = delete;
+    thread_pools& operator=(const thread_pools&) = delete;
+
+    // the pool of the calling thread, created on the first call from it and looked up without
+    // a lock afterwards; must not be used by any other thread, nor outlive the calling one
+    [[nodiscard]] std::pmr::memory_resource* local();
+    // the pool any thread may use
+    [[nodiscard]] std::pmr::memory_resource* shared() noexcept { return &m_shared; }
+    // the pool for an engine built on that many threads
+    [[nodiscard]] std::pmr::memory_resource* for_threads(std::size_t threads)
+    {
+        return threads < 2 ? local() : shared();
+    }
+
+    // the pools of the threads, which a thread leaves on exit as long as they are around
+    struct local_pools;
+
+private:
+    std::pmr::memory_resource*           m_upstream;
+    std::pmr::pool_options               m_opts;
+    std::pmr::synchronized_pool_resource m_shared;
+    std::shared_ptr<local_pools>         m_local;
+    // tells the thread_pools apart from one destroyed before at the same address
+    std::uint64_t                        m_generation;
+};
 }
-}
\ No newline at end of file
@@ -1,6 +1,16 @@
 #pragma once
+#include <nitro/batch_intersect.hpp>
+#include <nitro/binary_io.hpp>
 #include <nitro/fwd.hpp>
+#include <nitro/intersection_set.hpp>
 #include <nitro/io.hpp>
 #include <nitro/partition_tree.hpp>
 #include <nitro/rectangle.hpp>
+#include <nitro/rectangle_store.hpp>
+#include <nitro/server.hpp>
+#include <nitro/spatial_index.hpp>
+#include <nitro/sweep_line.hpp>
 #include <nitro/memory_resource.hpp>
+#include <nitro/stats.hpp>
+#include <nitro/text_writer.hpp>
+#include <nitro/tiled_tree.hpp>
@@ -1,97 +1,237 @@
 #pragma once
 
 #include <chrono>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <nitro/deadline.hpp>
 #include <nitro/exceptions.hpp>
 #include <nitro/fwd.hpp>
+#include <nitro/intersection_set.hpp>
 #include <nitro/rectangle.hpp>
+#include <nitro/rectangle_store.hpp>
 #include <nitro/sorting_and_orientation.hpp>
+#include <nitro/stats.hpp>
 #include <nitro/utils.hpp>
 
+#include <memory>
+#include <memory_resource>
 #include <numeric>
+#include <optional>
+#include <span>
+#include <stop_token>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 #include <gsl/gsl-lite.hpp>
 
 namespace nitro {
 
-using slice_t = std::tuple<rectangles_list, sorted_rectangles, sorted_rectangles>;
+// the rows below and the ones above the slicing line
+template <typename Orientation>
+using slice_t = std::pair<sorted_rectangles_of_t<Orientation>, sorted_rectangles_of_t<Orientation>>;
 
 struct partition_tree {
     using secs  = std::chrono::seconds;
-    using clock = std::chrono::system_clock;
+    using clock = deadline::clock;
     using tp    = clock::time_point;
     static constexpr secs default_timeout { 60 };
 
-    static bool is_homogeneous(sorted_rectangles const&);
-    explicit partition_tree(rectangles_list lst, std::optional<secs> timeout = {});
+    // state of the build, handed to the progress callback every progress_interval subtrees
+    struct progress {
+        // subtrees taken off the work stacks so far, over all threads
+        std::size_t subtrees;
+        // subtrees waiting on the work stack of the reporting thread
+        std::size_t pending;
+    };
+    using progress_callback = std::function<void(progress const&)>;
+    static constexpr std::size_t progress_interval = 4096;
+    // the most subtrees pending on one work stack. Each slice leaves one behind and at least
+    // halves the span of the coordinates its orientation sorts by, which no slice widens, so
+    // there are at most as many slices on the way to a subtree as that span has bits, for each
+    // of the four orientations.
+    static constexpr std::size_t max_pending_subtrees
+        = 4 * std::numeric_limits<std::make_unsigned_t<coordinate_t>>::digits + 1;
+
+    // what the build does once its deadline passes: throw timeout or cancelled, dropping the
+    // intersections found so far, or stop and keep them, see complete()
+    enum class on_deadline { raise, keep_partial };
+    // a subtree the build didn't get to, by the bounding box of its rows and their number; the
+    // intersections within it are missing from a partial result
+    struct region {
+        rectangle   bounds;
+        std::size_t rects;
+    };
+
+    template <typename Ordering> static bool is_homogeneous(sorted_rectangles<Ordering> const&);
+    // threads > 1 builds the tree on a work-stealing task_pool of that size; on_progress is
+    // called from the building threads, one at a time. The rectangles, rows and intersections
+    // are allocated from resource, which the building threads only reach through a synchronized
+    // pool, so it needs no locking of its own (see thread_pools in nitro/memory_resource.hpp).
+    // The build throws timeout once timeout has passed since construction, and cancelled soon
+    // after stop is requested on the token, unless mode is keep_partial.
+    explicit partition_tree(rectangles_list lst, std::optional<secs> timeout = {},
+        std::size_t threads = 1, progress_callback on_progress = {},
+        std::pmr::memory_resource* resource = std::pmr::get_default_resource(),
+        std::stop_token stop = {}, on_deadline mode = on_deadline::raise);
+    // the rows of the store are taken as the roots, the rectangles list being rebuilt from them
+    explicit partition_tree(rectangle_store store, std::optional<secs> timeout = {},
+        std::size_t threads = 1, progress_callback on_progress = {},
+        std::pmr::memory_resource* resource = std::pmr::get_default_resource(),
+        std::stop_token stop = {}, on_deadline mode = on_deadline::raise);
     partition_tree(const partition_tree&) = delete;
     partition_tree(partition_tree&&)      = delete;
     partition_tree& operator=(const partition_tree&) = delete;
     partition_tree& operator=(partition_tree&&) = delete;
 
-    static slice_t slice(horizontal, sorted_rectangles const&);
-    static slice_t slice(vertical, sorted_rectangles const&);
-    static slice_t slice(rev_vertical, sorted_rectangles const&);
-    static slice_t slice(rev_horizontal, sorted_rectangles const&);
+    static slice_t<horizontal> slice(horizontal, sorted_rectangles_of_t<horizontal> const&);
+    static slice_t<vertical> slice(vertical, sorted_rectangles_of_t<vertical> const&);
+    static slice_t<rev_vertical> slice(rev_vertical, sorted_rectangles_of_t<rev_vertical> const&);
+    static slice_t<rev_horizontal> slice(
+        rev_horizontal, sorted_rectangles_of_t<rev_horizontal> const&);
 
-    struct intersection {
-        static constexpr auto id_comp() noexcept
-        {
-            return [](auto&& lhs, auto&& rhs) { return lhs->id() < rhs->id(); };
-        }
-        static constexpr auto to_id() noexcept
+    using intersection     = nitro::intersection;
+    using intersection_set = nitro::intersection_set;
+
+    intersection_set const& intersections() const;
+
+    // Changes to a built tree that don't rebuild it: the intersections within the bounding box
+    // of the changed rectangle and the rows overlapping it are partitioned before and after the
+    // change on their own, which is all that can change, and the set takes the difference. Both
+    // keep the set sorted, take a few passes over the roots and one over the set if any
+    // intersection is gone, and build single threaded without a deadline. A partial tree stays
+    // partial, the unexplored regions and the stats are those of the build.
+    // adds r as a root; throws invalid_arg if a root has its id already
+    void insert(rectangle const& r);
+    // removes the root with the id, false if there is none
+    bool erase(std::size_t id);
+    // false if a keep_partial build stopped at its deadline, the intersections then being the
+    // ones found in the subtrees it finished; it still goes depth first, but takes the larger
+    // child of every split first
+    bool complete() const noexcept { return m_unexplored.empty(); }
+    // the subtrees left when the build stopped
+    std::span<const region> unexplored() const noexcept { return m_unexplored; }
+    // what the build did; the counters stay zero unless stats_enabled, the time is always taken
+    build_stats const& stats() const noexcept;
+
+    // the area of every intersection of the set, row i for the i-th one in set order; runs the
+    // batch kernel over one reused gather buffer instead of folding each intersection apart
+    static rectangle_store calculate_all(
+        intersection_set const& intersections, rectangle_store::allocator_type alloc = {});
+
+    template <typename orientation_type>
+    static coordinate_t split_point(sorted_rectangles_of_t<orientation_type> const& sorted_rects);
+
+private:
+    void build();
+    // the bounding box of r and the rows overlapping it
+    rectangle neighborhood(rectangle const& r) const;
+    // the intersections among the rows overlapping area, clipped to it, leaving out row skip
+    intersection_set intersections_within(rectangle const& area,
+        std::optional<rectangle_store::index_t> skip, std::pmr::memory_resource* resource) const;
+    // takes the intersections within area from before to after
+    void update(
+        rectangle const& area, intersection_set const& before, intersection_set const& after);
+
+    std::pmr::memory_resource* m_resource;
+    intersection_set           m_intersections;
+    rectangles_list            m_rects;
+    // the same rectangles in columns, row i being the i-th of m_rects and m_roots
+    rectangle_store            m_store;
+    std::pmr::vector<rect_ptr> m_roots;
+    deadline                   m_deadline;
+    on_deadline                m_mode;
+    std::pmr::vector<region>   m_unexplored;
+    std::size_t                m_threads;
+    progress_callback          m_on_progress;
+    build_stats                m_stats;
+};
+
+// The intersections of a partition_tree, built one subtree at a time as they are pulled: an input
+// range of every distinct intersection together with its area, in the order the subtrees are
+// built rather than sorted. Stopping early skips the rest of the build, and the areas are
+// calculated as the intersections are pulled. Memory is still O(output): the constituents of
+// every intersection found so far are kept, as the same one can turn up again in any later
+// subtree, so a complete pass holds as much as partition_tree::intersections() would. What
+// the stream saves is the sorting and the areas of the whole set. Single threaded.
+struct intersection_stream {
+    // the current intersection, its constituents valid until the stream moves on
+    struct value_type {
+        intersection isec;
+        rectangle    area;
+    };
+
+    struct iterator {
+        using value_type      = intersection_stream::value_type;
+        using difference_type = std::ptrdiff_t;
+
+        value_type const& operator*() const { return *m_stream->m_current; }
+        value_type const* operator->() const { return &*m_stream->m_current; }
+        iterator&         operator++()
         {
-            return [](auto&& t) { return t->id(); };
+            m_stream->next();
+            return *this;
         }
-        template <rng::forward_range Rng>
-        explicit intersection(Rng&& range)
-            : m_rects(rng::begin(range), rng::end(range))
+        void operator++(int) { ++*this; }
+        [[nodiscard]] bool at_end() const noexcept { return !m_stream->m_current; }
+        friend bool operator==(iterator const& it, std::default_sentinel_t) noexcept
         {
-            rng::sort(m_rects, std::less<> {}, to_id());
-            auto [first, last] = rng::unique(m_rects, std::equal_to<> {}, to_id());
-            m_rects.erase(first, last);
-            if (m_rects.size() < 2) {
-                throw invalid_arg("intersection must be at least between two rectangles");
-            };
+            return it.at_end();
         }
-        bool operator<(const intersection& other) const noexcept;
-        bool operator==(const intersection& other) const noexcept;
 
-        auto& constituents() const noexcept { return m_rects; }
-
-        rectangle calculate() const;
-
-    private:
-        std::vector<rect_ptr> m_rects;
+        intersection_stream* m_stream;
     };
-    using intersection_set = std::pmr::set<intersection>;
 
-    intersection_set const& intersections() const;
+    explicit intersection_stream(rectangles_list lst,
+        std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+    explicit intersection_stream(rectangle_store store,
+        std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+    intersection_stream(const intersection_stream&) = delete;
+    intersection_stream& operator=(const intersection_stream&) = delete;
+    ~intersection_stream();
 
-    template <typename orientation_type>
-    static coordinate_t split_point(sorted_rectangles const& sorted_rects);
+    // builds up to the first intersection; the stream can only be iterated once
+    [[nodiscard]] iterator               begin();
+    [[nodiscard]] std::default_sentinel_t end() const noexcept { return {}; }
 
 private:
-    void build();
+    struct state;
+    // builds subtrees until one yields a new intersection, or none are left
+    void next();
 
-    intersection_set    m_intersections;
-    rectangles_list     m_rects;
-    tp                  m_start_time;
-    std::optional<secs> m_timeout;
+    std::unique_ptr<state>    m_state;
+    std::optional<value_type> m_current;
+    bool                      m_started {};
 };
 
 template <typename orientation_type>
-coordinate_t partition_tree::split_point(sorted_rectangles const& sorted_rects)
+coordinate_t partition_tree::split_point(
+    sorted_rectangles_of_t<orientation_type> const& sorted_rects)
 {
+    using slicing = slicing_of<orientation_type>;
     assert(!sorted_rects.empty());
-    auto&      first      = *sorted_rects.begin();
-    auto&      last       = *std::prev(sorted_rects.end());
-    const auto first_ref  = orientation_type {}.ref(*first);
-    const auto last_ref   = orientation_type {}.ref(*last);
-    const auto mid_p      = orientation_type {}.midpoint(first_ref, last_ref);
-    auto       split_rect = sorted_rects.lower_bound(mid_p);
-    if (split_rect == sorted_rects.end())
+    const auto& rows       = sorted_rects.rows();
+    const auto  first_ref  = slicing::ref(rows, 0);
+    const auto  last_ref   = slicing::ref(rows, rows.size() - 1);
+    const auto  mid_p      = orientation_type {}.midpoint(first_ref, last_ref);
+    const auto  split_rect = sorted_rects.lower_bound(mid_p);
+    if (split_rect == rows.size())
         return mid_p;
-    const auto split_point = orientation_type {}.ref(**split_rect);
+    const auto split_point = slicing::ref(rows, split_rect);
     return split_point;
 }
+
+template <typename Ordering>
+bool partition_tree::is_homogeneous(sorted_rectangles<Ordering> const& rects)
+{
+    if (rects.empty())
+        return true;
+    // equal extents alone aren't enough, rows shifted against each other only overlap in part
+    const auto& rows = rects.rows();
+    const auto  same = [](auto column) {
+        return rng::count(column, column.front()) == std::ssize(column);
+    };
+    return same(rows.widths()) && same(rows.heights()) && same(rows.xs()) && same(rows.ys());
+}
 }
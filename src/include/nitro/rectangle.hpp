@@ -1,7 +1,7 @@
 #pragma once
 
-#include <list>
 #include <nitro/fwd.hpp>
+#include <nitro/stable_vector.hpp>
 #include <nitro/types.hpp>
 #include <nitro/utils.hpp>
 
@@ -76,6 +76,7 @@ private:
     std::size_t      m_id {};
 };
 
-using rectangles_list = std::pmr::list<rectangle>;
+// rectangles never move once added, the rows of the engines point at them
+using rectangles_list = stable_vector<rectangle>;
 
 }
\ No newline at end of file
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <nitro/fwd.hpp>
+#include <nitro/rectangle.hpp>
+#include <nitro/types.hpp>
+
+#include <cstdint>
+#include <limits>
+#include <memory_resource>
+#include <span>
+#include <vector>
+
+namespace nitro {
+
+enum class axis { x, y };
+
+// Structure of arrays storage of rectangles: every attribute lives in its own contiguous column,
+// so that scans over a coordinate touch nothing else and compile to vector loops.
+// Rows refer to their root rectangle by its index in the store the tree was built from, roots
+// themselves have no_parent.
+struct rectangle_store {
+    using index_t        = std::uint32_t;
+    using allocator_type = std::pmr::polymorphic_allocator<>;
+    static constexpr index_t no_parent = std::numeric_limits<index_t>::max();
+    // size of a single row over all the columns, just 4 bytes less than a 48 byte rectangle;
+    // what rows save over sub-rectangles kept in a list is the 16 bytes of list links and the
+    // key and pointer a node held for each, not the geometry itself. Columns grown one row at a
+    // time may reserve up to twice that.
+    static constexpr std::size_t row_bytes
+        = 4 * sizeof(coordinate_t) + sizeof(std::size_t) + sizeof(index_t);
+
+    explicit rectangle_store(allocator_type alloc = {});
+    // every rectangle of the list as a root, in the order of the list
+    explicit rectangle_store(rectangles_list const& rects, allocator_type alloc = {});
+
+    [[nodiscard]] std::size_t    size() const noexcept { return m_id.size(); }
+    [[nodiscard]] bool           empty() const noexcept { return m_id.empty(); }
+    [[nodiscard]] allocator_type get_allocator() const noexcept { return m_id.get_allocator(); }
+    void                         reserve(std::size_t n);
+    void                         clear() noexcept;
+
+    // checks the extent just like the rectangle constructor does
+    index_t push_back(point origin, point extent, std::size_t id, index_t parent = no_parent);
+    index_t push_back(rectangle const& r);
+    // copies row i, or rows [first, last) of other
+    index_t append(rectangle_store const& other, std::size_t i);
+    void    append(rectangle_store const& other, std::size_t first, std::size_t last);
+    // bulk append of whole columns as roots, checking the extents like push_back; without an id
+    // column every row gets its 1-based position in the store
+    void append(std::span<const coordinate_t> xs, std::span<const coordinate_t> ys,
+        std::span<const coordinate_t> widths, std::span<const coordinate_t> heights,
+        std::span<const std::size_t> ids = {});
+    // reorders the rows so that row i becomes the row order[i] was
+    void permute(std::span<const index_t> order);
+    // removes row i by moving the last row into its place
+    void erase_unordered(std::size_t i) noexcept;
+
+    [[nodiscard]] coordinate_t x(std::size_t i) const noexcept { return m_x[i]; }
+    [[nodiscard]] coordinate_t y(std::size_t i) const noexcept { return m_y[i]; }
+    [[nodiscard]] coordinate_t width(std::size_t i) const noexcept { return m_w[i]; }
+    [[nodiscard]] coordinate_t height(std::size_t i) const noexcept { return m_h[i]; }
+    [[nodiscard]] std::size_t  id(std::size_t i) const noexcept { return m_id[i]; }
+    [[nodiscard]] index_t      parent(std::size_t i) const noexcept { return m_parent[i]; }
+    [[nodiscard]] index_t      root(std::size_t i) const noexcept
+    {
+        return m_parent[i] != no_parent ? m_parent[i] : static_cast<index_t>(i);
+    }
+    [[nodiscard]] coordinate_t origin(axis a, std::size_t i) const noexcept
+    {
+        return a == axis::x ? m_x[i] : m_y[i];
+    }
+    [[nodiscard]] coordinate_t extent(axis a, std::size_t i) const noexcept
+    {
+        return a == axis::x ? m_w[i] : m_h[i];
+    }
+    // row i as a stand-alone rectangle, without any link to its root
+    [[nodiscard]] rectangle rect(std::size_t i) const;
+
+    [[nodiscard]] std::span<const coordinate_t> xs() const noexcept { return m_x; }
+    [[nodiscard]] std::span<const coordinate_t> ys() const noexcept { return m_y; }
+    [[nodiscard]] std::span<const coordinate_t> widths() const noexcept { return m_w; }
+    [[nodiscard]] std::span<const coordinate_t> heights() const noexcept { return m_h; }
+    [[nodiscard]] std::span<const std::size_t>  ids() const noexcept { return m_id; }
+    [[nodiscard]] std::span<const index_t>      parents() const noexcept { return m_parent; }
+
+    [[nodiscard]] std::span<const coordinate_t> origins(axis a) const noexcept
+    {
+        return a == axis::x ? xs() : ys();
+    }
+    [[nodiscard]] std::span<const coordinate_t> extents(axis a) const noexcept
+    {
+        return a == axis::x ? widths() : heights();
+    }
+    [[nodiscard]] std::span<coordinate_t> origins(axis a) noexcept
+    {
+        return a == axis::x ? std::span(m_x) : std::span(m_y);
+    }
+    [[nodiscard]] std::span<coordinate_t> extents(axis a) noexcept
+    {
+        return a == axis::x ? std::span(m_w) : std::span(m_h);
+    }
+    [[nodiscard]] std::span<index_t> parents() noexcept { return m_parent; }
+
+private:
+    std::pmr::vector<coordinate_t> m_x, m_y, m_w, m_h;
+    std::pmr::vector<std::size_t>  m_id;
+    std::pmr::vector<index_t>      m_parent;
+};
+
+}
@@ -0,0 +1,112 @@
+#pragma once
+#include <nitro/memory_resource.hpp>
+#include <nitro/partition_tree.hpp>
+#include <nitro/types.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <stop_token>
+#include <string>
+#include <vector>
+
+namespace nitro {
+
+// The protocol of nitro_app serve, over a local stream socket in the byte order of the host. A
+// request is a request_header followed by length bytes of input, JSON or a binary rectangle file
+// as write_binary_rectangles writes it. Clients may send the next request before the answer to
+// the previous one came, the answers come in the order of the requests. An answer is a series of
+// frames, each a response_header followed by length bytes of payload: data frames carrying the
+// intersections as nitro_app prints them, then one frame with the final status, whose payload is
+// the error message unless the status is ok.
+enum class input_format : std::uint32_t { json, binary };
+
+struct request_header {
+    input_format  format;
+    // 0 for the timeout of the server
+    std::uint32_t timeout_secs;
+    std::uint64_t length;
+};
+
+// cancelled answers a request whose build the server stopped as it shut down
+enum class response_status : std::uint32_t { data, ok, timeout, invalid, error, cancelled };
+
+struct response_header {
+    response_status status;
+    std::uint32_t   reserved;
+    std::uint64_t   length;
+};
+
+struct server_options {
+    // connections served at once
+    std::size_t          workers { 1 };
+    // threads of every build
+    std::size_t          threads { 1 };
+    partition_tree::secs timeout { partition_tree::default_timeout };
+    std::size_t          max_rects { unlimited };
+    // longer requests are answered with invalid and the connection is closed; the input is
+    // read into memory as it arrives, so a header alone can't make the server allocate this
+    std::uint64_t        max_request_bytes { std::uint64_t { 256 } << 20 };
+};
+
+// Answers the requests of clients connecting to a Unix domain socket with the intersections of
+// the rectangles they send, on a fixed set of workers each serving one connection at a time.
+// The workers keep their memory pools from request to request, so a small request costs the
+// parse, the build and the socket round trip but no process start or heap warm up. Every build
+// gets the timeout of its request and is cancelled when the server stops. Not on Windows.
+struct server {
+    // binds the socket, replacing a stale one at the path, and listens; clients may connect
+    // from here on. Throws std::system_error if the socket can't be set up.
+    explicit server(std::filesystem::path socket_path, server_options opts = {});
+    server(const server&) = delete;
+    server& operator=(const server&) = delete;
+    // closes the socket and removes it
+    ~server();
+
+    // serves until stop is requested, then lets the requests in progress be cancelled and
+    // closes every connection
+    void run(std::stop_token stop);
+
+private:
+    void serve_connection(int fd, std::stop_token const& stop);
+
+    std::filesystem::path m_path;
+    server_options        m_opts;
+    thread_pools          m_pools;
+    int                   m_fd { -1 };
+};
+
+// the final status of an answer with the text of its data frames, or the error message
+struct response {
+    response_status status;
+    std::string     text;
+};
+
+// A blocking connection to a server.
+struct client {
+    // throws std::system_error if there is no server at the path
+    explicit client(std::filesystem::path const& socket_path);
+    client(const client&) = delete;
+    client& operator=(const client&) = delete;
+    ~client();
+
+    // timeout_secs 0 leaves the timeout to the server. Reads what the server answers meanwhile
+    // and holds it for receive, so any number of requests may be sent before the first answer
+    // is received.
+    void send(
+        std::span<const std::byte> input, input_format format, std::uint32_t timeout_secs = 0);
+    // the answer to the oldest request not received yet
+    [[nodiscard]] response receive();
+
+private:
+    // reads data, the answers held by send first; returns less if the server closed
+    std::size_t take(std::span<std::byte> data);
+
+    int                    m_fd { -1 };
+    // answers read while sending, from m_taken on not received yet
+    std::vector<std::byte> m_received;
+    std::size_t            m_taken { 0 };
+};
+
+}
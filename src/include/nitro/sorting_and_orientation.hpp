@@ -1,28 +1,67 @@
 #pragma once
 
+#include <algorithm>
 #include <cassert>
+#include <compare>
 #include <nitro/fwd.hpp>
 #include <nitro/rectangle.hpp>
+#include <nitro/rectangle_store.hpp>
 #include <nitro/types.hpp>
-#include <set>
+#include <iterator>
+#include <memory_resource>
+#include <span>
+#include <tuple>
+#include <utility>
 #include <variant>
+#include <vector>
 
 namespace nitro {
 
 template <typename Derived> struct sorting_base {
     using is_transparent = std::true_type;
+    // the sort key first, then the remaining attributes breaking the ties between equal keys
+    using order_t = std::tuple<coordinate_t, coordinate_t, coordinate_t, coordinate_t, std::size_t>;
+
+    constexpr order_t order(rectangle const& r) const noexcept
+    {
+        return Derived::order_of(r.origin().x, r.origin().y, r.width(), r.height(), r.id());
+    }
+    constexpr order_t order(rectangle_store const& s, std::size_t i) const noexcept
+    {
+        return Derived::order_of(s.x(i), s.y(i), s.width(i), s.height(i), s.id(i));
+    }
+    constexpr coordinate_t key(rectangle const& r) const noexcept { return std::get<0>(order(r)); }
+    constexpr coordinate_t key(rectangle_store const& s, std::size_t i) const noexcept
+    {
+        return std::get<0>(order(s, i));
+    }
+    constexpr coordinate_t key(coordinate_t ref) const noexcept { return Derived::key_of(ref); }
+
+    constexpr std::strong_ordering compare(
+        const rectangle& lhs, const rectangle& rhs) const noexcept
+    {
+        return order(lhs) <=> order(rhs);
+    }
+    constexpr std::weak_ordering compare(const rectangle& lhs, coordinate_t rhs) const noexcept
+    {
+        return key(lhs) <=> key(rhs);
+    }
+    constexpr std::weak_ordering compare(coordinate_t lhs, const rectangle& rhs) const noexcept
+    {
+        return key(lhs) <=> key(rhs);
+    }
 
     constexpr bool operator()(const rectangle& lhs, const rectangle& rhs) const noexcept
     {
-        return std::is_lt(static_cast<Derived const*>(this)->compare(lhs, rhs));
+        return std::is_lt(compare(lhs, rhs));
     }
     constexpr bool operator()(const rectangle& lhs, coordinate_t rhs) const noexcept
     {
-        return std::is_lt(static_cast<Derived const*>(this)->compare(lhs, rhs));
+        return std::is_lt(compare(lhs, rhs));
     }
     constexpr bool operator()(coordinate_t lhs, const rectangle& rhs) const noexcept
     {
-        return std::is_lt(static_cast<Derived const*>(this)->compare(lhs, rhs));
+        return std::is_lt(compare(lhs, rhs));
     }
 
     constexpr bool operator()(rect_ptr lhs, rect_ptr rhs) const noexcept
@@ -39,32 +78,42 @@ template <typename Derived> struct sorting_base {
         return (*this)(lhs, *rhs);
     }
 };
+// order_of() maps the attributes of a rectangle to a tuple ascending in the order of the
+// sorting, key_of() does the same for reference coordinates. Reverse orderings use the bitwise
+// complement as it can't overflow, unlike negation
 struct horizontal_sort : public sorting_base<horizontal_sort> {
-    using is_transparent = std::true_type;
-    std::strong_ordering compare(const rectangle& lhs, const rectangle& rhs) const noexcept;
-    std::weak_ordering   compare(const rectangle& lhs, coordinate_t rhs) const noexcept;
-    std::weak_ordering   compare(coordinate_t lhs, rectangle const& rhs) const noexcept;
-    // coordinate_t         reference(rectangle const& r) const;
+    static constexpr order_t order_of(coordinate_t x, coordinate_t y, coordinate_t w,
+        coordinate_t h, std::size_t id) noexcept
+    {
+        return { x, y, w, h, id };
+    }
+    static constexpr coordinate_t key_of(coordinate_t ref) noexcept { return ref; }
 };
 
 struct rev_horizontal_sort : public sorting_base<rev_horizontal_sort> {
-    using is_transparent = std::true_type;
-    std::strong_ordering compare(const rectangle& lhs, const rectangle& rhs) const noexcept;
-    std::weak_ordering   compare(const rectangle& lhs, coordinate_t rhs) const noexcept;
-    std::weak_ordering   compare(coordinate_t lhs, rectangle const& rhs) const noexcept;
+    static constexpr order_t order_of(coordinate_t x, coordinate_t y, coordinate_t w,
+        coordinate_t h, std::size_t id) noexcept
+    {
+        return { ~(x + w), ~(y + h), ~w, ~h, ~id };
+    }
+    static constexpr coordinate_t key_of(coordinate_t ref) noexcept { return ~ref; }
 };
 struct vertical_sort : public sorting_base<vertical_sort> {
-    using is_transparent = std::true_type;
-    std::strong_ordering compare(const rectangle& lhs, const rectangle& rhs) const noexcept;
-    std::weak_ordering   compare(const rectangle& lhs, coordinate_t rhs) const noexcept;
-    std::weak_ordering   compare(coordinate_t lhs, rectangle const& rhs) const noexcept;
+    static constexpr order_t order_of(coordinate_t x, coordinate_t y, coordinate_t w,
+        coordinate_t h, std::size_t id) noexcept
+    {
+        return { y, x, h, w, id };
+    }
+    static constexpr coordinate_t key_of(coordinate_t ref) noexcept { return ref; }
 };
 
 struct rev_vertical_sort : public sorting_base<rev_vertical_sort> {
-    using is_transparent = std::true_type;
-    std::strong_ordering compare(const rectangle& lhs, const rectangle& rhs) const noexcept;
-    std::weak_ordering   compare(const rectangle& lhs, coordinate_t rhs) const noexcept;
-    std::weak_ordering   compare(coordinate_t lhs, rectangle const& rhs) const noexcept;
+    static constexpr order_t order_of(coordinate_t x, coordinate_t y, coordinate_t w,
+        coordinate_t h, std::size_t id) noexcept
+    {
+        return { ~(y + h), ~(x + w), ~h, ~w, ~id };
+    }
+    static constexpr coordinate_t key_of(coordinate_t ref) noexcept { return ~ref; }
 };
 
 using orderings
@@ -72,12 +121,23 @@ using orderings
 
 struct ordering_t : public orderings {
     using is_transparent = std::true_type;
+    using order_t        = horizontal_sort::order_t;
     template <typename T1, typename T2>
     constexpr bool operator()(const T1& lhs, const T2& rhs) const noexcept
     {
         return std::visit(
             [&](auto& ord) { return ord(lhs, rhs); }, static_cast<orderings const&>(*this));
     }
+    template <typename... T> constexpr coordinate_t key(const T&... v) const noexcept
+    {
+        return std::visit(
+            [&](auto& ord) { return ord.key(v...); }, static_cast<orderings const&>(*this));
+    }
+    template <typename... T> constexpr order_t order(const T&... v) const noexcept
+    {
+        return std::visit(
+            [&](auto& ord) { return ord.order(v...); }, static_cast<orderings const&>(*this));
+    }
 };
 
 struct vertical : public orientation {
@@ -142,12 +202,211 @@ template <> struct ordering_of<rev_vertical> {
 };
 template <typename T> using ordering_of_t = typename ordering_of<T>::type;
 
-using sorted_rectangles = std::pmr::set<rect_ptr, ordering_t>;
+// the axis an orientation slices along, and whether it sweeps it from the far end, in which
+// case the reference coordinate of a rectangle is its far edge
+template <axis Axis, bool Reversed> struct slicing_traits {
+    static constexpr axis sliced_axis = Axis;
+    static constexpr bool reversed    = Reversed;
+
+    static constexpr coordinate_t ref(rectangle_store const& s, std::size_t i) noexcept
+    {
+        return Reversed ? s.origin(Axis, i) + s.extent(Axis, i) : s.origin(Axis, i);
+    }
+};
+template <typename T> struct slicing_of;
+template <> struct slicing_of<vertical> : slicing_traits<axis::x, false> {
+};
+template <> struct slicing_of<rev_vertical> : slicing_traits<axis::x, true> {
+};
+template <> struct slicing_of<horizontal> : slicing_traits<axis::y, false> {
+};
+template <> struct slicing_of<rev_horizontal> : slicing_traits<axis::y, true> {
+};
+
+// Rectangles kept in a rectangle_store, its rows sorted and unique along Ordering. Lookups by
+// coordinate are binary searches over the key column of the ordering, the remaining columns
+// only being consulted to break ties between equal keys.
+// Every row refers to its root by index, sorted_rectangles is self contained otherwise: slicing
+// writes new rows instead of allocating rectangles pointing back to their parents.
+// Ordering is one of the concrete *_sort types, so that the comparisons inline, ordering_t may
+// be used where the ordering is only known at runtime.
+template <typename Ordering> struct sorted_rectangles {
+    using key_compare    = Ordering;
+    using index_t        = rectangle_store::index_t;
+    using allocator_type = rectangle_store::allocator_type;
+    using size_type      = std::size_t;
+
+    explicit sorted_rectangles(Ordering ord, allocator_type alloc = {})
+        : m_ord(ord)
+        , m_rows(alloc)
+    {
+    }
+    // sorts the rows of the store, the roots among them referring to their own index in it
+    sorted_rectangles(rectangle_store rows, Ordering ord);
+    // the rectangles as roots, referring to their position in the range
+    template <RectPtrRange RectRange>
+    sorted_rectangles(RectRange const& rects, Ordering ord, allocator_type alloc = {});
+
+    [[nodiscard]] size_type              size() const noexcept { return m_rows.size(); }
+    [[nodiscard]] bool                   empty() const noexcept { return m_rows.empty(); }
+    [[nodiscard]] key_compare            key_comp() const noexcept { return m_ord; }
+    [[nodiscard]] allocator_type         get_allocator() const noexcept
+    {
+        return m_rows.get_allocator();
+    }
+    [[nodiscard]] rectangle_store const& rows() const noexcept { return m_rows; }
+    [[nodiscard]] rectangle_store        release() && noexcept { return std::move(m_rows); }
+    [[nodiscard]] rectangle              operator[](std::size_t i) const { return m_rows.rect(i); }
+
+    // first row not ordered before the reference coordinate, respectively after it
+    [[nodiscard]] index_t lower_bound(coordinate_t ref) const noexcept;
+    [[nodiscard]] index_t upper_bound(coordinate_t ref) const noexcept;
+
+    // copy of the rows [from, size()), with the same ordering and allocator
+    [[nodiscard]] sorted_rectangles tail(std::size_t from) const;
+
+    // sorts the new rows, then merges them in a single pass dropping the duplicates
+    void merge(rectangle_store&& rows);
+
+private:
+    [[nodiscard]] std::size_t partition_point(coordinate_t key, bool inclusive) const noexcept;
+    // sorts and deduplicates the rows of the store along m_ord
+    void sort_unique(rectangle_store& rows) const;
+
+    Ordering        m_ord;
+    rectangle_store m_rows;
+};
+
+// the container sorted along the ordering used while partitioning in the given orientation
+template <typename Orientation>
+using sorted_rectangles_of_t = sorted_rectangles<ordering_of_t<Orientation>>;
+
+template <typename Ordering>
+sorted_rectangles<Ordering>::sorted_rectangles(rectangle_store rows, Ordering ord)
+    : m_ord(ord)
+    , m_rows(std::move(rows))
+{
+    auto parents = m_rows.parents();
+    for (std::size_t i = 0; i < parents.size(); ++i)
+        parents[i] = m_rows.root(i);
+    sort_unique(m_rows);
+}
+
+template <typename Ordering>
+template <RectPtrRange RectRange>
+sorted_rectangles<Ordering>::sorted_rectangles(
+    RectRange const& rects, Ordering ord, allocator_type alloc)
+    : m_ord(ord)
+    , m_rows(alloc)
+{
+    m_rows.reserve(static_cast<std::size_t>(rng::distance(rects)));
+    for (auto&& r : rects) {
+        const auto& rect = *r;
+        m_rows.push_back(rect.origin(), rect.extent(), rect.id(),
+            static_cast<index_t>(m_rows.size()));
+    }
+    sort_unique(m_rows);
+}
+
+template <typename Ordering>
+std::size_t sorted_rectangles<Ordering>::partition_point(
+    coordinate_t key, bool inclusive) const noexcept
+{
+    std::size_t first = 0, count = size();
+    while (count > 0) {
+        const auto step = count / 2;
+        const auto k    = m_ord.key(m_rows, first + step);
+        if (k < key || (inclusive && k == key)) {
+            first += step + 1;
+            count -= step + 1;
+        } else {
+            count = step;
+        }
+    }
+    return first;
+}
+
+template <typename Ordering>
+auto sorted_rectangles<Ordering>::lower_bound(coordinate_t ref) const noexcept -> index_t
+{
+    return static_cast<index_t>(partition_point(m_ord.key(ref), false));
+}
+
+template <typename Ordering>
+auto sorted_rectangles<Ordering>::upper_bound(coordinate_t ref) const noexcept -> index_t
+{
+    return static_cast<index_t>(partition_point(m_ord.key(ref), true));
+}
+
+template <typename Ordering>
+auto sorted_rectangles<Ordering>::tail(std::size_t from) const -> sorted_rectangles
+{
+    sorted_rectangles result(m_ord, get_allocator());
+    result.m_rows.append(m_rows, from, size());
+    return result;
+}
+
+template <typename Ordering>
+void sorted_rectangles<Ordering>::sort_unique(rectangle_store& rows) const
+{
+    using entry = std::pair<coordinate_t, index_t>;
+    std::pmr::vector<entry> entries(rows.get_allocator());
+    entries.reserve(rows.size());
+    for (std::size_t i = 0; i < rows.size(); ++i)
+        entries.emplace_back(m_ord.key(rows, i), static_cast<index_t>(i));
+    // the keys settle most of the comparisons, the other columns are only read on ties, the
+    // first one of the duplicates is kept
+    std::sort(entries.begin(), entries.end(), [&](entry const& lhs, entry const& rhs) {
+        if (lhs.first != rhs.first)
+            return lhs.first < rhs.first;
+        const auto cmp = m_ord.order(rows, lhs.second) <=> m_ord.order(rows, rhs.second);
+        return cmp != 0 ? cmp < 0 : lhs.second < rhs.second;
+    });
+    entries.erase(std::unique(entries.begin(), entries.end(),
+                      [&](entry const& lhs, entry const& rhs) {
+                          return lhs.first == rhs.first
+                              && m_ord.order(rows, lhs.second) == m_ord.order(rows, rhs.second);
+                      }),
+        entries.end());
+    std::pmr::vector<index_t> order(rows.get_allocator());
+    order.reserve(entries.size());
+    for (const auto& e : entries)
+        order.push_back(e.second);
+    rows.permute(order);
+}
+
+template <typename Ordering> void sorted_rectangles<Ordering>::merge(rectangle_store&& rows)
+{
+    if (rows.empty())
+        return;
+    sort_unique(rows);
+    if (empty()) {
+        m_rows = std::move(rows);
+        return;
+    }
+    rectangle_store merged(get_allocator());
+    merged.reserve(size() + rows.size());
+    std::size_t i = 0, j = 0;
+    while (i < size() && j < rows.size()) {
+        const auto cmp = m_ord.order(m_rows, i) <=> m_ord.order(rows, j);
+        if (cmp <= 0)
+            merged.append(m_rows, i++);
+        else
+            merged.append(rows, j++);
+        if (cmp == 0)
+            ++j;
+    }
+    merged.append(m_rows, i, size());
+    merged.append(rows, j, rows.size());
+    m_rows = std::move(merged);
+}
 
 template <typename Orientation, typename RectRange>
-auto sorted(RectRange const& rects) -> sorted_rectangles requires RectPtrRange<RectRange>
+auto sorted(RectRange const& rects,
+    typename sorted_rectangles_of_t<Orientation>::allocator_type alloc = {})
+    -> sorted_rectangles_of_t<Orientation> requires RectPtrRange<RectRange>
 {
-    return { rng::begin(rects), rng::end(rects), ordering_t { ordering_of_t<Orientation> {} } };
+    return { rects, ordering_of_t<Orientation> {}, alloc };
 }
 
-}
\ No newline at end of file
+}
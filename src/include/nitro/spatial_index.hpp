@@ -0,0 +1,90 @@
+#pragma once
+
+#include <nitro/fwd.hpp>
+#include <nitro/rectangle.hpp>
+#include <nitro/rectangle_store.hpp>
+#include <nitro/types.hpp>
+
+#include <cstddef>
+#include <memory_resource>
+#include <span>
+#include <vector>
+
+namespace nitro {
+
+// The answers to a batch of queries: the rows found for the i-th query are rows[offsets[i],
+// offsets[i + 1]), in ascending order.
+struct query_results {
+    using index_t        = rectangle_store::index_t;
+    using allocator_type = std::pmr::polymorphic_allocator<>;
+
+    explicit query_results(allocator_type alloc = {});
+
+    [[nodiscard]] std::size_t size() const noexcept { return offsets.size() - 1; }
+    [[nodiscard]] std::span<const index_t> operator[](std::size_t i) const noexcept
+    {
+        return std::span(rows).subspan(offsets[i], offsets[i + 1] - offsets[i]);
+    }
+
+    std::pmr::vector<std::size_t> offsets;
+    std::pmr::vector<index_t>     rows;
+};
+
+// Packed R-tree over the rows of a store, for queries after a build: which rectangles cover a
+// point, and which overlap a window. The rows are sorted into leaves of fanout rows by
+// sort-tile-recursive packing, the levels above group fanout nodes each, so the tree is
+// O(log n) levels deep. A query descends into every node whose bounds it meets, and the bounds
+// of siblings overlap, so there is no worst case bound short of visiting every node: on inputs
+// of mostly small, scattered rectangles the packing keeps the overlap small and a query
+// typically visits O(log n) nodes plus those leading to what it finds, while large or heavily
+// overlapping rectangles make it descend into subtrees that hold nothing it wants. The bounds
+// of every level are kept column by column like the store. A point is covered by the cells
+// right and above of it, as a cell of the partition is, so rectangles that only touch it with
+// an edge don't count; windows overlap with some area. For the intersections of an engine,
+// index the areas partition_tree::calculate_all returns, row i being the i-th intersection of
+// the set.
+struct spatial_index {
+    using index_t        = rectangle_store::index_t;
+    using allocator_type = std::pmr::polymorphic_allocator<>;
+    static constexpr std::size_t fanout = 16;
+
+    // indexes the rows as they are at construction, the store isn't referred to afterwards
+    explicit spatial_index(rectangle_store const& rows, allocator_type alloc = {});
+
+    [[nodiscard]] std::size_t size() const noexcept { return m_rows.size(); }
+
+    // the rows covering p, ascending; found is cleared first, reusing it over many queries
+    // saves allocating
+    void covering(point p, std::pmr::vector<index_t>& found) const;
+    // the rows overlapping the window, ascending
+    void overlapping(rectangle const& window, std::pmr::vector<index_t>& found) const;
+
+    // The same for many queries, which descend the tree together: a node is visited once for
+    // all of the queries reaching it, tested against it one after the other, so nearby queries
+    // share the traversal.
+    [[nodiscard]] query_results covering(
+        std::span<const point> points, query_results::allocator_type alloc = {}) const;
+    // the windows are the rows of the store
+    [[nodiscard]] query_results overlapping(
+        rectangle_store const& windows, query_results::allocator_type alloc = {}) const;
+
+private:
+    // the bounds of the nodes of a level, level 0 holding the rows in leaf order; the children
+    // of node i are nodes [i * fanout, (i + 1) * fanout) of the level below
+    struct level {
+        explicit level(allocator_type alloc);
+        [[nodiscard]] std::size_t size() const noexcept { return x0.size(); }
+
+        std::pmr::vector<coordinate_t> x0, y0, x1, y1;
+    };
+
+    template <typename Query> void find(Query const& q, std::pmr::vector<index_t>& found) const;
+    template <typename Queries>
+    query_results find_all(Queries const& queries, query_results::allocator_type alloc) const;
+
+    std::pmr::vector<level> m_levels;
+    // the row of the store at every position of level 0
+    std::pmr::vector<index_t> m_rows;
+};
+
+}
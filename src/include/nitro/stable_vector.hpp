@@ -0,0 +1,229 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <memory_resource>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace nitro {
+
+// Sequence growing in chunks of ChunkSize elements allocated from a memory resource: elements
+// never move once added, so pointers and references to them stay valid until the container is
+// cleared or destroyed, and n elements cost n / ChunkSize allocations, all given back in one go.
+// Iterators are random access, but like those of a vector are invalidated by adding elements.
+template <typename T, std::size_t ChunkSize = 256> struct stable_vector {
+    using value_type      = T;
+    using size_type       = std::size_t;
+    using difference_type = std::ptrdiff_t;
+    using reference       = T&;
+    using const_reference = T const&;
+    using allocator_type  = std::pmr::polymorphic_allocator<T>;
+
+    static constexpr size_type chunk_size = ChunkSize;
+
+    template <bool Const> struct basic_iterator {
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type        = T;
+        using difference_type   = std::ptrdiff_t;
+        using pointer           = std::conditional_t<Const, T const*, T*>;
+        using reference         = std::conditional_t<Const, T const&, T&>;
+
+        basic_iterator() = default;
+        basic_iterator(T* const* chunks, size_type pos) noexcept
+            : m_chunks(chunks)
+            , m_pos(pos)
+        {
+        }
+        operator basic_iterator<true>() const noexcept
+            requires(!Const)
+        {
+            return { m_chunks, m_pos };
+        }
+
+        reference operator*() const noexcept
+        {
+            return m_chunks[m_pos / chunk_size][m_pos % chunk_size];
+        }
+        pointer   operator->() const noexcept { return &**this; }
+        reference operator[](difference_type n) const noexcept { return *(*this + n); }
+
+        basic_iterator& operator++() noexcept { return *this += 1; }
+        basic_iterator  operator++(int) noexcept { return std::exchange(*this, *this + 1); }
+        basic_iterator& operator--() noexcept { return *this -= 1; }
+        basic_iterator  operator--(int) noexcept { return std::exchange(*this, *this - 1); }
+        basic_iterator& operator+=(difference_type n) noexcept
+        {
+            m_pos = static_cast<size_type>(static_cast<difference_type>(m_pos) + n);
+            return *this;
+        }
+        basic_iterator& operator-=(difference_type n) noexcept { return *this += -n; }
+
+        friend basic_iterator operator+(basic_iterator it, difference_type n) noexcept
+        {
+            return it += n;
+        }
+        friend basic_iterator operator+(difference_type n, basic_iterator it) noexcept
+        {
+            return it += n;
+        }
+        friend basic_iterator operator-(basic_iterator it, difference_type n) noexcept
+        {
+            return it -= n;
+        }
+        friend difference_type operator-(
+            basic_iterator const& lhs, basic_iterator const& rhs) noexcept
+        {
+            return static_cast<difference_type>(lhs.m_pos)
+                - static_cast<difference_type>(rhs.m_pos);
+        }
+        friend bool operator==(basic_iterator const& lhs, basic_iterator const& rhs) noexcept
+        {
+            return lhs.m_pos == rhs.m_pos;
+        }
+        friend auto operator<=>(basic_iterator const& lhs, basic_iterator const& rhs) noexcept
+        {
+            return lhs.m_pos <=> rhs.m_pos;
+        }
+
+    private:
+        T* const* m_chunks {};
+        size_type m_pos {};
+    };
+    using iterator       = basic_iterator<false>;
+    using const_iterator = basic_iterator<true>;
+
+    stable_vector() noexcept = default;
+    explicit stable_vector(allocator_type alloc) noexcept
+        : m_chunks(alloc)
+    {
+    }
+    stable_vector(std::initializer_list<T> init, allocator_type alloc = {})
+        : m_chunks(alloc)
+    {
+        append(init.begin(), init.end());
+    }
+    stable_vector(stable_vector const& other, allocator_type alloc = {})
+        : m_chunks(alloc)
+    {
+        append(other.begin(), other.end());
+    }
+    stable_vector(stable_vector&& other) noexcept
+        : m_chunks(std::move(other.m_chunks))
+        , m_size(std::exchange(other.m_size, 0))
+    {
+    }
+    stable_vector& operator=(stable_vector const& other)
+    {
+        if (this != &other) {
+            clear();
+            append(other.begin(), other.end());
+        }
+        return *this;
+    }
+    // steals the chunks if both sides allocate from the same resource, moves element-wise else
+    stable_vector& operator=(stable_vector&& other)
+    {
+        if (this == &other)
+            return *this;
+        clear();
+        if (get_allocator() == other.get_allocator()) {
+            m_chunks.swap(other.m_chunks);
+            std::swap(m_size, other.m_size);
+        } else {
+            append(std::make_move_iterator(other.begin()), std::make_move_iterator(other.end()));
+            other.clear();
+        }
+        return *this;
+    }
+    ~stable_vector() { clear(); }
+
+    [[nodiscard]] size_type      size() const noexcept { return m_size; }
+    [[nodiscard]] bool           empty() const noexcept { return m_size == 0; }
+    [[nodiscard]] size_type      capacity() const noexcept { return m_chunks.size() * chunk_size; }
+    [[nodiscard]] allocator_type get_allocator() const noexcept { return m_chunks.get_allocator(); }
+
+    [[nodiscard]] iterator       begin() noexcept { return { m_chunks.data(), 0 }; }
+    [[nodiscard]] iterator       end() noexcept { return { m_chunks.data(), m_size }; }
+    [[nodiscard]] const_iterator begin() const noexcept { return { m_chunks.data(), 0 }; }
+    [[nodiscard]] const_iterator end() const noexcept { return { m_chunks.data(), m_size }; }
+    [[nodiscard]] const_iterator cbegin() const noexcept { return begin(); }
+    [[nodiscard]] const_iterator cend() const noexcept { return end(); }
+
+    [[nodiscard]] reference operator[](size_type i) noexcept
+    {
+        return m_chunks[i / chunk_size][i % chunk_size];
+    }
+    [[nodiscard]] const_reference operator[](size_type i) const noexcept
+    {
+        return m_chunks[i / chunk_size][i % chunk_size];
+    }
+    [[nodiscard]] reference       front() noexcept { return (*this)[0]; }
+    [[nodiscard]] const_reference front() const noexcept { return (*this)[0]; }
+    [[nodiscard]] reference       back() noexcept { return (*this)[m_size - 1]; }
+    [[nodiscard]] const_reference back() const noexcept { return (*this)[m_size - 1]; }
+
+    // allocates the chunks for n elements up front
+    void reserve(size_type n)
+    {
+        m_chunks.reserve((n + chunk_size - 1) / chunk_size);
+        while (capacity() < n)
+            add_chunk();
+    }
+
+    template <typename... Args> reference emplace_back(Args&&... args)
+    {
+        if (m_size == capacity())
+            add_chunk();
+        auto alloc = get_allocator();
+        auto slot  = &(*this)[m_size];
+        std::allocator_traits<allocator_type>::construct(alloc, slot, std::forward<Args>(args)...);
+        ++m_size;
+        return *slot;
+    }
+    void push_back(T const& value) { emplace_back(value); }
+    void push_back(T&& value) { emplace_back(std::move(value)); }
+    // the chunk of the element stays, for the next one pushed
+    void pop_back() noexcept
+    {
+        std::destroy_at(&back());
+        --m_size;
+    }
+
+    void clear() noexcept
+    {
+        if constexpr (!std::is_trivially_destructible_v<T>) {
+            for (auto& e : *this)
+                std::destroy_at(&e);
+        }
+        auto alloc = get_allocator();
+        for (auto chunk : m_chunks)
+            alloc.deallocate(chunk, chunk_size);
+        m_chunks.clear();
+        m_size = 0;
+    }
+
+private:
+    void add_chunk()
+    {
+        // grow the table first, so the chunk can't leak
+        if (m_chunks.size() == m_chunks.capacity())
+            m_chunks.reserve(std::max<size_type>(4, 2 * m_chunks.size()));
+        m_chunks.push_back(get_allocator().allocate(chunk_size));
+    }
+    template <typename It> void append(It first, It last)
+    {
+        reserve(m_size + static_cast<size_type>(std::distance(first, last)));
+        for (; first != last; ++first)
+            emplace_back(*first);
+    }
+
+    std::pmr::vector<T*> m_chunks;
+    size_type            m_size {};
+};
+
+}
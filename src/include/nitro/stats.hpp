@@ -0,0 +1,71 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <nlohmann/json_fwd.hpp>
+
+namespace nitro {
+
+// false if the library is built with NITRO_NO_STATS, the counters of build_stats are left at
+// zero then and counting them costs nothing
+#ifdef NITRO_NO_STATS
+inline constexpr bool stats_enabled = false;
+#else
+inline constexpr bool stats_enabled = true;
+#endif
+
+// what a partition_tree build did
+struct build_stats {
+    // subtrees taken off the work stacks
+    std::size_t subtrees {};
+    // subtrees split by slice()
+    std::size_t slices {};
+    // rows written by the slices, i.e. the sub-rectangles created
+    std::size_t rows_sliced {};
+    // subtrees small or nested enough to read their intersections off without slicing
+    std::size_t read_off {};
+    // subtrees which couldn't be split any further along their orientation
+    std::size_t orientation_changes {};
+    // the most subtrees pending on a single work stack, which the build uses in place of
+    // recursion, so this is what the recursion depth was
+    std::size_t max_pending {};
+    // taken from the memory resource by the build's pool, and the most of it held at once
+    std::size_t bytes_allocated {};
+    std::size_t peak_bytes {};
+    // wall time of the build, measured whether or not the counters are enabled
+    std::chrono::nanoseconds build_time {};
+
+    // adds up the counters of another part of the build, the maximums taken as such
+    build_stats& operator+=(build_stats const& other) noexcept;
+};
+
+// wall times of the phases of a run, in the order they were first timed
+struct phase_times {
+    using clock    = std::chrono::steady_clock;
+    using duration = std::chrono::nanoseconds;
+
+    // runs f, adding its wall time to the phase, also when it throws
+    template <typename F> decltype(auto) time(std::string phase, F&& f)
+    {
+        const struct guard {
+            phase_times&      times;
+            std::string       phase;
+            clock::time_point start = clock::now();
+            ~guard() { times.add(std::move(phase), clock::now() - start); }
+        } g { *this, std::move(phase) };
+        return std::forward<F>(f)();
+    }
+    void add(std::string phase, duration d);
+
+    std::vector<std::pair<std::string, duration>> phases;
+};
+
+void to_json(nlohmann::json& j, build_stats const& stats);
+// an object of the phases in seconds
+void to_json(nlohmann::json& j, phase_times const& times);
+
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <nitro/fwd.hpp>
+#include <nitro/partition_tree.hpp>
+#include <nitro/rectangle.hpp>
+
+#include <memory_resource>
+#include <optional>
+#include <stop_token>
+#include <vector>
+
+namespace nitro {
+
+// Alternative engine to partition_tree, producing the same intersection_set.
+// Sweeps a vertical line over the sorted left/right edges of the rectangles, keeping the
+// rectangles crossed by the line in a segment tree over the compressed y coordinates.
+// Only the y range touched by the edges at the current x is re-examined, and within it only
+// once per run of intervals with the same cover, a run ending at the y edges of the rectangles
+// on the line. Every cover read that way is an intersection right of x, and reading it costs
+// O(log n) plus its size, so the sweep is O((n + c) log n + s) for the c covers read and their
+// summed size s. That's output sensitive, n concentric rectangles take O(n^2) as their
+// intersections hold that many ids, but c counts an intersection again wherever it comes up
+// anew, e.g. each time a small rectangle within it closes.
+struct sweep_line {
+    using secs             = partition_tree::secs;
+    using clock            = partition_tree::clock;
+    using tp               = partition_tree::tp;
+    using intersection     = partition_tree::intersection;
+    using intersection_set = partition_tree::intersection_set;
+
+    // the rectangles, the sweep state and the intersections are allocated from resource, which
+    // is only used by the constructing thread. Throws timeout and cancelled as partition_tree does.
+    explicit sweep_line(rectangles_list lst, std::optional<secs> timeout = {},
+        std::pmr::memory_resource* resource = std::pmr::get_default_resource(),
+        std::stop_token stop = {});
+    sweep_line(const sweep_line&) = delete;
+    sweep_line(sweep_line&&)      = delete;
+    sweep_line& operator=(const sweep_line&) = delete;
+    sweep_line& operator=(sweep_line&&) = delete;
+
+    intersection_set const& intersections() const;
+
+private:
+    void build();
+
+    std::pmr::memory_resource* m_resource;
+    intersection_set           m_intersections;
+    rectangles_list            m_rects;
+    std::pmr::vector<rect_ptr> m_roots;
+    deadline                   m_deadline;
+};
+
+}
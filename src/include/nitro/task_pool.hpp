@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+namespace nitro {
+
+// Fixed size work-stealing pool: every worker owns a deque, pushes and pops its own tasks at
+// the back and steals from the front of the others when it runs dry.
+struct task_pool {
+    using task = std::function<void()>;
+
+    explicit task_pool(std::size_t threads);
+    task_pool(const task_pool&) = delete;
+    task_pool(task_pool&&)      = delete;
+    task_pool& operator=(const task_pool&) = delete;
+    task_pool& operator=(task_pool&&) = delete;
+    ~task_pool();
+
+    [[nodiscard]] std::size_t size() const noexcept { return m_queues.size(); }
+
+    // index of the worker running the calling thread, nullopt outside of the pool
+    [[nodiscard]] std::optional<std::size_t> worker_index() const noexcept;
+
+    // queues a task, on the calling worker's own deque if called from within the pool
+    void push(task t);
+
+    // runs root and every task spawned from it to completion, rethrows the first exception
+    // thrown by any of them, after which the remaining queued tasks are discarded
+    void run(task root);
+
+    // set once a task has thrown, long running tasks are expected to poll it and bail out
+    [[nodiscard]] bool cancelled() const noexcept
+    {
+        return m_cancelled.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct queue {
+        std::mutex       mx;
+        std::deque<task> tasks;
+    };
+
+    std::optional<task> pop(std::size_t self);
+    void                worker(std::size_t self);
+    void                execute(task& t) noexcept;
+
+    std::vector<std::unique_ptr<queue>> m_queues;
+    std::vector<std::jthread>           m_threads;
+    std::mutex                          m_mx;
+    std::condition_variable             m_cv;
+    std::condition_variable             m_done;
+    std::size_t                         m_pending {};
+    std::size_t                         m_queued {};
+    std::size_t                         m_next_queue {};
+    std::exception_ptr                  m_error;
+    std::atomic_bool                    m_cancelled { false };
+    bool                                m_stop { false };
+};
+
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include <nitro/fwd.hpp>
+#include <nitro/intersection_set.hpp>
+#include <nitro/rectangle.hpp>
+#include <nitro/rectangle_store.hpp>
+#include <nitro/types.hpp>
+
+#include <charconv>
+#include <concepts>
+#include <cstddef>
+#include <limits>
+#include <ostream>
+#include <string_view>
+#include <vector>
+
+namespace nitro {
+
+// Buffered writer of the text output of nitro_app. Numbers are formatted with std::to_chars into
+// a buffer which is handed to the stream in blocks of capacity bytes, instead of every field
+// going through the formatting state and locale of the stream. Whatever is left is handed over
+// when the writer is destroyed, write errors are reported by the stream as usual.
+struct text_writer {
+    static constexpr std::size_t default_capacity = 64 * 1024;
+
+    // capacity is raised to 64 bytes at least, which any number fits in
+    explicit text_writer(std::ostream& os, std::size_t capacity = default_capacity);
+    text_writer(const text_writer&) = delete;
+    text_writer& operator=(const text_writer&) = delete;
+    ~text_writer();
+
+    text_writer& operator<<(char c)
+    {
+        reserve(1);
+        m_buffer[m_size++] = c;
+        return *this;
+    }
+    text_writer& operator<<(std::string_view s)
+    {
+        if (s.size() > m_buffer.size())
+            return write_through(s);
+        reserve(s.size());
+        s.copy(m_buffer.data() + m_size, s.size());
+        m_size += s.size();
+        return *this;
+    }
+    text_writer& operator<<(char const* s) { return *this << std::string_view(s); }
+    template <std::integral T> text_writer& operator<<(T v)
+    {
+        // digits10 falls one short of the longest number, plus the sign
+        reserve(std::numeric_limits<T>::digits10 + 2);
+        const auto first = m_buffer.data() + m_size;
+        m_size += static_cast<std::size_t>(
+            std::to_chars(first, first + std::numeric_limits<T>::digits10 + 2, v).ptr - first);
+        return *this;
+    }
+    // as "(x,y)", the way operator<< of std::ostream writes it
+    text_writer& operator<<(point p) { return *this << '(' << p.x << ',' << p.y << ')'; }
+    // as "    <id>: Rectangle at (x,y), w=<w>, h=<h>."
+    text_writer& operator<<(rectangle const& r);
+
+    // hands what is buffered to the stream and flushes that
+    void flush();
+
+private:
+    void reserve(std::size_t n)
+    {
+        if (m_size + n > m_buffer.size())
+            drain();
+    }
+    void         drain();
+    text_writer& write_through(std::string_view s);
+
+    std::ostream&     m_os;
+    std::vector<char> m_buffer;
+    std::size_t       m_size {};
+};
+
+// the sections of the output of nitro_app, as in test/data/expected.txt: the input rectangles
+// followed by an empty line, then the intersections, areas holding the area of every one of
+// them in set order as partition_tree::calculate_all returns them
+void write_input(text_writer& w, rectangle_store const& rects);
+void write_intersections(
+    text_writer& w, intersection_set const& intersections, rectangle_store const& areas);
+
+}
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <nitro/fwd.hpp>
+#include <nitro/intersection_set.hpp>
+#include <nitro/partition_tree.hpp>
+#include <nitro/rectangle.hpp>
+#include <nitro/rectangle_store.hpp>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <memory_resource>
+#include <optional>
+#include <ostream>
+#include <span>
+#include <stop_token>
+#include <vector>
+
+namespace nitro {
+
+// Cuts the bounding box of a set of rectangles into columns x rows tiles. The cuts are taken at
+// the quantiles of the centers, so that the tiles get about as many rectangles each, and never
+// repeat, so skewed inputs may get fewer tiles than asked for. Tiles are numbered row by row.
+// The same rectangles give the same grid, which is how separate processes agree on it.
+struct tile_grid {
+    tile_grid(rectangle_store const& rects, std::size_t columns, std::size_t rows);
+    // about rows_per_tile rectangles in every tile, before any of them is clipped
+    [[nodiscard]] static tile_grid with_at_most(
+        rectangle_store const& rects, std::size_t rows_per_tile);
+
+    [[nodiscard]] std::size_t size() const noexcept { return columns() * rows(); }
+    [[nodiscard]] std::size_t columns() const noexcept { return m_xs.size() - 1; }
+    [[nodiscard]] std::size_t rows() const noexcept { return m_ys.size() - 1; }
+    [[nodiscard]] rectangle   operator[](std::size_t i) const;
+
+private:
+    // the edges of the columns and the rows, the outer ones those of the bounding box
+    std::vector<coordinate_t> m_xs, m_ys;
+};
+
+// The rows of rects overlapping the tile, cut to it with rectangle::slice at its left, right,
+// bottom and top edges in turn, keeping their ids; origins[i] is the row the i-th was cut from.
+[[nodiscard]] rectangle_store clip(rectangle_store const& rects, rectangle const& tile,
+    std::pmr::vector<rectangle_store::index_t>& origins,
+    rectangle_store::allocator_type             alloc = {});
+
+// What a tile contributes to the intersections: the cover sets of its cells, as runs of rows of
+// the whole input sorted by id, run i being members[offsets[i], offsets[i + 1]). Tiles cut the
+// plane without overlap, so every cell of the partition of the whole input lies in one or more
+// tiles and has the same cover there; the tiles together find every intersection at least once.
+struct tile_intersections {
+    using index_t        = rectangle_store::index_t;
+    using allocator_type = std::pmr::polymorphic_allocator<>;
+
+    explicit tile_intersections(allocator_type alloc = {});
+
+    [[nodiscard]] std::size_t              size() const noexcept { return offsets.size() - 1; }
+    [[nodiscard]] std::span<const index_t> operator[](std::size_t i) const noexcept
+    {
+        return std::span(members).subspan(offsets[i], offsets[i + 1] - offsets[i]);
+    }
+
+    std::uint32_t                   tile {};
+    std::uint32_t                   tiles {};
+    // the rectangles of the whole input, which the rows refer to
+    std::uint64_t                   input_rows {};
+    std::pmr::vector<index_t>       members;
+    std::pmr::vector<std::uint64_t> offsets;
+};
+
+// Builds tile i of the grid on its own: a partition_tree, single threaded, over the rows clipped
+// to it, the tree and its rows taken from resource and given back before returning. Throws as
+// partition_tree does.
+[[nodiscard]] tile_intersections build_tile(rectangle_store const& rects, tile_grid const& grid,
+    std::size_t i, std::optional<partition_tree::secs> timeout = {},
+    std::pmr::memory_resource* resource = std::pmr::get_default_resource(),
+    std::stop_token stop = {});
+
+// Tile files, the output of a tile built by another process, in the byte order of the host:
+//   header   magic "NITROTIL", u32 version, u32 tile, u32 tiles, u32 reserved, u64 input rows,
+//            u64 intersections, u64 members
+//   offsets  intersections + 1 u64
+//   members  u32 rows, padded to 8 bytes
+struct tile_header {
+    static constexpr std::array<char, 8> magic_value { 'N', 'I', 'T', 'R', 'O', 'T', 'I', 'L' };
+    static constexpr std::uint32_t       current_version = 1;
+
+    std::array<char, 8> magic;
+    std::uint32_t       version;
+    std::uint32_t       tile;
+    std::uint32_t       tiles;
+    std::uint32_t       reserved;
+    std::uint64_t       input_rows;
+    std::uint64_t       intersections;
+    std::uint64_t       members;
+};
+static_assert(sizeof(tile_header) == 48);
+
+void write_tile_intersections(std::ostream& os, tile_intersections const& part);
+// throws invalid_arg on a malformed file
+[[nodiscard]] tile_intersections read_tile_intersections(
+    std::istream& is, tile_intersections::allocator_type alloc = {});
+
+// Alternative engine to partition_tree for inputs too large to build at once, producing the
+// same intersection_set: the plane is cut into a grid of tiles, each built as a tree of its own,
+// and the intersections of the tiles are merged, those found in several tiles being told apart
+// by the ids of their constituents like the set always does. A tile only holds the rows reaching
+// into it, and is released once merged, so the build needs the memory of the tiles built at
+// once besides the input and the intersections. A rectangle reaching into several tiles is
+// built in each of them, so inputs of large or nested rectangles, spanning most tiles, take
+// longer than a single tree. Tiles may be built by other processes with build_tile and merged
+// here.
+struct tiled_tree {
+    using secs             = partition_tree::secs;
+    using intersection     = partition_tree::intersection;
+    using intersection_set = partition_tree::intersection_set;
+
+    // builds the tiles of the grid on threads workers, merging each as soon as it's done. The
+    // rectangles, tiles and intersections are allocated from a synchronized pool on top of
+    // resource, which needs no locking of its own. Throws timeout once timeout has passed since
+    // construction and cancelled soon after stop is requested, as partition_tree does.
+    tiled_tree(rectangle_store store, tile_grid const& grid, std::optional<secs> timeout = {},
+        std::size_t threads = 1,
+        std::pmr::memory_resource* resource = std::pmr::get_default_resource(),
+        std::stop_token stop = {});
+    // merges tiles built elsewhere from the same store; throws invalid_arg unless every tile of
+    // the grid they were built on is there exactly once
+    tiled_tree(rectangle_store store, std::span<const tile_intersections> parts,
+        std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+    tiled_tree(const tiled_tree&) = delete;
+    tiled_tree(tiled_tree&&)      = delete;
+    tiled_tree& operator=(const tiled_tree&) = delete;
+    tiled_tree& operator=(tiled_tree&&) = delete;
+
+    intersection_set const& intersections() const { return m_intersections; }
+
+private:
+    // the rows of the store as the roots of the set
+    void bind_roots();
+    void merge(tile_intersections const& part);
+
+    std::pmr::synchronized_pool_resource m_pool;
+    rectangle_store                      m_store;
+    rectangles_list                      m_rects;
+    std::pmr::vector<rect_ptr>           m_roots;
+    intersection_set                     m_intersections;
+};
+
+}
@@ -0,0 +1,74 @@
+#include <nitro/batch_intersect.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <limits>
+
+#if !defined(NITRO_NO_SIMD) && __has_include(<experimental/simd>)
+#include <experimental/simd>
+#define NITRO_HAS_SIMD 1
+#endif
+
+namespace nitro {
+
+namespace {
+    constexpr auto lowest  = std::numeric_limits<coordinate_t>::lowest();
+    constexpr auto highest = std::numeric_limits<coordinate_t>::max();
+
+    overlap_bounds overlap_scalar(coordinate_t const* origins, coordinate_t const* extents,
+        std::size_t n, overlap_bounds bounds) noexcept
+    {
+        for (std::size_t i = 0; i < n; ++i) {
+            bounds.first = std::max(bounds.first, origins[i]);
+            bounds.last  = std::min(bounds.last, origins[i] + extents[i]);
+        }
+        return bounds;
+    }
+}
+
+overlap_bounds overlap(
+    std::span<const coordinate_t> origins, std::span<const coordinate_t> extents) noexcept
+{
+    assert(origins.size() == extents.size());
+    const auto     n      = origins.size();
+    overlap_bounds bounds { lowest, highest };
+    std::size_t    i      = 0;
+#ifdef NITRO_HAS_SIMD
+    namespace stdx = std::experimental;
+    using vec_t    = stdx::native_simd<coordinate_t>;
+    constexpr auto width = vec_t::size();
+    if (n >= width) {
+        vec_t first(lowest), last(highest);
+        for (; i + width <= n; i += width) {
+            const vec_t o(origins.data() + i, stdx::element_aligned);
+            const vec_t e(extents.data() + i, stdx::element_aligned);
+            first = stdx::max(first, o);
+            last  = stdx::min(last, o + e);
+        }
+        bounds = { stdx::hmax(first), stdx::hmin(last) };
+    }
+#endif
+    return overlap_scalar(origins.data() + i, extents.data() + i, n - i, bounds);
+}
+
+std::optional<rectangle> intersect(std::span<const coordinate_t> xs,
+    std::span<const coordinate_t> ys, std::span<const coordinate_t> widths,
+    std::span<const coordinate_t> heights)
+{
+    if (xs.empty())
+        return std::nullopt;
+    const auto x = overlap(xs, widths);
+    if (x.last <= x.first)
+        return std::nullopt;
+    const auto y = overlap(ys, heights);
+    if (y.last <= y.first)
+        return std::nullopt;
+    return rectangle { { x.first, y.first }, { x.last - x.first, y.last - y.first } };
+}
+
+std::optional<rectangle> intersect(rectangle_store const& rows)
+{
+    return intersect(rows.xs(), rows.ys(), rows.widths(), rows.heights());
+}
+
+}
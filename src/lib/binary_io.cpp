@@ -0,0 +1,308 @@
+#include "nitro/exceptions.hpp"
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <nitro/binary_io.hpp>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace nitro {
+
+static_assert(std::endian::native == std::endian::little,
+    "binary rectangle files are read in place and need a little endian host");
+
+namespace {
+    template <typename T> void write_column(std::ostream& os, std::span<const T> column)
+    {
+        os.write(reinterpret_cast<char const*>(column.data()),
+            static_cast<std::streamsize>(column.size_bytes()));
+    }
+
+    // the id column as size_t, converted into storage only where the two types differ
+    template <typename Id>
+    std::span<const std::size_t> size_ids(
+        std::span<const Id> ids, std::vector<std::size_t>& storage)
+    {
+        if constexpr (std::is_same_v<Id, std::size_t>) {
+            return ids;
+        } else {
+            storage.assign(ids.begin(), ids.end());
+            return storage;
+        }
+    }
+
+    [[noreturn]] void throw_system_error(std::string const& what)
+    {
+#ifdef _WIN32
+        throw std::system_error(static_cast<int>(::GetLastError()), std::system_category(), what);
+#else
+        throw std::system_error(errno, std::generic_category(), what);
+#endif
+    }
+
+    // maps the whole file read-only, returns the address and the size in bytes
+    std::pair<void*, std::size_t> map_file(std::filesystem::path const& path)
+    {
+        const auto what = "cannot map " + path.string();
+#ifdef _WIN32
+        auto file = ::CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            throw_system_error(what);
+        LARGE_INTEGER size {};
+        if (!::GetFileSizeEx(file, &size)) {
+            ::CloseHandle(file);
+            throw_system_error(what);
+        }
+        if (size.QuadPart < static_cast<LONGLONG>(sizeof(binary_header))) {
+            ::CloseHandle(file);
+            throw invalid_arg("truncated binary rectangle file");
+        }
+        auto mapping = ::CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        ::CloseHandle(file);
+        if (mapping == nullptr)
+            throw_system_error(what);
+        // the view keeps the mapping alive
+        auto data = ::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        ::CloseHandle(mapping);
+        if (data == nullptr)
+            throw_system_error(what);
+        return { data, static_cast<std::size_t>(size.QuadPart) };
+#else
+        const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            throw_system_error(what);
+        struct stat st { };
+        if (::fstat(fd, &st) != 0) {
+            ::close(fd);
+            throw_system_error(what);
+        }
+        const auto size = static_cast<std::size_t>(st.st_size);
+        if (size < sizeof(binary_header)) {
+            ::close(fd);
+            throw invalid_arg("truncated binary rectangle file");
+        }
+        // the mapping outlives the descriptor
+        auto data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (data == MAP_FAILED)
+            throw_system_error(what);
+        return { data, size };
+#endif
+    }
+
+    // the core tells rectangles apart by their ids, so they have to be above 0 and distinct;
+    // ascending ids, as write_binary_rectangles keeps those of a sorted store, take one pass
+    void check_ids(std::span<const std::uint64_t> ids)
+    {
+        const auto distinct = [](auto const& sorted) {
+            return (sorted.empty() || sorted.front() != 0)
+                && rng::adjacent_find(sorted) == rng::end(sorted);
+        };
+        if (rng::adjacent_find(ids, std::greater_equal<> {}) == ids.end()) {
+            if (distinct(ids))
+                return;
+        } else {
+            std::vector<std::uint64_t> sorted(ids.begin(), ids.end());
+            rng::sort(sorted);
+            if (distinct(sorted))
+                return;
+        }
+        throw invalid_arg("rectangle ids have to be above 0 and distinct");
+    }
+
+    // the columns of a binary rectangle image of that many bytes, checked as mapped_rectangles
+    // documents it; what names the image in the errors
+    struct binary_columns {
+        std::span<const coordinate_t>  x, y, w, h;
+        std::span<const std::uint64_t> id;
+    };
+    binary_columns columns_of(void const* data, std::size_t bytes, std::string const& what)
+    {
+        if (bytes < sizeof(binary_header))
+            throw invalid_arg("truncated binary rectangle file");
+        binary_header header;
+        std::memcpy(&header, data, sizeof(header));
+        if (header.magic != binary_header::magic_value)
+            throw invalid_arg("not a binary rectangle file: " + what);
+        if (header.version != binary_header::current_version)
+            throw invalid_arg("unsupported binary rectangle file version");
+
+        const auto columns = (header.flags & binary_header::has_ids) != 0 ? 5u : 4u;
+        const auto payload = bytes - sizeof(header);
+        if (header.count > payload / (columns * sizeof(coordinate_t))
+            || payload != header.count * columns * sizeof(coordinate_t)) {
+            throw invalid_arg("truncated binary rectangle file");
+        }
+
+        const auto     n     = static_cast<std::size_t>(header.count);
+        const auto     first = reinterpret_cast<coordinate_t const*>(
+            static_cast<char const*>(data) + sizeof(header));
+        binary_columns result { { first, n }, { first + n, n }, { first + 2 * n, n },
+            { first + 3 * n, n }, {} };
+        if (columns == 5)
+            result.id = { reinterpret_cast<std::uint64_t const*>(first + 4 * n), n };
+
+        if (rng::any_of(result.w, [](auto w) { return w < 1; })
+            || rng::any_of(result.h, [](auto h) { return h < 1; })) {
+            throw invalid_arg("invalid height or width");
+        }
+        check_ids(result.id);
+        return result;
+    }
+
+    // copies the first max_cnt rows of the columns into a store
+    rectangle_store append_columns(
+        binary_columns const& c, const size_t max_cnt, rectangle_store::allocator_type alloc)
+    {
+        const auto n = std::min(c.x.size(), max_cnt);
+        if (n < c.x.size())
+            std::cerr << "Discarding rectangles over " << max_cnt << "...\n";
+
+        std::vector<std::size_t> ids;
+        rectangle_store          result(alloc);
+        result.reserve(n);
+        result.append(c.x.first(n), c.y.first(n), c.w.first(n), c.h.first(n),
+            size_ids(c.id.first(c.id.empty() ? 0 : n), ids));
+        return result;
+    }
+
+    void unmap_file(void* data, [[maybe_unused]] std::size_t bytes) noexcept
+    {
+#ifdef _WIN32
+        ::UnmapViewOfFile(data);
+#else
+        ::munmap(data, bytes);
+#endif
+    }
+}
+
+bool is_binary_rectangles(std::istream& is)
+{
+    std::array<char, binary_header::magic_value.size()> magic {};
+    const auto                                          pos = is.tellg();
+    is.read(magic.data(), magic.size());
+    const auto matches = is.gcount() == static_cast<std::streamsize>(magic.size())
+        && magic == binary_header::magic_value;
+    is.clear();
+    is.seekg(pos);
+    return matches;
+}
+
+void write_binary_rectangles(std::ostream& os, rectangle_store const& store)
+{
+    std::size_t expected = 0;
+    const auto  with_ids
+        = !rng::all_of(store.ids(), [&expected](auto id) { return id == ++expected; });
+
+    binary_header header { binary_header::magic_value, binary_header::current_version,
+        with_ids ? binary_header::has_ids : 0, store.size() };
+    os.write(reinterpret_cast<char const*>(&header), sizeof(header));
+    write_column(os, store.xs());
+    write_column(os, store.ys());
+    write_column(os, store.widths());
+    write_column(os, store.heights());
+    if (with_ids) {
+        static_assert(sizeof(std::size_t) <= sizeof(std::uint64_t));
+        if constexpr (sizeof(std::size_t) == sizeof(std::uint64_t)) {
+            write_column(os, store.ids());
+        } else {
+            const std::vector<std::uint64_t> ids(store.ids().begin(), store.ids().end());
+            write_column(os, std::span<const std::uint64_t>(ids));
+        }
+    }
+}
+
+mapped_rectangles::mapped_rectangles(std::filesystem::path const& path)
+{
+    std::tie(m_data, m_bytes) = map_file(path);
+    try {
+        const auto c = columns_of(m_data, m_bytes, path.string());
+        m_x          = c.x;
+        m_y          = c.y;
+        m_w          = c.w;
+        m_h          = c.h;
+        m_id         = c.id;
+    } catch (...) {
+        unmap();
+        throw;
+    }
+}
+
+mapped_rectangles::mapped_rectangles(mapped_rectangles&& other) noexcept
+    : m_data(std::exchange(other.m_data, nullptr))
+    , m_bytes(std::exchange(other.m_bytes, 0))
+    , m_x(std::exchange(other.m_x, {}))
+    , m_y(std::exchange(other.m_y, {}))
+    , m_w(std::exchange(other.m_w, {}))
+    , m_h(std::exchange(other.m_h, {}))
+    , m_id(std::exchange(other.m_id, {}))
+{
+}
+
+mapped_rectangles& mapped_rectangles::operator=(mapped_rectangles&& other) noexcept
+{
+    if (this != &other) {
+        unmap();
+        m_data  = std::exchange(other.m_data, nullptr);
+        m_bytes = std::exchange(other.m_bytes, 0);
+        m_x     = std::exchange(other.m_x, {});
+        m_y     = std::exchange(other.m_y, {});
+        m_w     = std::exchange(other.m_w, {});
+        m_h     = std::exchange(other.m_h, {});
+        m_id    = std::exchange(other.m_id, {});
+    }
+    return *this;
+}
+
+mapped_rectangles::~mapped_rectangles() { unmap(); }
+
+void mapped_rectangles::unmap() noexcept
+{
+    if (m_data != nullptr)
+        unmap_file(m_data, m_bytes);
+    m_data  = nullptr;
+    m_bytes = 0;
+    m_x = m_y = m_w = m_h = {};
+    m_id                  = {};
+}
+
+rectangle_store to_rectangle_store(
+    mapped_rectangles const& mapped, const size_t max_cnt, rectangle_store::allocator_type alloc)
+{
+    return append_columns({ mapped.xs(), mapped.ys(), mapped.widths(), mapped.heights(),
+                              mapped.ids() },
+        max_cnt, alloc);
+}
+
+rectangle_store to_rectangle_store(
+    std::span<const std::byte> bytes, const size_t max_cnt, rectangle_store::allocator_type alloc)
+{
+    if (reinterpret_cast<std::uintptr_t>(bytes.data()) % alignof(coordinate_t) != 0)
+        throw invalid_arg("binary rectangles in memory have to be 8 byte aligned");
+    return append_columns(columns_of(bytes.data(), bytes.size(), "in memory"), max_cnt, alloc);
+}
+
+}
@@ -0,0 +1,25 @@
+#include <nitro/deadline.hpp>
+
+namespace nitro {
+
+deadline::deadline(std::optional<clock::duration> timeout, std::stop_token stop)
+    : m_stop(std::move(stop))
+{
+    if (timeout)
+        m_end = clock::now() + *timeout;
+}
+
+bool deadline::passed() const noexcept
+{
+    return m_stop.stop_requested() || (m_end && clock::now() > *m_end);
+}
+
+void deadline::check() const
+{
+    if (m_stop.stop_requested())
+        throw cancelled("Calculation cancelled ...");
+    if (m_end && clock::now() > *m_end)
+        throw timeout("Calculation timed out ...");
+}
+
+}
@@ -0,0 +1,184 @@
+#include "nitro/exceptions.hpp"
+#include "nitro/fwd.hpp"
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <limits>
+#include <nitro/batch_intersect.hpp>
+#include <nitro/intersection_set.hpp>
+#include <numeric>
+#include <stdexcept>
+
+namespace nitro {
+
+bool intersection::operator<(const intersection& other) const noexcept
+{
+    if (m_members.size() != other.m_members.size())
+        return m_members.size() < other.m_members.size();
+    return rng::lexicographical_compare(
+        constituents(), other.constituents(), std::less<>(), to_id(), to_id());
+}
+
+bool intersection::operator==(const intersection& other) const noexcept
+{
+    return rng::equal(constituents(), other.constituents());
+}
+
+rectangle intersection::calculate() const
+{
+    std::array<std::byte, 1024>         buffer;
+    std::pmr::monotonic_buffer_resource resource(buffer.data(), buffer.size());
+    std::pmr::vector<coordinate_t>      columns(&resource);
+    return calculate(columns);
+}
+
+// gathers the roots into four coordinate columns laid out back to back in buffer and reduces
+// them with the batch kernel
+rectangle intersection::calculate(std::pmr::vector<coordinate_t>& buffer) const
+{
+    const auto n = m_members.size();
+    buffer.resize(4 * n);
+    const auto xs = buffer.data(), ys = xs + n, ws = ys + n, hs = ws + n;
+    for (std::size_t i = 0; i < n; ++i) {
+        const auto& r = *m_roots[m_members[i]];
+        xs[i]         = r.origin().x;
+        ys[i]         = r.origin().y;
+        ws[i]         = r.width();
+        hs[i]         = r.height();
+    }
+    auto result = nitro::intersect({ xs, n }, { ys, n }, { ws, n }, { hs, n });
+    if (!result)
+        throw std::logic_error("must have intersections...");
+    return *result;
+}
+
+intersection_set::intersection_set(std::span<const rect_ptr> roots, allocator_type alloc)
+    : m_roots(roots)
+    , m_ids(alloc)
+    , m_offsets(1, 0, alloc)
+    , m_hashes(alloc)
+    , m_slots(alloc)
+    , m_order(alloc)
+{
+}
+
+std::size_t intersection_set::memory_usage() const noexcept
+{
+    return m_ids.capacity() * sizeof(index_t) + m_offsets.capacity() * sizeof(std::size_t)
+        + m_hashes.capacity() * sizeof(std::uint64_t)
+        + (m_slots.capacity() + m_order.capacity()) * sizeof(std::uint32_t);
+}
+
+bool intersection_set::insert(std::span<index_t> members)
+{
+    const auto id_of = [&](index_t i) { return m_roots[i]->id(); };
+    rng::sort(members, std::less<> {}, id_of);
+    const auto last = rng::unique(members, std::equal_to<> {}, id_of).begin();
+    members         = members.first(static_cast<std::size_t>(last - members.begin()));
+    if (members.size() < 2)
+        throw invalid_arg("intersection must be at least between two rectangles");
+    std::uint64_t hash {};
+    for (auto i : members)
+        hash += id_key(id_of(i));
+    return insert_run(hash, members);
+}
+
+void intersection_set::merge(intersection_set const& other)
+{
+    for (std::size_t i = 0; i < other.size(); ++i)
+        insert_run(other.m_hashes[i], other.at(i).members());
+}
+
+bool intersection_set::insert_run(std::uint64_t hash, std::span<const index_t> members)
+{
+    if (2 * (size() + 1) > m_slots.size())
+        grow();
+    const auto mask = m_slots.size() - 1;
+    auto       slot = hash & mask;
+    for (; m_slots[slot] != 0; slot = (slot + 1) & mask) {
+        const auto i = m_slots[slot] - 1;
+        if (m_hashes[i] == hash && rng::equal(at(i).members(), members))
+            return false;
+    }
+    if (size() == std::numeric_limits<std::uint32_t>::max())
+        throw std::length_error("too many intersections");
+    m_slots[slot] = static_cast<std::uint32_t>(size() + 1);
+    m_order.push_back(static_cast<std::uint32_t>(size()));
+    m_hashes.push_back(hash);
+    m_ids.insert(m_ids.end(), members.begin(), members.end());
+    m_offsets.push_back(m_ids.size());
+    return true;
+}
+
+std::size_t intersection_set::erase(std::span<const std::uint8_t> erased)
+{
+    // the runs kept move to the front of the arena, renumbered[i] is the new number of the i-th
+    std::pmr::vector<std::uint32_t> renumbered(size(), m_order.get_allocator());
+    const auto                      before = size();
+    std::size_t                     kept   = 0;
+    for (std::size_t i = 0; i < before; ++i) {
+        const auto first = m_offsets[i], last = m_offsets[i + 1];
+        if (erased[i] != 0)
+            continue;
+        const auto to = m_offsets[kept];
+        if (to != first) {
+            std::copy(m_ids.begin() + static_cast<std::ptrdiff_t>(first),
+                m_ids.begin() + static_cast<std::ptrdiff_t>(last),
+                m_ids.begin() + static_cast<std::ptrdiff_t>(to));
+        }
+        m_offsets[kept + 1] = to + (last - first);
+        m_hashes[kept]      = m_hashes[i];
+        renumbered[i]       = static_cast<std::uint32_t>(kept++);
+    }
+    if (kept == before)
+        return 0;
+    m_ids.resize(m_offsets[kept]);
+    m_offsets.resize(kept + 1);
+    m_hashes.resize(kept);
+    std::erase_if(m_order, [&](auto i) { return erased[i] != 0; });
+    for (auto& i : m_order)
+        i = renumbered[i];
+    reindex(m_slots.size());
+    return before - kept;
+}
+
+void intersection_set::replace_root(index_t from, index_t to) noexcept
+{
+    assert(m_roots[from]->id() == m_roots[to]->id());
+    rng::replace(m_ids, from, to);
+}
+
+// doubles the index, at most half of the slots are ever taken
+void intersection_set::grow()
+{
+    reindex(std::max<std::size_t>(16, 2 * m_slots.size()));
+}
+
+// rebuilds the index with that many slots, a power of two
+void intersection_set::reindex(std::size_t count)
+{
+    std::pmr::vector<std::uint32_t> slots(count, 0, m_slots.get_allocator());
+    const auto                      mask = slots.size() - 1;
+    for (std::size_t i = 0; i < size(); ++i) {
+        auto slot = m_hashes[i] & mask;
+        while (slots[slot] != 0)
+            slot = (slot + 1) & mask;
+        slots[slot] = static_cast<std::uint32_t>(i + 1);
+    }
+    m_slots.swap(slots);
+}
+
+void intersection_set::sort()
+{
+    rng::sort(m_order, [&](auto lhs, auto rhs) { return at(lhs) < at(rhs); });
+}
+
+void intersection_set::sort(std::size_t sorted)
+{
+    const auto less   = [&](auto lhs, auto rhs) { return at(lhs) < at(rhs); };
+    const auto middle = m_order.begin() + static_cast<std::ptrdiff_t>(sorted);
+    std::sort(middle, m_order.end(), less);
+    std::inplace_merge(m_order.begin(), middle, m_order.end(), less);
+}
+
+}
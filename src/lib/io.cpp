@@ -1,9 +1,15 @@
 #include "nitro/fwd.hpp"
 #include "nitro/rectangle.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
 #include <iostream>
+#include <limits>
 #include <nitro/io.hpp>
 #include <nlohmann/json_fwd.hpp>
+#include <optional>
 #include <ranges>
+#include <string>
 namespace nitro {
 
 rectangle to_rectangle(nlohmann::json j, std::size_t id)
@@ -27,6 +33,187 @@ rectangles_list to_rectangles(nlohmann::json j, const size_t max_cnt)
     return result;
 }
 
+rectangle_store to_rectangle_store(nlohmann::json j, const size_t max_cnt)
+{
+    const auto&     arr = j["rects"].get<nlohmann::json::array_t>();
+    rectangle_store result;
+    result.reserve(std::min(arr.size(), max_cnt));
+    for (const auto& v : arr) {
+        if (result.size() >= max_cnt) {
+            std::cerr << "Discarding rectangles over " << max_cnt << "...\n";
+            break;
+        }
+        result.push_back({ v["x"].get<coordinate_t>(), v["y"].get<coordinate_t>() },
+            { v["w"].get<coordinate_t>(), v["h"].get<coordinate_t>() }, result.size() + 1);
+    }
+    return result;
+}
+
+rectangles_list to_rectangles(rectangle_store const& store)
+{
+    rectangles_list result;
+    result.reserve(store.size());
+    for (std::size_t i = 0; i < store.size(); ++i)
+        result.push_back(store.rect(i));
+    return result;
+}
+
+namespace {
+    // Tracks the nesting while the parser walks the text: depth 1 is the top level object,
+    // 2 the "rects" array and 3 a rectangle, anything else is skipped over.
+    struct rectangles_sax : nlohmann::json_sax<nlohmann::json> {
+        rectangles_sax(rectangle_store& store, std::size_t max_cnt)
+            : m_store(store)
+            , m_max_cnt(max_cnt)
+        {
+        }
+
+        bool null() override { return scalar(std::nullopt); }
+        bool boolean(bool) override { return scalar(std::nullopt); }
+        bool number_integer(number_integer_t val) override { return scalar(val); }
+        bool number_unsigned(number_unsigned_t val) override
+        {
+            if (val > static_cast<number_unsigned_t>(std::numeric_limits<coordinate_t>::max()))
+                return scalar(std::nullopt, not_integral);
+            return scalar(static_cast<coordinate_t>(val));
+        }
+        // 160.0 is taken as 160, but a fraction would be cut off, so it's rejected
+        bool number_float(number_float_t val, const string_t&) override
+        {
+            if (std::trunc(val) != val || !(val >= -0x1p63 && val < 0x1p63))
+                return scalar(std::nullopt, not_integral);
+            return scalar(static_cast<coordinate_t>(val));
+        }
+        bool string(string_t&) override { return scalar(std::nullopt); }
+        bool binary(binary_t&) override { return scalar(std::nullopt); }
+
+        bool start_object(std::size_t) override
+        {
+            if (at_rects())
+                throw invalid_arg("\"rects\" must be an array");
+            if (at_rect()) {
+                if (m_store.size() >= m_max_cnt) {
+                    std::cerr << "Discarding rectangles over " << m_max_cnt << "...\n";
+                    return false;
+                }
+                m_fields = {};
+            }
+            ++m_depth;
+            return true;
+        }
+        bool end_object() override
+        {
+            --m_depth;
+            if (at_rect()) {
+                if (!rng::all_of(m_fields, [](auto const& f) { return f.has_value(); }))
+                    throw invalid_arg("rectangle without x, y, w and h");
+                const auto [x, y, w, h] = m_fields;
+                m_store.push_back({ *x, *y }, { *w, *h }, m_store.size() + 1);
+            }
+            return true;
+        }
+        bool start_array(std::size_t) override
+        {
+            if (m_depth == 0)
+                throw invalid_arg("JSON input must be an object");
+            if (at_rect())
+                throw invalid_arg("\"rects\" must hold objects");
+            if (at_rects())
+                m_in_rects = true;
+            ++m_depth;
+            return true;
+        }
+        bool end_array() override
+        {
+            --m_depth;
+            if (m_in_rects && m_depth == 1) {
+                m_in_rects = false;
+                m_found    = true;
+            }
+            return true;
+        }
+        bool key(string_t& val) override
+        {
+            if (m_depth == 1 || (m_in_rects && m_depth == 3))
+                m_key = val;
+            return true;
+        }
+        bool parse_error(
+            std::size_t, const std::string&, const nlohmann::detail::exception& ex) override
+        {
+            throw invalid_arg(std::string("invalid JSON input: ") + ex.what());
+        }
+
+        // the "rects" array was read to its end, or up to max_cnt
+        [[nodiscard]] bool found() const noexcept { return m_found || m_in_rects; }
+
+    private:
+        // the value of the first top level "rects" key
+        [[nodiscard]] bool at_rects() const noexcept
+        {
+            return m_depth == 1 && !m_found && m_key == "rects";
+        }
+        // an element of the "rects" array
+        [[nodiscard]] bool at_rect() const noexcept { return m_in_rects && m_depth == 2; }
+
+        static constexpr auto not_number   = "rectangle coordinates must be numbers";
+        static constexpr auto not_integral = "rectangle coordinates must be 64 bit integers";
+
+        // val is empty if the value can't be a coordinate, why being told by what
+        bool scalar(std::optional<coordinate_t> val, char const* what = not_number)
+        {
+            if (m_depth == 0)
+                throw invalid_arg("JSON input must be an object");
+            if (at_rects())
+                throw invalid_arg("\"rects\" must be an array");
+            if (at_rect())
+                throw invalid_arg("\"rects\" must hold objects");
+            if (!m_in_rects || m_depth != 3)
+                return true;
+            constexpr std::array<std::string_view, 4> names { "x", "y", "w", "h" };
+            const auto it = rng::find(names, m_key);
+            if (it == names.end())
+                return true;
+            if (!val)
+                throw invalid_arg(what);
+            m_fields[static_cast<std::size_t>(it - names.begin())] = val;
+            return true;
+        }
+
+        rectangle_store&                           m_store;
+        std::size_t                                m_max_cnt;
+        std::size_t                                m_depth {};
+        std::string                                m_key;
+        std::array<std::optional<coordinate_t>, 4> m_fields {};
+        bool                                       m_in_rects { false };
+        bool                                       m_found { false };
+    };
+
+    template <typename Input>
+    rectangle_store read_store(
+        Input&& input, std::size_t max_cnt, rectangle_store::allocator_type alloc)
+    {
+        rectangle_store result(alloc);
+        rectangles_sax  sax(result, max_cnt);
+        nlohmann::json::sax_parse(std::forward<Input>(input), &sax);
+        if (!sax.found())
+            throw invalid_arg("missing \"rects\" array");
+        return result;
+    }
+}
+
+rectangle_store read_rectangle_store(
+    std::istream& is, std::size_t max_cnt, rectangle_store::allocator_type alloc)
+{
+    return read_store(is, max_cnt, alloc);
+}
+
+rectangle_store read_rectangle_store(
+    std::string_view text, std::size_t max_cnt, rectangle_store::allocator_type alloc)
+{
+    return read_store(text, max_cnt, alloc);
+}
+
 std::ostream& operator<<(std::ostream& os, const point& p)
 {
     return os << '(' << p.x << ',' << p.y << ')';
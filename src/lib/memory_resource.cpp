@@ -0,0 +1,110 @@
+#include <algorithm>
+#include <mutex>
+#include <nitro/memory_resource.hpp>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace nitro {
+
+memory_stats stats_resource::stats() const noexcept
+{
+    return { m_allocations.load(std::memory_order_relaxed),
+        m_deallocations.load(std::memory_order_relaxed), m_bytes.load(std::memory_order_relaxed),
+        m_in_use.load(std::memory_order_relaxed), m_peak.load(std::memory_order_relaxed) };
+}
+
+void stats_resource::reset() noexcept
+{
+    m_allocations.store(0, std::memory_order_relaxed);
+    m_deallocations.store(0, std::memory_order_relaxed);
+    m_bytes.store(0, std::memory_order_relaxed);
+    m_peak.store(m_in_use.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+void* stats_resource::do_allocate(std::size_t bytes, std::size_t align)
+{
+    auto p = m_upstream->allocate(bytes, align);
+    m_allocations.fetch_add(1, std::memory_order_relaxed);
+    m_bytes.fetch_add(bytes, std::memory_order_relaxed);
+    const auto in_use = m_in_use.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    auto       peak   = m_peak.load(std::memory_order_relaxed);
+    while (peak < in_use && !m_peak.compare_exchange_weak(peak, in_use, std::memory_order_relaxed))
+        ;
+    return p;
+}
+
+void stats_resource::do_deallocate(void* p, std::size_t bytes, std::size_t align)
+{
+    m_upstream->deallocate(p, bytes, align);
+    m_deallocations.fetch_add(1, std::memory_order_relaxed);
+    m_in_use.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+struct thread_pools::local_pools {
+    using pool = std::pmr::unsynchronized_pool_resource;
+
+    std::mutex                                                 mx;
+    std::unordered_map<std::thread::id, std::unique_ptr<pool>> pools;
+};
+
+namespace {
+    std::atomic_uint64_t generations {};
+
+    // the pools the thread got from every thread_pools it called local() on, which it gives
+    // back on exit to those still around
+    struct pools_of_thread {
+        struct entry {
+            std::uint64_t                            generation;
+            std::weak_ptr<thread_pools::local_pools> owner;
+            std::pmr::memory_resource*               pool;
+        };
+
+        pools_of_thread() = default;
+        pools_of_thread(const pools_of_thread&) = delete;
+        pools_of_thread& operator=(const pools_of_thread&) = delete;
+        ~pools_of_thread()
+        {
+            for (const auto& e : entries) {
+                if (const auto owner = e.owner.lock()) {
+                    std::lock_guard l(owner->mx);
+                    owner->pools.erase(std::this_thread::get_id());
+                }
+            }
+        }
+
+        std::vector<entry> entries;
+    };
+    thread_local pools_of_thread this_thread_pools;
+}
+
+thread_pools::thread_pools(std::pmr::memory_resource* upstream, std::pmr::pool_options opts)
+    : m_upstream(upstream)
+    , m_opts(opts)
+    , m_shared(opts, upstream)
+    , m_local(std::make_shared<local_pools>())
+    , m_generation(generations.fetch_add(1, std::memory_order_relaxed))
+{
+}
+
+std::pmr::memory_resource* thread_pools::local()
+{
+    auto& entries = this_thread_pools.entries;
+    for (const auto& e : entries) {
+        if (e.generation == m_generation)
+            return e.pool;
+    }
+    // the first call from this thread; forget the thread_pools gone meanwhile
+    std::erase_if(entries, [](auto const& e) { return e.owner.expired(); });
+    std::pmr::memory_resource* pool {};
+    {
+        std::lock_guard l(m_local->mx);
+        auto& p = m_local->pools[std::this_thread::get_id()];
+        p       = std::make_unique<local_pools::pool>(m_opts, m_upstream);
+        pool    = p.get();
+    }
+    entries.push_back({ m_generation, m_local, pool });
+    return pool;
+}
+
+}
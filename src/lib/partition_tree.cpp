@@ -2,184 +2,859 @@
 #include "nitro/fwd.hpp"
 #include "nitro/rectangle.hpp"
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
 #include <cassert>
 #include <chrono>
 #include <cstddef>
+#include <cstdint>
+#include <deque>
 #include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <nitro/batch_intersect.hpp>
+#include <nitro/deadline.hpp>
+#include <nitro/memory_resource.hpp>
 #include <nitro/partition_tree.hpp>
+#include <nitro/stats.hpp>
+#include <nitro/task_pool.hpp>
 #include <numeric>
 #include <optional>
 #include <ranges>
+#include <span>
 #include <stdexcept>
 #include <variant>
+#include <vector>
 
 namespace nitro {
 
-using pt = partition_tree;
+using pt      = partition_tree;
+using index_t = rectangle_store::index_t;
 
-template <typename orientation_type>
-void build_nodes_impl(pt::tp start, std::optional<pt::secs> const& to, rectangles_list& rects,
-    sorted_rectangles&& sorted_rects, pt::intersection_set& intersections);
+namespace {
+    // a subtree still to be built: its rectangles in the ordering of the orientation it is
+    // sliced along next
+    template <typename orientation_type> struct pending {
+        sorted_rectangles_of_t<orientation_type> rects;
+    };
+    using frame
+        = std::variant<pending<vertical>, pending<horizontal>, pending<rev_vertical>,
+            pending<rev_horizontal>>;
+    // the subtrees left to build, depth first: the build loops over it instead of recursing,
+    // so deep partitions grow this vector rather than the call stack
+    using frame_stack = std::pmr::vector<frame>;
+    // frames the work stack holds in a buffer on the building thread's own stack, which is
+    // enough for the depth of most builds; deeper ones spill over to the build's pool, up to
+    // partition_tree::max_pending_subtrees frames
+    constexpr std::size_t inline_frames = 32;
+    static_assert(inline_frames <= pt::max_pending_subtrees);
 
-void partition_tree::build()
+    std::size_t size_of(frame const& f)
+    {
+        return std::visit([](auto const& p) { return p.rects.size(); }, f);
+    }
+
+    pt::region region_of(frame const& f)
+    {
+        const auto& rows
+            = std::visit([](auto const& p) -> auto const& { return p.rects.rows(); }, f);
+        const auto  xs = rows.xs(), ys = rows.ys(), ws = rows.widths(), hs = rows.heights();
+        point       low { rng::min(xs), rng::min(ys) }, high = low;
+        for (std::size_t i = 0; i < rows.size(); ++i) {
+            high.x = std::max(high.x, xs[i] + ws[i]);
+            high.y = std::max(high.y, ys[i] + hs[i]);
+        }
+        return { rectangle(low, { high.x - low.x, high.y - low.y }), rows.size() };
+    }
+
+    // subtrees of up to this many rows are read off their grid of cells rather than split,
+    // a cell telling the rows covering it by the bits of a 64 bit mask
+    constexpr std::size_t small_subtree = 32;
+    static_assert(small_subtree <= 64);
+
+    // adds the roots of every distinct set of two or more rows covering a cell of the grid laid
+    // out by the edges of the rows, which are all the intersections in the subtree
+    template <typename Build> void add_cells(Build& ctx, rectangle_store const& rows)
+    {
+        const auto m  = rows.size();
+        const auto xs = rows.xs(), ys = rows.ys(), ws = rows.widths(), hs = rows.heights();
+        std::array<coordinate_t, 2 * small_subtree> x_buffer, y_buffer;
+        for (std::size_t i = 0; i < m; ++i) {
+            x_buffer[2 * i]     = xs[i];
+            x_buffer[2 * i + 1] = xs[i] + ws[i];
+            y_buffer[2 * i]     = ys[i];
+            y_buffer[2 * i + 1] = ys[i] + hs[i];
+        }
+        const auto edges = [&](auto& buffer) {
+            const auto first = buffer.begin(), last = first + static_cast<std::ptrdiff_t>(2 * m);
+            std::sort(first, last);
+            return std::span<const coordinate_t>(first, std::unique(first, last));
+        };
+        const auto x_edges = edges(x_buffer), y_edges = edges(y_buffer);
+        const auto index   = [](auto edges, coordinate_t c) {
+            return static_cast<std::size_t>(rng::lower_bound(edges, c) - edges.begin());
+        };
+
+        // cell x * y_cells + y lies between the x-th and the next x edge, and so on
+        const auto y_cells = y_edges.size() - 1;
+        std::array<std::uint64_t, (2 * small_subtree - 1) * (2 * small_subtree - 1)> grid;
+        const auto cells = std::span(grid).first((x_edges.size() - 1) * y_cells);
+        rng::fill(cells, 0);
+        for (std::size_t i = 0; i < m; ++i) {
+            const auto x0 = index(x_edges, xs[i]), x1 = index(x_edges, xs[i] + ws[i]);
+            const auto y0 = index(y_edges, ys[i]), y1 = index(y_edges, ys[i] + hs[i]);
+            for (auto x = x0; x < x1; ++x) {
+                for (auto y = y0; y < y1; ++y)
+                    cells[x * y_cells + y] |= std::uint64_t { 1 } << i;
+            }
+        }
+
+        rng::sort(cells);
+        std::array<index_t, small_subtree> members;
+        for (auto it = cells.begin(); it != cells.end();) {
+            const auto mask = *it;
+            it              = std::upper_bound(it, cells.end(), mask);
+            if (std::popcount(mask) < 2)
+                continue;
+            std::size_t   n = 0;
+            std::uint64_t hash {};
+            for (std::size_t i = 0; i < m; ++i) {
+                if (mask >> i & 1) {
+                    members[n++] = rows.parent(i);
+                    hash += ctx.keys[rows.parent(i)];
+                }
+            }
+            ctx.add(hash, std::span(members).first(n));
+        }
+    }
+
+    // true if every row lies within the next larger one, the intersections then being the
+    // largest rows down to each distinct one, which are added
+    template <typename Build> bool add_nested(Build& ctx, rectangle_store const& rows)
+    {
+        const auto xs = rows.xs(), ys = rows.ys(), ws = rows.widths(), hs = rows.heights();
+        // a row within another is no wider and no higher, so ordering by the extents orders by
+        // containment without multiplying them, which could overflow
+        const auto extent   = [&](std::size_t i) { return std::pair(ws[i], hs[i]); };
+        const auto contains = [&](std::size_t outer, std::size_t inner) {
+            return xs[outer] <= xs[inner] && ys[outer] <= ys[inner]
+                && xs[inner] + ws[inner] <= xs[outer] + ws[outer]
+                && ys[inner] + hs[inner] <= ys[outer] + hs[outer];
+        };
+        // most subtrees fail already here, before anything is sorted
+        const auto all     = views::iota(std::size_t { 0 }, rows.size());
+        const auto largest = *rng::max_element(all, std::less<> {}, extent);
+        if (!rng::all_of(all, [&](auto i) { return contains(largest, i); }))
+            return false;
+        std::pmr::vector<index_t> order(all.begin(), all.end(), ctx.resource);
+        rng::sort(order, std::greater<> {}, extent);
+        for (std::size_t k = 1; k < order.size(); ++k) {
+            if (!contains(order[k - 1], order[k]))
+                return false;
+        }
+        std::pmr::vector<index_t> run(ctx.resource), members(ctx.resource);
+        std::uint64_t             hash {};
+        for (std::size_t k = 0; k < order.size(); ++k) {
+            run.push_back(rows.parent(order[k]));
+            hash += ctx.keys[run.back()];
+            // rows equal to the next one share all cells with it
+            const auto last = k + 1 == order.size() || extent(order[k + 1]) != extent(order[k]);
+            if (last && run.size() > 1) {
+                members.assign(run.begin(), run.end());
+                ctx.add(hash, members);
+            }
+        }
+        return true;
+    }
+
+    // true if the intersections of the subtree could be added without splitting it
+    template <typename Build> bool read_off(Build& ctx, rectangle_store const& rows)
+    {
+        if (rows.size() > small_subtree)
+            return add_nested(ctx, rows);
+        add_cells(ctx, rows);
+        return true;
+    }
+
+    // state of a single threaded build, every subtree is built by the calling thread
+    struct serial_build {
+        deadline const&                until;
+        bool                           partial;
+        std::pmr::vector<pt::region>&  unexplored;
+        std::span<const rect_ptr>      roots;
+        std::span<const std::uint64_t> keys;
+        pt::intersection_set&          intersections;
+        std::pmr::memory_resource*     resource;
+        pt::progress_callback const&   on_progress;
+        build_stats&                   stats;
+        std::size_t                    subtrees {};
+
+        void add(std::uint64_t, std::span<index_t> members) { intersections.insert(members); }
+        void fork(frame_stack& stack, frame&& f) { stack.push_back(std::move(f)); }
+        void leave(frame const& f) { unexplored.push_back(region_of(f)); }
+        void step(std::size_t pending)
+        {
+            if (++subtrees % pt::progress_interval == 0 && on_progress)
+                on_progress({ subtrees, pending });
+        }
+        void count(build_stats const& counted) { stats += counted; }
+    };
+
+    // state of a build spread over a task_pool: the intersections are collected in sets
+    // sharded by the hash of their constituents, so that one found by several threads meets
+    // itself in the same set, and threads adding different ones mostly take different locks
+    struct parallel_build {
+        // subtrees below this size are built inline instead of being forked as a new task
+        static constexpr std::size_t fork_cutoff = 64;
+        static constexpr std::size_t shard_count = 64;
+
+        struct shard {
+            shard(std::span<const rect_ptr> roots, std::pmr::memory_resource* r)
+                : intersections(roots, r)
+            {
+            }
+            std::mutex           mx;
+            pt::intersection_set intersections;
+        };
+
+        parallel_build(deadline const& until, bool partial,
+            std::pmr::vector<pt::region>& unexplored, std::span<const rect_ptr> roots,
+            std::span<const std::uint64_t> keys, task_pool& pool,
+            std::pmr::memory_resource* resource, pt::progress_callback const& on_progress,
+            build_stats& stats)
+            : until(until)
+            , partial(partial)
+            , unexplored(unexplored)
+            , roots(roots)
+            , keys(keys)
+            , pool(pool)
+            , resource(resource)
+            , on_progress(on_progress)
+            , stats(stats)
+        {
+            for (std::size_t i = 0; i < shard_count; ++i)
+                shards.emplace_back(roots, resource);
+        }
+
+        // hash picks the shard, so that equal intersections always end up in the same
+        void add(std::uint64_t hash, std::span<index_t> members)
+        {
+            auto&           s = shard_of(hash);
+            std::lock_guard l(s.mx);
+            s.intersections.insert(members);
+        }
+        shard& shard_of(std::uint64_t hash) { return shards[hash % shard_count]; }
+        // small subtrees stay on the stack of the forking task, larger ones become a task
+        void fork(frame_stack& stack, frame&& f);
+        void step(std::size_t pending)
+        {
+            const auto n = subtrees.fetch_add(1, std::memory_order_relaxed) + 1;
+            if (n % pt::progress_interval == 0 && on_progress) {
+                std::lock_guard l(progress_mx);
+                on_progress({ n, pending });
+            }
+        }
+        void count(build_stats const& counted)
+        {
+            std::lock_guard l(stats_mx);
+            stats += counted;
+        }
+        void leave(frame const& f)
+        {
+            auto            r = region_of(f);
+            std::lock_guard l(unexplored_mx);
+            unexplored.push_back(r);
+        }
+
+        void merge_into(pt::intersection_set& result)
+        {
+            for (auto& s : shards)
+                result.merge(s.intersections);
+        }
+
+        deadline const&                until;
+        bool                           partial;
+        std::pmr::vector<pt::region>&  unexplored;
+        std::span<const rect_ptr>      roots;
+        std::span<const std::uint64_t> keys;
+        task_pool&                     pool;
+        std::pmr::memory_resource*     resource;
+        pt::progress_callback const&   on_progress;
+        build_stats&                   stats;
+        std::atomic_size_t             subtrees {};
+        std::mutex                     progress_mx;
+        std::mutex                     stats_mx;
+        std::mutex                     unexplored_mx;
+        std::deque<shard>              shards;
+    };
+
+    // state of an intersection_stream's build: the subtrees are built by whoever pulls, and
+    // the intersections not seen before are queued for them
+    struct stream_build {
+        static constexpr bool partial = false;
+
+        std::span<const std::uint64_t> keys;
+        std::pmr::memory_resource*     resource;
+        pt::intersection_set&          seen;
+        std::pmr::vector<std::size_t>& fresh;
+
+        void add(std::uint64_t, std::span<index_t> members)
+        {
+            if (seen.insert(members))
+                fresh.push_back(seen.size() - 1);
+        }
+        void fork(frame_stack& stack, frame&& f) { stack.push_back(std::move(f)); }
+    };
+
+    // state of the builds of partition_tree::insert and erase over the rows around the change:
+    // the parents of the rows are positions in roots, which holds the roots they were clipped from
+    struct local_build {
+        static constexpr bool partial = false;
+
+        std::span<const std::uint64_t> keys;
+        std::pmr::memory_resource*     resource;
+        pt::intersection_set&          intersections;
+        std::span<const index_t>       roots;
+        std::pmr::vector<index_t>&     members;
+
+        void add(std::uint64_t, std::span<index_t> rows)
+        {
+            members.clear();
+            for (auto r : rows)
+                members.push_back(roots[r]);
+            intersections.insert(members);
+        }
+        void fork(frame_stack& stack, frame&& f) { stack.push_back(std::move(f)); }
+    };
+
+}
+
+template <typename Build> void build_nodes(Build& ctx, frame&& root);
+
+void parallel_build::fork(frame_stack& stack, frame&& f)
 {
-    sorted_rectangles sorted_rects(ordering_t { ordering_of_t<vertical> {} });
-    rng::copy(m_rects | views::transform(address_of_f {}),
-        std::inserter(sorted_rects, sorted_rects.begin()));
+    if (size_of(f) < fork_cutoff) {
+        stack.push_back(std::move(f));
+        return;
+    }
+    auto task = std::make_shared<frame>(std::move(f));
+    pool.push([this, task] { build_nodes(*this, std::move(*task)); });
+}
 
-    return build_nodes_impl<vertical>(
-        m_start_time, m_timeout, m_rects, std::move(sorted_rects), m_intersections);
+void partition_tree::build()
+{
+    const auto start = std::chrono::steady_clock::now();
+    m_stats          = {};
+    const auto partial = m_mode == on_deadline::keep_partial;
+    m_unexplored.clear();
+    m_roots.clear();
+    m_roots.reserve(m_rects.size());
+    rng::copy(m_rects | views::transform(address_of_f {}), std::back_inserter(m_roots));
+    std::pmr::vector<std::uint64_t> keys(m_roots.size(), m_resource);
+    rng::transform(m_roots, keys.begin(), [](auto r) { return intersection_set::id_key(r->id()); });
+    m_intersections = intersection_set(m_roots, m_resource);
+    // what the pools of the build take from the resource is counted on the way
+    std::optional<stats_resource> counted;
+    const auto upstream = stats_enabled ? &counted.emplace(m_resource) : m_resource;
+    // the rows of every subtree come from a pool of the build, released in one go at its end
+    if (m_threads < 2) {
+        std::pmr::unsynchronized_pool_resource frames(upstream);
+        rectangle_store                        rows(&frames);
+        rows.append(m_store, 0, m_store.size());
+        serial_build ctx { m_deadline, partial, m_unexplored, m_roots, keys, m_intersections,
+            &frames, m_on_progress, m_stats };
+        build_nodes(ctx, pending<vertical> { { std::move(rows), {} } });
+    } else {
+        std::pmr::synchronized_pool_resource frames(upstream);
+        task_pool                            pool(m_threads);
+        rectangle_store                      rows(&frames);
+        rows.append(m_store, 0, m_store.size());
+        sorted_rectangles_of_t<vertical> sorted_rects(std::move(rows), {});
+        parallel_build                   ctx { m_deadline, partial, m_unexplored, m_roots, keys,
+            pool, &frames, m_on_progress, m_stats };
+        pool.run([&] { build_nodes(ctx, pending<vertical> { std::move(sorted_rects) }); });
+        ctx.merge_into(m_intersections);
+    }
+    m_intersections.sort();
+    if (counted) {
+        m_stats.bytes_allocated = counted->stats().bytes_allocated;
+        m_stats.peak_bytes      = counted->stats().peak_bytes;
+    }
+    m_stats.build_time = std::chrono::steady_clock::now() - start;
 }
 
-void add_leaf_node(sorted_rectangles&& rects, pt::intersection_set& intersections)
+template <typename Build, typename Ordering>
+void add_leaf_node(Build& ctx, sorted_rectangles<Ordering>&& rects)
 {
-    if (rects.size() > 1)
-        intersections.emplace(std::move(rects));
+    if (rects.size() < 2)
+        return;
+    // the roots of the rows, which are what the intersections are reported between
+    std::pmr::vector<index_t> members(ctx.resource);
+    members.reserve(rects.size());
+    std::uint64_t hash {};
+    for (auto p : rects.rows().parents()) {
+        members.push_back(p);
+        hash += ctx.keys[p];
+    }
+    ctx.add(hash, members);
 }
-template <typename Next_Orientation>
-void change_orientation(Next_Orientation, pt::tp start, std::optional<pt::secs> const& to,
-    rectangles_list& rects, sorted_rectangles&& above, pt::intersection_set& intersections)
+template <typename Next_Orientation, typename Build, typename Ordering>
+void change_orientation(
+    Next_Orientation, Build& ctx, frame_stack& stack, sorted_rectangles<Ordering>&& above)
 {
     if (pt::is_homogeneous(above)) {
-        add_leaf_node(std::move(above), intersections);
+        add_leaf_node(ctx, std::move(above));
         return;
     }
-    sorted_rectangles ro_sorted_rects = sorted<Next_Orientation>(above);
-    build_nodes_impl<Next_Orientation>(start, to, rects, std::move(ro_sorted_rects), intersections);
+    sorted_rectangles_of_t<Next_Orientation> ro_sorted_rects(std::move(above).release(), {});
+    stack.push_back(pending<Next_Orientation> { std::move(ro_sorted_rects) });
 }
 
-template <typename orientation_type>
-void build_nodes_impl(pt::tp start, std::optional<pt::secs> const& to, rectangles_list& rects,
-    sorted_rectangles&& sorted_rects, pt::intersection_set& intersections)
+// splits a single subtree, pushing its children on the stack
+template <typename orientation_type, typename Build>
+void build_nodes_impl(Build& ctx, frame_stack& stack, build_stats& counted,
+    sorted_rectangles_of_t<orientation_type>&& sorted_rects)
 {
-    if (to && pt::clock::now() > start + *to) {
-        throw timeout("Calculation timed out ...");
-    }
     if (sorted_rects.size() < 2) {
         return;
     }
 
-    // if intersection has already been discovered then don't continue
-    if (intersections.find(pt::intersection(std::as_const(sorted_rects))) != intersections.end()) {
+    // small and nested subtrees are read off directly instead of being split any further
+    if (read_off(ctx, sorted_rects.rows())) {
+        if constexpr (stats_enabled)
+            ++counted.read_off;
         return;
     }
 
     // find leftmost rectangle
     const auto split_pt = pt::split_point<orientation_type>(sorted_rects);
     // slice according to current orientation
-    auto [new_rects, below, above] = pt::slice(orientation_type { split_pt }, sorted_rects);
+    auto [below, above] = pt::slice(orientation_type { split_pt }, sorted_rects);
+    if constexpr (stats_enabled) {
+        ++counted.slices;
+        counted.rows_sliced += below.size() + above.size();
+    }
     // above can't be empty, as the split point is the lower bound of the mid point, which in
     //  case of a single element will be it's own origin, resulting in it being above the split line
     assert(!above.empty());
-    // obtain ownership of newly created rectangles
-    rects.splice(rects.begin(), std::move(new_rects));
     if (below.empty()) {
         // if there are no new splits we can continue with the next orientation
         assert(above.size() == sorted_rects.size());
-        change_orientation(next_orientation_t<orientation_type> {}, start, to, rects,
-            std::move(above), intersections);
+        if constexpr (stats_enabled)
+            ++counted.orientation_changes;
+        change_orientation(next_orientation_t<orientation_type> {}, ctx, stack, std::move(above));
 
         return;
     }
-    // else continue recursively on both children
-    build_nodes_impl<orientation_type>(start, to, rects, std::move(below), intersections);
-    build_nodes_impl<orientation_type>(start, to, rects, std::move(above), intersections);
+    // else continue on both children, below first as it ends up on top of the stack; a partial
+    // build takes the one with more rows first, which most likely holds more intersections. Only
+    // among the two: a larger subtree pending further down the stack waits, as a heap of all
+    // pending subtrees would no longer bound the stack by max_pending_subtrees.
+    if (ctx.partial && above.size() > below.size())
+        std::swap(above, below);
+    stack.push_back(pending<orientation_type> { std::move(above) });
+    ctx.fork(stack, pending<orientation_type> { std::move(below) });
 }
 
-template <typename HintF>
-void add_rect(std::optional<rectangle> const& r, rectangles_list& rect_list,
-    sorted_rectangles& rects, HintF hint)
+// builds the subtree of root and all of its descendants that aren't forked elsewhere
+template <typename Build> void build_nodes(Build& ctx, frame&& root)
 {
-    if (r) {
-        auto nr = rect_list.insert(rect_list.end(), *r);
-        rects.insert(hint(rects), std::addressof(*nr));
+    alignas(frame) std::array<std::byte, inline_frames * sizeof(frame)> buffer;
+    std::pmr::monotonic_buffer_resource stack_resource(buffer.data(), buffer.size(), ctx.resource);
+    frame_stack                         stack(&stack_resource);
+    stack.reserve(inline_frames);
+    stack.push_back(std::move(root));
+    // counted apart from the other threads, handed to ctx once done
+    build_stats     counted;
+    deadline_poller poller(ctx.until);
+    while (!stack.empty()) {
+        if (poller.expired()) {
+            if (!ctx.partial)
+                ctx.until.check();
+            // the frames left weren't built, forked tasks see the deadline on their first poll
+            for (const auto& f : stack) {
+                if (size_of(f) > 1)
+                    ctx.leave(f);
+            }
+            break;
+        }
+        if constexpr (stats_enabled) {
+            ++counted.subtrees;
+            counted.max_pending = std::max(counted.max_pending, stack.size());
+        }
+        auto top = std::move(stack.back());
+        stack.pop_back();
+        std::visit(
+            [&]<typename orientation_type>(pending<orientation_type>& p) {
+                build_nodes_impl<orientation_type>(ctx, stack, counted, std::move(p.rects));
+            },
+            top);
+        assert(stack.size() <= pt::max_pending_subtrees);
+        ctx.step(stack.size());
     }
+    if constexpr (stats_enabled)
+        ctx.count(counted);
 }
 
-template <typename orientation_type, typename ExpectedOrdering>
-auto slice_ordered_impl(orientation_type orientation, type_tag<ExpectedOrdering>,
-    sorted_rectangles const&             rects) -> slice_t
+// the rows in front of the slicing line are the ones crossing it or lying below it entirely:
+// all of them have a part below the line, which is the row clipped to it, and those crossing
+// it a part above as well. Both are computed column-wise over the contiguous coordinates.
+template <typename orientation_type>
+auto slice_ordered_impl(orientation_type orientation,
+    sorted_rectangles_of_t<orientation_type> const& rects) -> slice_t<orientation_type>
 {
-    if (!std::holds_alternative<ExpectedOrdering>(rects.key_comp()))
-        throw invalid_arg("invalid sorting of rectangles");
-    const auto        from = rects.lower_bound(orientation.val);
-    rectangles_list   rect_list;
-    sorted_rectangles below(rects.key_comp());
-    sorted_rectangles above(from, rects.end(), rects.key_comp());
-    for (auto it = rects.begin(); it != from; ++it) {
-        auto [r_below, r_above] = (*it)->slice(orientation);
-        add_rect(r_below, rect_list, below, [](auto& s) { return s.end(); });
-        add_rect(r_above, rect_list, above, [](auto& s) { return s.begin(); });
+    using sorted_t          = sorted_rectangles_of_t<orientation_type>;
+    using slicing           = slicing_of<orientation_type>;
+    constexpr auto a        = slicing::sliced_axis;
+    const auto     val      = orientation.val;
+    const auto     from     = rects.lower_bound(val);
+    const auto&    src      = rects.rows();
+    const auto     src_orig = src.origins(a);
+    const auto     src_ext  = src.extents(a);
+
+    rectangle_store above_rows(rects.get_allocator());
+    for (std::size_t i = 0; i < from; ++i) {
+        const auto far = src_orig[i] + src_ext[i];
+        if (slicing::reversed ? src_orig[i] < val : far > val)
+            above_rows.append(src, i);
+    }
+    auto above_orig = above_rows.origins(a);
+    auto above_ext  = above_rows.extents(a);
+    for (std::size_t i = 0; i < above_rows.size(); ++i) {
+        if constexpr (slicing::reversed) {
+            above_ext[i] = val - above_orig[i];
+        } else {
+            above_ext[i]  = above_orig[i] + above_ext[i] - val;
+            above_orig[i] = val;
+        }
+    }
+
+    rectangle_store below_rows(rects.get_allocator());
+    below_rows.append(src, 0, from);
+    auto below_orig = below_rows.origins(a);
+    auto below_ext  = below_rows.extents(a);
+    for (std::size_t i = 0; i < from; ++i) {
+        if constexpr (slicing::reversed) {
+            const auto far = below_orig[i] + below_ext[i];
+            below_orig[i]  = std::max(below_orig[i], val);
+            below_ext[i]   = far - below_orig[i];
+        } else {
+            below_ext[i] = std::min(below_ext[i], val - below_orig[i]);
+        }
     }
-    return { std::move(rect_list), std::move(below), std::move(above) };
+
+    sorted_t below(std::move(below_rows), rects.key_comp());
+    sorted_t above = rects.tail(from);
+    above.merge(std::move(above_rows));
+    return { std::move(below), std::move(above) };
 }
 
-auto partition_tree::slice(horizontal h, sorted_rectangles const& rects) -> slice_t
+auto partition_tree::slice(horizontal h, sorted_rectangles_of_t<horizontal> const& rects)
+    -> slice_t<horizontal>
 {
-    return slice_ordered_impl(h, type_tag<vertical_sort> {}, rects);
+    return slice_ordered_impl(h, rects);
 }
 
-auto partition_tree::slice(vertical v, sorted_rectangles const& rects) -> slice_t
+auto partition_tree::slice(vertical v, sorted_rectangles_of_t<vertical> const& rects)
+    -> slice_t<vertical>
 {
-    return slice_ordered_impl(v, type_tag<horizontal_sort> {}, rects);
+    return slice_ordered_impl(v, rects);
 }
-auto partition_tree::slice(rev_vertical v, sorted_rectangles const& rects) -> slice_t
+auto partition_tree::slice(rev_vertical v, sorted_rectangles_of_t<rev_vertical> const& rects)
+    -> slice_t<rev_vertical>
 {
-    return slice_ordered_impl(v, type_tag<rev_horizontal_sort> {}, rects);
+    return slice_ordered_impl(v, rects);
 }
-auto partition_tree::slice(rev_horizontal v, sorted_rectangles const& rects) -> slice_t
+auto partition_tree::slice(rev_horizontal v, sorted_rectangles_of_t<rev_horizontal> const& rects)
+    -> slice_t<rev_horizontal>
 {
-    return slice_ordered_impl(v, type_tag<rev_vertical_sort> {}, rects);
+    return slice_ordered_impl(v, rects);
 }
 
-bool partition_tree::is_homogeneous(sorted_rectangles const& rects)
+partition_tree::partition_tree(rectangles_list lst, std::optional<secs> timeout,
+    std::size_t threads, progress_callback on_progress, std::pmr::memory_resource* resource,
+    std::stop_token stop, on_deadline mode)
+    : m_resource(resource)
+    , m_intersections({}, resource)
+    , m_rects(std::move(lst))
+    , m_store(m_rects, resource)
+    , m_roots(resource)
+    , m_deadline(timeout, std::move(stop))
+    , m_mode(mode)
+    , m_unexplored(resource)
+    , m_threads(threads)
+    , m_on_progress(std::move(on_progress))
 {
+    build();
+}
 
-    if (rects.empty())
-        return true;
-    const auto& ref = **rects.begin();
-    return rng::all_of(rects, [&](const auto& pr) { return ref.extent() == pr->extent(); });
+partition_tree::partition_tree(rectangle_store store, std::optional<secs> timeout,
+    std::size_t threads, progress_callback on_progress, std::pmr::memory_resource* resource,
+    std::stop_token stop, on_deadline mode)
+    : m_resource(resource)
+    , m_intersections({}, resource)
+    , m_rects(resource)
+    , m_store(std::move(store))
+    , m_roots(resource)
+    , m_deadline(timeout, std::move(stop))
+    , m_mode(mode)
+    , m_unexplored(resource)
+    , m_threads(threads)
+    , m_on_progress(std::move(on_progress))
+{
+    m_rects.reserve(m_store.size());
+    for (std::size_t i = 0; i < m_store.size(); ++i)
+        m_rects.push_back(m_store.rect(i));
+    build();
 }
 
-bool partition_tree::intersection::operator<(const intersection& other) const noexcept
+auto partition_tree::intersections() const -> intersection_set const&
 {
-    if (m_rects.size() < other.m_rects.size())
-        return true;
-    if (m_rects.size() > other.m_rects.size())
-        return false;
-    return rng::lexicographical_compare(m_rects, other.m_rects, std::less<>(), to_id(), to_id());
+    return m_intersections;
 }
 
-bool partition_tree::intersection::operator==(const intersection& other) const noexcept
+void partition_tree::insert(rectangle const& r)
 {
-    return m_rects.size() == other.m_rects.size() && m_rects == other.m_rects;
+    const auto ids = m_store.ids();
+    if (rng::find(ids, r.id()) != ids.end())
+        throw invalid_arg("a rectangle with the id is in the tree already");
+    const auto area = neighborhood(r);
+    m_store.push_back(r);
+    m_rects.push_back(m_store.rect(m_store.size() - 1));
+    m_roots.push_back(&m_rects.back());
+    m_intersections.rebind(m_roots);
+
+    std::pmr::unsynchronized_pool_resource frames(m_resource);
+    const auto inserted = static_cast<index_t>(m_roots.size() - 1);
+    update(area, intersections_within(area, inserted, &frames),
+        intersections_within(area, std::nullopt, &frames));
 }
 
-partition_tree::partition_tree(rectangles_list lst, std::optional<secs> timeout)
-    : m_rects(std::move(lst))
-    , m_start_time(std::chrono::system_clock::now())
-    , m_timeout(timeout)
+bool partition_tree::erase(std::size_t id)
 {
-    build();
+    const auto ids = m_store.ids();
+    const auto it  = rng::find(ids, id);
+    if (it == ids.end())
+        return false;
+    const auto                             erased = static_cast<index_t>(it - ids.begin());
+    const auto                             area   = neighborhood(m_store.rect(erased));
+    std::pmr::unsynchronized_pool_resource frames(m_resource);
+    update(area, intersections_within(area, std::nullopt, &frames),
+        intersections_within(area, erased, &frames));
+
+    // the last root moves into the place of the erased one, in the rectangles, the rows and
+    // the intersections; the root pointers stay the same, as m_roots[i] is &m_rects[i]
+    const auto last = static_cast<index_t>(m_roots.size() - 1);
+    m_rects[erased] = m_rects.back();
+    m_intersections.replace_root(last, erased);
+    m_store.erase_unordered(erased);
+    m_rects.pop_back();
+    m_roots.pop_back();
+    m_intersections.rebind(m_roots);
+    return true;
 }
 
-auto partition_tree::intersections() const -> intersection_set const&
+// Every intersection with a cell inside a changed rectangle is one of rectangles overlapping
+// it, and so lies within their bounding box, the neighborhood. Outside of the changed rectangle
+// nothing changes, so the set changes by what the intersections within the neighborhood do.
+rectangle partition_tree::neighborhood(rectangle const& r) const
 {
-    return m_intersections;
+    const auto  xs = m_store.xs(), ys = m_store.ys(), ws = m_store.widths(), hs = m_store.heights();
+    const point from = r.origin(), to { from.x + r.width(), from.y + r.height() };
+    point       low = from, high = to;
+    for (std::size_t i = 0; i < m_store.size(); ++i) {
+        if (xs[i] >= to.x || xs[i] + ws[i] <= from.x || ys[i] >= to.y || ys[i] + hs[i] <= from.y)
+            continue;
+        low  = { std::min(low.x, xs[i]), std::min(low.y, ys[i]) };
+        high = { std::max(high.x, xs[i] + ws[i]), std::max(high.y, ys[i] + hs[i]) };
+    }
+    return rectangle(low, { high.x - low.x, high.y - low.y });
 }
 
-rectangle partition_tree::intersection::calculate() const
+auto partition_tree::intersections_within(rectangle const& area, std::optional<index_t> skip,
+    std::pmr::memory_resource* resource) const -> intersection_set
 {
-    auto first_elem = *m_rects.begin();
+    // the rows overlapping the area clipped to it, along with the roots they were clipped from
+    rectangle_store                 rows(resource);
+    std::pmr::vector<index_t>       roots(resource);
+    std::pmr::vector<std::uint64_t> keys(resource);
+    const auto  xs = m_store.xs(), ys = m_store.ys(), ws = m_store.widths(), hs = m_store.heights();
+    const auto  low = area.origin();
+    const point high { low.x + area.width(), low.y + area.height() };
+    for (std::size_t i = 0; i < m_store.size(); ++i) {
+        const point from { std::max(low.x, xs[i]), std::max(low.y, ys[i]) };
+        const point to { std::min(high.x, xs[i] + ws[i]), std::min(high.y, ys[i] + hs[i]) };
+        if (from.x >= to.x || from.y >= to.y || i == skip)
+            continue;
+        rows.push_back(from, { to.x - from.x, to.y - from.y }, m_store.id(i),
+            static_cast<index_t>(roots.size()));
+        roots.push_back(static_cast<index_t>(i));
+        keys.push_back(intersection_set::id_key(m_store.id(i)));
+    }
 
-    auto result = std::accumulate(std::next(m_rects.begin()), m_rects.end(),
-        std::make_optional(*first_elem->root()),
-        [](std::optional<rectangle> rect, rect_ptr p) -> std::optional<rectangle> {
-            return rectangle::intersect(*p->root(), rect);
+    intersection_set result(m_roots, resource);
+    if (rows.size() < 2)
+        return result;
+    std::pmr::vector<index_t> members(resource);
+    local_build               ctx { keys, resource, result, roots, members };
+    frame_stack               stack(resource);
+    build_stats               counted;
+    stack.push_back(pending<vertical> { { std::move(rows), {} } });
+    while (!stack.empty()) {
+        auto top = std::move(stack.back());
+        stack.pop_back();
+        std::visit(
+            [&]<typename orientation_type>(pending<orientation_type>& p) {
+                build_nodes_impl<orientation_type>(ctx, stack, counted, std::move(p.rects));
+            },
+            top);
+    }
+    return result;
+}
+
+void partition_tree::update(
+    rectangle const& area, intersection_set const& before, intersection_set const& after)
+{
+    const auto has = [](intersection_set const& set, intersection const& i) {
+        std::uint64_t hash {};
+        for (auto r : i.constituents())
+            hash += intersection_set::id_key(r->id());
+        return set.contains(hash, [&](intersection const& other) { return other == i; });
+    };
+    const auto gone = rng::count_if(before, [&](auto const& i) { return !has(after, i); });
+    if (gone > 0) {
+        // only intersections within the area can be gone, the others are told by a corner
+        const auto within = [&](rect_ptr r) {
+            return area.origin().x <= r->origin().x && area.origin().y <= r->origin().y
+                && r->origin().x + r->width() <= area.origin().x + area.width()
+                && r->origin().y + r->height() <= area.origin().y + area.height();
+        };
+        m_intersections.erase_if([&](intersection const& i) {
+            return rng::all_of(i.constituents(), within) && has(before, i) && !has(after, i);
         });
-    if (!result)
-        throw std::logic_error("must have intersections...");
-    return *result;
+    }
+    const auto                sorted = m_intersections.size();
+    std::pmr::vector<index_t> members(m_resource);
+    for (const auto& i : after) {
+        members.assign(i.members().begin(), i.members().end());
+        m_intersections.insert(members);
+    }
+    m_intersections.sort(sorted);
+}
+
+build_stats const& partition_tree::stats() const noexcept
+{
+    return m_stats;
+}
+
+rectangle_store partition_tree::calculate_all(
+    intersection_set const& intersections, rectangle_store::allocator_type alloc)
+{
+    rectangle_store result(alloc);
+    result.reserve(intersections.size());
+    std::pmr::vector<coordinate_t> columns(alloc);
+    for (const auto& i : intersections)
+        result.push_back(i.calculate(columns));
+    return result;
+}
+
+struct intersection_stream::state {
+    state(rectangles_list lst, rectangle_store st, std::pmr::memory_resource* resource)
+        : rects(std::move(lst))
+        , store(std::move(st))
+        , roots(resource)
+        , keys(resource)
+        , frames(resource)
+        , stack(&frames)
+        , seen({}, resource)
+        , fresh(resource)
+        , current(resource)
+        , buffer(resource)
+    {
+        roots.reserve(rects.size());
+        rng::copy(rects | views::transform(address_of_f {}), std::back_inserter(roots));
+        keys.resize(roots.size());
+        rng::transform(
+            roots, keys.begin(), [](auto r) { return intersection_set::id_key(r->id()); });
+        seen = intersection_set(roots, resource);
+        rectangle_store rows(&frames);
+        rows.append(store, 0, store.size());
+        stack.push_back(pending<vertical> { { std::move(rows), {} } });
+    }
+
+    rectangles_list                 rects;
+    rectangle_store                 store;
+    std::pmr::vector<rect_ptr>      roots;
+    std::pmr::vector<std::uint64_t> keys;
+    // the rows of the subtrees, released with the stream
+    std::pmr::unsynchronized_pool_resource frames;
+    frame_stack                            stack;
+    // every intersection found, which is what bounds the memory of the stream, and the ones
+    // of them not pulled yet from taken on
+    intersection_set              seen;
+    std::pmr::vector<std::size_t> fresh;
+    std::size_t                   taken {};
+    // the constituents of the current intersection, copied out of seen, which moves them as it
+    // grows, and the gather buffer of its area
+    std::pmr::vector<index_t>      current;
+    std::pmr::vector<coordinate_t> buffer;
+};
+
+intersection_stream::intersection_stream(
+    rectangles_list lst, std::pmr::memory_resource* resource)
+{
+    rectangle_store store(lst, resource);
+    m_state = std::make_unique<state>(std::move(lst), std::move(store), resource);
+}
+
+intersection_stream::intersection_stream(
+    rectangle_store store, std::pmr::memory_resource* resource)
+{
+    rectangles_list rects(resource);
+    rects.reserve(store.size());
+    for (std::size_t i = 0; i < store.size(); ++i)
+        rects.push_back(store.rect(i));
+    m_state = std::make_unique<state>(std::move(rects), std::move(store), resource);
+}
+
+intersection_stream::~intersection_stream() = default;
+
+auto intersection_stream::begin() -> iterator
+{
+    if (!m_started) {
+        m_started = true;
+        next();
+    }
+    return { this };
+}
+
+void intersection_stream::next()
+{
+    auto&        s = *m_state;
+    stream_build ctx { s.keys, &s.frames, s.seen, s.fresh };
+    build_stats  counted;
+    while (s.taken == s.fresh.size() && !s.stack.empty()) {
+        auto top = std::move(s.stack.back());
+        s.stack.pop_back();
+        std::visit(
+            [&]<typename orientation_type>(pending<orientation_type>& p) {
+                build_nodes_impl<orientation_type>(ctx, s.stack, counted, std::move(p.rects));
+            },
+            top);
+    }
+    if (s.taken == s.fresh.size()) {
+        m_current.reset();
+        return;
+    }
+    const auto members = s.seen.at(s.fresh[s.taken++]).members();
+    s.current.assign(members.begin(), members.end());
+    if (s.taken == s.fresh.size()) {
+        s.fresh.clear();
+        s.taken = 0;
+    }
+    const intersection isec(s.current, s.roots);
+    m_current.emplace(value_type { isec, isec.calculate(s.buffer) });
 }
 
 }
@@ -0,0 +1,178 @@
+#include "nitro/exceptions.hpp"
+#include "nitro/fwd.hpp"
+#include <algorithm>
+#include <cassert>
+#include <iterator>
+#include <numeric>
+#include <nitro/rectangle_store.hpp>
+
+namespace nitro {
+
+namespace {
+    template <typename T>
+    void permute_column(
+        std::pmr::vector<T>& column, std::span<const rectangle_store::index_t> order)
+    {
+        std::pmr::vector<T> result(column.get_allocator());
+        result.reserve(column.size());
+        for (auto i : order)
+            result.push_back(column[i]);
+        column.swap(result);
+    }
+
+    template <typename T>
+    void append_column(std::pmr::vector<T>& column, std::pmr::vector<T> const& other,
+        std::size_t first, std::size_t last)
+    {
+        column.insert(column.end(), std::next(other.begin(), static_cast<std::ptrdiff_t>(first)),
+            std::next(other.begin(), static_cast<std::ptrdiff_t>(last)));
+    }
+}
+
+rectangle_store::rectangle_store(allocator_type alloc)
+    : m_x(alloc)
+    , m_y(alloc)
+    , m_w(alloc)
+    , m_h(alloc)
+    , m_id(alloc)
+    , m_parent(alloc)
+{
+}
+
+rectangle_store::rectangle_store(rectangles_list const& rects, allocator_type alloc)
+    : rectangle_store(alloc)
+{
+    reserve(rects.size());
+    for (const auto& r : rects)
+        push_back(r);
+}
+
+void rectangle_store::reserve(std::size_t n)
+{
+    m_x.reserve(n);
+    m_y.reserve(n);
+    m_w.reserve(n);
+    m_h.reserve(n);
+    m_id.reserve(n);
+    m_parent.reserve(n);
+}
+
+void rectangle_store::clear() noexcept
+{
+    m_x.clear();
+    m_y.clear();
+    m_w.clear();
+    m_h.clear();
+    m_id.clear();
+    m_parent.clear();
+}
+
+auto rectangle_store::push_back(point origin, point extent, std::size_t id, index_t parent)
+    -> index_t
+{
+    if (extent.x < 1 || extent.y < 1) {
+        throw invalid_arg("invalid height or width");
+    }
+    if (size() >= no_parent) {
+        throw invalid_arg("too many rectangles");
+    }
+    m_x.push_back(origin.x);
+    m_y.push_back(origin.y);
+    m_w.push_back(extent.x);
+    m_h.push_back(extent.y);
+    m_id.push_back(id);
+    m_parent.push_back(parent);
+    return static_cast<index_t>(size() - 1);
+}
+
+auto rectangle_store::push_back(rectangle const& r) -> index_t
+{
+    return push_back(r.origin(), r.extent(), r.id());
+}
+
+auto rectangle_store::append(rectangle_store const& other, std::size_t i) -> index_t
+{
+    m_x.push_back(other.m_x[i]);
+    m_y.push_back(other.m_y[i]);
+    m_w.push_back(other.m_w[i]);
+    m_h.push_back(other.m_h[i]);
+    m_id.push_back(other.m_id[i]);
+    m_parent.push_back(other.m_parent[i]);
+    return static_cast<index_t>(size() - 1);
+}
+
+void rectangle_store::append(rectangle_store const& other, std::size_t first, std::size_t last)
+{
+    assert(first <= last && last <= other.size());
+    append_column(m_x, other.m_x, first, last);
+    append_column(m_y, other.m_y, first, last);
+    append_column(m_w, other.m_w, first, last);
+    append_column(m_h, other.m_h, first, last);
+    append_column(m_id, other.m_id, first, last);
+    append_column(m_parent, other.m_parent, first, last);
+}
+
+void rectangle_store::append(std::span<const coordinate_t> xs, std::span<const coordinate_t> ys,
+    std::span<const coordinate_t> widths, std::span<const coordinate_t> heights,
+    std::span<const std::size_t> ids)
+{
+    const auto n = xs.size();
+    assert(ys.size() == n && widths.size() == n && heights.size() == n);
+    assert(ids.empty() || ids.size() == n);
+    if (rng::any_of(widths, [](auto w) { return w < 1; })
+        || rng::any_of(heights, [](auto h) { return h < 1; })) {
+        throw invalid_arg("invalid height or width");
+    }
+    if (n > no_parent - size()) {
+        throw invalid_arg("too many rectangles");
+    }
+    const auto first = size();
+    m_x.insert(m_x.end(), xs.begin(), xs.end());
+    m_y.insert(m_y.end(), ys.begin(), ys.end());
+    m_w.insert(m_w.end(), widths.begin(), widths.end());
+    m_h.insert(m_h.end(), heights.begin(), heights.end());
+    if (ids.empty()) {
+        m_id.resize(first + n);
+        std::iota(std::next(m_id.begin(), static_cast<std::ptrdiff_t>(first)), m_id.end(),
+            first + 1);
+    } else {
+        m_id.insert(m_id.end(), ids.begin(), ids.end());
+    }
+    m_parent.resize(first + n, no_parent);
+}
+
+void rectangle_store::permute(std::span<const index_t> order)
+{
+    assert(order.size() == size());
+    permute_column(m_x, order);
+    permute_column(m_y, order);
+    permute_column(m_w, order);
+    permute_column(m_h, order);
+    permute_column(m_id, order);
+    permute_column(m_parent, order);
+}
+
+void rectangle_store::erase_unordered(std::size_t i) noexcept
+{
+    assert(i < size());
+    const auto last = size() - 1;
+    m_x[i]          = m_x[last];
+    m_y[i]          = m_y[last];
+    m_w[i]          = m_w[last];
+    m_h[i]          = m_h[last];
+    m_id[i]         = m_id[last];
+    m_parent[i]     = m_parent[last];
+    m_x.pop_back();
+    m_y.pop_back();
+    m_w.pop_back();
+    m_h.pop_back();
+    m_id.pop_back();
+    m_parent.pop_back();
+}
+
+rectangle rectangle_store::rect(std::size_t i) const
+{
+    return rectangle { { m_x[i], m_y[i] }, { m_w[i], m_h[i] }, m_id[i] };
+}
+
+}
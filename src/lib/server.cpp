@@ -0,0 +1,454 @@
+#include "nitro/exceptions.hpp"
+#include <nitro/binary_io.hpp>
+#include <nitro/io.hpp>
+#include <nitro/server.hpp>
+#include <nitro/text_writer.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <ostream>
+#include <streambuf>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifndef _WIN32
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace nitro {
+
+#ifndef _WIN32
+namespace {
+    // how long blocking calls wait before looking at the stop token again
+    constexpr int poll_ms = 100;
+    // the most input read at once, the buffer growing by what arrived rather than by what the
+    // header of a request claims
+    constexpr std::size_t read_chunk = std::size_t { 64 } << 10;
+
+    // the peer went away or the server stops; ends the connection rather than the request, so
+    // it isn't derived from std::exception
+    struct connection_closed { };
+
+    [[noreturn]] void throw_errno(char const* what)
+    {
+        throw std::system_error(errno, std::generic_category(), what);
+    }
+
+    sockaddr_un address_of(std::filesystem::path const& path)
+    {
+        sockaddr_un addr {};
+        addr.sun_family    = AF_UNIX;
+        const auto& native = path.native();
+        if (native.size() >= sizeof(addr.sun_path))
+            throw invalid_arg("socket path too long: " + path.string());
+        native.copy(addr.sun_path, native.size());
+        return addr;
+    }
+
+    int connect_to(std::filesystem::path const& path)
+    {
+        const auto addr = address_of(path);
+        const int  fd   = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0)
+            throw_errno("socket");
+        if (::connect(fd, reinterpret_cast<sockaddr const*>(&addr), sizeof(addr)) != 0) {
+            const auto error = errno;
+            ::close(fd);
+            errno = error;
+            throw_errno(("connect to " + path.string()).c_str());
+        }
+        return fd;
+    }
+
+    // reads until data is full or the peer closes the connection, returns how much was read;
+    // throws connection_closed once stop is requested
+    std::size_t read_exact(int fd, std::span<std::byte> data, std::stop_token const& stop)
+    {
+        std::size_t done = 0;
+        while (done < data.size()) {
+            pollfd p { fd, POLLIN, 0 };
+            const auto ready = ::poll(&p, 1, poll_ms);
+            if (stop.stop_requested())
+                throw connection_closed {};
+            if (ready < 0 && errno != EINTR)
+                throw_errno("poll");
+            if (ready <= 0)
+                continue;
+            const auto n = ::read(fd, data.data() + done, data.size() - done);
+            if (n == 0)
+                break;
+            if (n < 0 && errno != EINTR)
+                throw_errno("read");
+            done += static_cast<std::size_t>(std::max<ssize_t>(n, 0));
+        }
+        return done;
+    }
+
+    // drops the first n bytes of iov
+    void advance(std::span<iovec>& iov, std::size_t n)
+    {
+        for (; !iov.empty() && n >= iov.front().iov_len; iov = iov.subspan(1))
+            n -= iov.front().iov_len;
+        if (!iov.empty()) {
+            iov.front().iov_base = static_cast<char*>(iov.front().iov_base) + n;
+            iov.front().iov_len -= n;
+        }
+    }
+
+    // false if the peer is gone; MSG_NOSIGNAL keeps that from raising SIGPIPE. Throws
+    // connection_closed if stop is requested while the socket is full, a client that stops
+    // reading can't hold the server up, but what still fits, the status of a cancelled
+    // request, is written.
+    bool write_all(int fd, std::span<iovec> iov, std::stop_token const& stop)
+    {
+        while (!iov.empty()) {
+            msghdr msg {};
+            msg.msg_iov    = iov.data();
+            msg.msg_iovlen = iov.size();
+            const auto n   = ::sendmsg(fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+            if (n >= 0) {
+                advance(iov, static_cast<std::size_t>(n));
+                continue;
+            }
+            if (errno != EINTR && errno != EAGAIN && errno != EWOULDBLOCK)
+                return false;
+            for (;;) {
+                if (stop.stop_requested())
+                    throw connection_closed {};
+                pollfd p { fd, POLLOUT, 0 };
+                const auto ready = ::poll(&p, 1, poll_ms);
+                if (ready < 0 && errno != EINTR)
+                    throw_errno("poll");
+                if (ready > 0)
+                    break;
+            }
+        }
+        return true;
+    }
+
+    void write_frame(
+        int fd, response_status status, std::string_view payload, std::stop_token const& stop)
+    {
+        response_header header { status, 0, payload.size() };
+        iovec           iov[] { { &header, sizeof(header) },
+            { const_cast<char*>(payload.data()), payload.size() } };
+        if (!write_all(fd, iov, stop))
+            throw connection_closed {};
+    }
+
+    // hands whatever is written to it to the client as data frames; a text_writer on top of it
+    // makes them as long as its buffer
+    struct frame_buf : std::streambuf {
+        frame_buf(int fd, std::stop_token const& stop)
+            : m_fd(fd)
+            , m_stop(stop)
+        {
+        }
+
+    protected:
+        std::streamsize xsputn(char const* s, std::streamsize n) override
+        {
+            write_frame(m_fd, response_status::data, { s, static_cast<std::size_t>(n) }, m_stop);
+            return n;
+        }
+        int_type overflow(int_type c) override
+        {
+            if (!traits_type::eq_int_type(c, traits_type::eof())) {
+                const auto ch = traits_type::to_char_type(c);
+                write_frame(m_fd, response_status::data, { &ch, 1 }, m_stop);
+            }
+            return traits_type::not_eof(c);
+        }
+
+    private:
+        int                    m_fd;
+        std::stop_token const& m_stop;
+    };
+
+    void answer(int fd, request_header const& header, std::span<const std::byte> input,
+        server_options const& opts, std::pmr::memory_resource* resource,
+        std::stop_token const& stop)
+    {
+        auto        status = response_status::ok;
+        std::string message;
+        try {
+            auto store = [&] {
+                switch (header.format) {
+                case input_format::json:
+                    return read_rectangle_store(
+                        { reinterpret_cast<char const*>(input.data()), input.size() },
+                        opts.max_rects, resource);
+                case input_format::binary:
+                    return to_rectangle_store(input, opts.max_rects, resource);
+                }
+                throw invalid_arg("unknown input format");
+            }();
+            const auto timeout = header.timeout_secs == 0
+                ? opts.timeout
+                : partition_tree::secs { header.timeout_secs };
+            const partition_tree tree(std::move(store), timeout, opts.threads, {}, resource, stop);
+            const auto areas = partition_tree::calculate_all(tree.intersections(), resource);
+
+            // failing writes throw connection_closed through the stream
+            frame_buf    buf(fd, stop);
+            std::ostream os(&buf);
+            os.exceptions(std::ostream::badbit);
+            text_writer w(os);
+            write_intersections(w, tree.intersections(), areas);
+            w.flush();
+        } catch (const nitro::timeout& ex) {
+            status  = response_status::timeout;
+            message = ex.what();
+        } catch (const nitro::cancelled& ex) {
+            status  = response_status::cancelled;
+            message = ex.what();
+        } catch (const invalid_arg& ex) {
+            status  = response_status::invalid;
+            message = ex.what();
+        } catch (const std::exception& ex) {
+            status  = response_status::error;
+            message = ex.what();
+        }
+        write_frame(fd, status, message, stop);
+    }
+}
+
+server::server(std::filesystem::path socket_path, server_options opts)
+    : m_path(std::move(socket_path))
+    , m_opts(opts)
+{
+    const auto addr = address_of(m_path);
+    if (std::filesystem::is_socket(m_path)) {
+        try {
+            ::close(connect_to(m_path));
+        } catch (const std::system_error&) {
+            // nobody listens there any more
+            std::filesystem::remove(m_path);
+        }
+        if (std::filesystem::exists(m_path))
+            throw invalid_arg("a server is running at " + m_path.string());
+    }
+    m_fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (m_fd < 0)
+        throw_errno("socket");
+    if (::bind(m_fd, reinterpret_cast<sockaddr const*>(&addr), sizeof(addr)) != 0
+        || ::listen(m_fd, SOMAXCONN) != 0) {
+        const auto error = errno;
+        ::close(m_fd);
+        errno = error;
+        throw_errno(("listen at " + m_path.string()).c_str());
+    }
+}
+
+server::~server()
+{
+    ::close(m_fd);
+    std::error_code ec;
+    std::filesystem::remove(m_path, ec);
+}
+
+void server::run(std::stop_token stop)
+{
+    std::mutex                  mx;
+    std::condition_variable_any cv;
+    std::deque<int>             accepted;
+    {
+        // the workers are stopped and joined however the accept loop ends
+        std::vector<std::jthread> workers;
+        for (std::size_t i = 0; i < std::max<std::size_t>(m_opts.workers, 1); ++i) {
+            workers.emplace_back([&](std::stop_token own) {
+                for (;;) {
+                    int fd {};
+                    {
+                        std::unique_lock l(mx);
+                        if (!cv.wait(l, own, [&] { return !accepted.empty(); }))
+                            return;
+                        fd = accepted.front();
+                        accepted.pop_front();
+                    }
+                    serve_connection(fd, own);
+                    ::close(fd);
+                }
+            });
+        }
+        std::stop_callback forward(stop, [&] {
+            for (auto& w : workers)
+                w.request_stop();
+        });
+
+        while (!stop.stop_requested()) {
+            pollfd p { m_fd, POLLIN, 0 };
+            const auto ready = ::poll(&p, 1, poll_ms);
+            if (ready < 0 && errno != EINTR)
+                throw_errno("poll");
+            if (ready <= 0)
+                continue;
+            const int fd = ::accept4(m_fd, nullptr, nullptr, SOCK_CLOEXEC);
+            if (fd < 0) {
+                // out of descriptors or memory the connection stays pending and poll returns
+                // at once, so wait for a worker to close one instead of spinning
+                if (errno != EINTR && errno != EAGAIN && errno != ECONNABORTED)
+                    std::this_thread::sleep_for(std::chrono::milliseconds(poll_ms));
+                continue;
+            }
+            {
+                std::lock_guard l(mx);
+                accepted.push_back(fd);
+            }
+            cv.notify_one();
+        }
+    }
+    for (const auto fd : accepted)
+        ::close(fd);
+}
+
+void server::serve_connection(int fd, std::stop_token const& stop)
+{
+    // the input of one request after the other, 8 byte aligned for binary input
+    std::vector<std::uint64_t> buffer;
+    const auto                 resource = m_pools.for_threads(m_opts.threads);
+    try {
+        for (;;) {
+            request_header header {};
+            if (read_exact(fd, std::as_writable_bytes(std::span(&header, 1)), stop)
+                < sizeof(header)) {
+                return;
+            }
+            if (header.length > m_opts.max_request_bytes) {
+                write_frame(fd, response_status::invalid, "request too long", stop);
+                return;
+            }
+            for (std::size_t done = 0; done < header.length;) {
+                const auto chunk = std::min<std::uint64_t>(header.length - done, read_chunk);
+                buffer.resize((done + chunk + sizeof(std::uint64_t) - 1) / sizeof(std::uint64_t));
+                const auto part = std::as_writable_bytes(std::span(buffer)).subspan(done, chunk);
+                if (read_exact(fd, part, stop) < part.size())
+                    return;
+                done += chunk;
+            }
+            const auto input = std::as_writable_bytes(std::span(buffer)).first(header.length);
+            answer(fd, header, input, m_opts, resource, stop);
+        }
+    } catch (const connection_closed&) {
+    } catch (const std::exception&) {
+        // the connection broke, the others go on
+    }
+}
+
+client::client(std::filesystem::path const& socket_path)
+    : m_fd(connect_to(socket_path))
+{
+}
+
+client::~client() { ::close(m_fd); }
+
+void client::send(std::span<const std::byte> input, input_format format, std::uint32_t timeout_secs)
+{
+    request_header   header { format, timeout_secs, input.size() };
+    iovec            parts[] { { &header, sizeof(header) },
+        { const_cast<std::byte*>(input.data()), input.size() } };
+    std::span<iovec> iov(parts);
+    // the server doesn't read the next request while it writes an answer, so the answers coming
+    // in are read as the request goes out, or both would wait on a full socket
+    while (!iov.empty()) {
+        pollfd p { m_fd, POLLIN | POLLOUT, 0 };
+        if (::poll(&p, 1, -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            throw_errno("poll");
+        }
+        if (p.revents & POLLIN) {
+            const auto start = m_received.size();
+            m_received.resize(start + read_chunk);
+            const auto n = ::read(m_fd, m_received.data() + start, read_chunk);
+            m_received.resize(start + static_cast<std::size_t>(std::max<ssize_t>(n, 0)));
+            if (n < 0 && errno != EINTR)
+                throw_errno("read");
+        }
+        // a closed connection fails the send
+        if (p.revents & (POLLOUT | POLLHUP | POLLERR)) {
+            msghdr msg {};
+            msg.msg_iov    = iov.data();
+            msg.msg_iovlen = iov.size();
+            const auto n   = ::sendmsg(m_fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+            if (n < 0 && errno != EINTR && errno != EAGAIN && errno != EWOULDBLOCK)
+                throw_errno("send");
+            advance(iov, static_cast<std::size_t>(std::max<ssize_t>(n, 0)));
+        }
+    }
+}
+
+response client::receive()
+{
+    response result { response_status::data, {} };
+    while (result.status == response_status::data) {
+        response_header header {};
+        if (take(std::as_writable_bytes(std::span(&header, 1))) < sizeof(header))
+            throw std::runtime_error("connection closed by the server");
+        // the final frame of a failed request holds nothing but the message
+        if (header.status != response_status::data && header.status != response_status::ok)
+            result.text.clear();
+        const auto start = result.text.size();
+        result.text.resize(start + header.length);
+        if (take(std::as_writable_bytes(std::span(result.text)).subspan(start)) < header.length)
+            throw std::runtime_error("connection closed by the server");
+        result.status = header.status;
+    }
+    return result;
+}
+
+std::size_t client::take(std::span<std::byte> data)
+{
+    const auto held = std::min(data.size(), m_received.size() - m_taken);
+    std::copy_n(m_received.begin() + static_cast<std::ptrdiff_t>(m_taken), held, data.begin());
+    m_taken += held;
+    if (m_taken == m_received.size()) {
+        m_received.clear();
+        m_taken = 0;
+    }
+    return held + read_exact(m_fd, data.subspan(held), {});
+}
+
+#else
+
+server::server(std::filesystem::path socket_path, server_options opts)
+    : m_path(std::move(socket_path))
+    , m_opts(opts)
+{
+    throw invalid_arg("serving needs Unix domain sockets");
+}
+
+server::~server() = default;
+
+void server::run(std::stop_token) { }
+
+void server::serve_connection(int, std::stop_token const&) { }
+
+client::client(std::filesystem::path const&)
+{
+    throw invalid_arg("serving needs Unix domain sockets");
+}
+
+client::~client() = default;
+
+void client::send(std::span<const std::byte>, input_format, std::uint32_t) { }
+
+response client::receive() { return { response_status::error, {} }; }
+
+std::size_t client::take(std::span<std::byte>) { return 0; }
+
+#endif
+
+}
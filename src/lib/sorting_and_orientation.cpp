@@ -1,105 +1,12 @@
 #include "nitro/fwd.hpp"
 #include <nitro/rectangle.hpp>
 #include <nitro/sorting_and_orientation.hpp>
+#include <algorithm>
+#include <iterator>
 #include <numeric>
 
 namespace nitro {
 
-std::strong_ordering horizontal_sort::compare(
-    const rectangle& lhs, const rectangle& rhs) const noexcept
-{
-    const auto lho = lhs.origin();
-    const auto rho = rhs.origin();
-    const auto lw  = lhs.width();
-    const auto lh  = lhs.height();
-    const auto lid = lhs.id();
-    const auto rw  = rhs.width();
-    const auto rh  = rhs.height();
-    const auto rid = rhs.id();
-    return std::tie(lho.x, lho.y, lw, lh, lid) <=> std::tie(rho.x, rho.y, rw, rh, rid);
-}
-std::weak_ordering horizontal_sort::compare(const rectangle& lhs, coordinate_t rhs) const noexcept
-{
-    return lhs.origin().x <=> rhs;
-}
-std::weak_ordering horizontal_sort::compare(coordinate_t lhs, rectangle const& rhs) const noexcept
-{
-    return lhs <=> rhs.origin().x;
-}
-// coordinate_t horizontal_sort::reference(rectangle const& r) const { return r.origin().x; }
-
-std::strong_ordering rev_horizontal_sort::compare(
-    const rectangle& lhs, const rectangle& rhs) const noexcept
-{
-    const auto lho_x = lhs.origin().x + lhs.width();
-    const auto lho_y = lhs.origin().y + lhs.height();
-    const auto rho_x = rhs.origin().x + rhs.width();
-    const auto rho_y = rhs.origin().y + rhs.height();
-    const auto lw    = lhs.width();
-    const auto lh    = lhs.height();
-    const auto lid   = lhs.id();
-    const auto rw    = rhs.width();
-    const auto rh    = rhs.height();
-    const auto rid   = rhs.id();
-    return std::tie(rho_x, rho_y, rw, rh, rid) <=> std::tie(lho_x, lho_y, lw, lh, lid);
-}
-std::weak_ordering rev_horizontal_sort::compare(
-    const rectangle& lhs, coordinate_t rhs) const noexcept
-{
-    return rhs <=> (lhs.origin().x + lhs.width());
-}
-std::weak_ordering rev_horizontal_sort::compare(
-    coordinate_t lhs, rectangle const& rhs) const noexcept
-{
-    return (rhs.origin().x + rhs.width()) <=> lhs;
-}
-
-std::strong_ordering vertical_sort::compare(
-    const rectangle& lhs, const rectangle& rhs) const noexcept
-{
-    const auto lho = lhs.origin();
-    const auto rho = rhs.origin();
-    const auto lw  = lhs.width();
-    const auto lh  = lhs.height();
-    const auto lid = lhs.id();
-    const auto rw  = rhs.width();
-    const auto rh  = rhs.height();
-    const auto rid = rhs.id();
-    return std::tie(lho.y, lho.x, lh, lw, lid) <=> std::tie(rho.y, rho.x, rh, rw, rid);
-}
-std::weak_ordering vertical_sort::compare(const rectangle& lhs, coordinate_t rhs) const noexcept
-{
-    return lhs.origin().y <=> rhs;
-}
-std::weak_ordering vertical_sort::compare(coordinate_t lhs, rectangle const& rhs) const noexcept
-{
-    return lhs <=> rhs.origin().y;
-}
-
-std::strong_ordering rev_vertical_sort::compare(
-    const rectangle& lhs, const rectangle& rhs) const noexcept
-{
-    const auto lho_x = lhs.origin().y + lhs.height();
-    const auto lho_y = lhs.origin().x + lhs.width();
-    const auto rho_x = rhs.origin().y + lhs.height();
-    const auto rho_y = rhs.origin().x + rhs.width();
-    const auto lw    = lhs.width();
-    const auto lh    = lhs.height();
-    const auto lid   = lhs.id();
-    const auto rw    = rhs.width();
-    const auto rh    = rhs.height();
-    const auto rid   = rhs.id();
-    return std::tie(rho_x, rho_y, rh, rw, rid) <=> std::tie(lho_x, lho_y, lh, lw, lid);
-}
-std::weak_ordering rev_vertical_sort::compare(const rectangle& lhs, coordinate_t rhs) const noexcept
-{
-    return rhs <=> (lhs.origin().y + lhs.height());
-}
-std::weak_ordering rev_vertical_sort::compare(coordinate_t lhs, rectangle const& rhs) const noexcept
-{
-    return (rhs.origin().y + rhs.height()) <=> lhs;
-}
-
 coordinate_t rev_vertical::ref(const rectangle& r) const noexcept
 {
     return r.origin().x + r.width();
@@ -198,4 +105,4 @@ coordinate_t rev_vertical::midpoint(coordinate_t a, coordinate_t b) const noexce
     return round_down(a, b);
 }
 
-}
\ No newline at end of file
+}
@@ -0,0 +1,235 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <nitro/spatial_index.hpp>
+#include <numeric>
+
+namespace nitro {
+
+namespace {
+    // enough levels for 2^32 rows at the fanout
+    constexpr std::size_t max_levels = 9;
+    static_assert(spatial_index::fanout == 16);
+
+    // covered by the cells right and above of the point
+    struct point_query {
+        point p;
+
+        bool hits(
+            coordinate_t x0, coordinate_t y0, coordinate_t x1, coordinate_t y1) const noexcept
+        {
+            return x0 <= p.x && p.x < x1 && y0 <= p.y && p.y < y1;
+        }
+    };
+
+    // overlapping with some area
+    struct window_query {
+        coordinate_t x0, y0, x1, y1;
+
+        bool hits(coordinate_t bx0, coordinate_t by0, coordinate_t bx1,
+            coordinate_t by1) const noexcept
+        {
+            return bx0 < x1 && x0 < bx1 && by0 < y1 && y0 < by1;
+        }
+    };
+
+    struct point_queries {
+        std::span<const point> points;
+
+        std::size_t size() const noexcept { return points.size(); }
+        point_query operator[](std::size_t i) const noexcept { return { points[i] }; }
+    };
+
+    struct window_queries {
+        rectangle_store const& windows;
+
+        std::size_t  size() const noexcept { return windows.size(); }
+        window_query operator[](std::size_t i) const noexcept
+        {
+            return { windows.x(i), windows.y(i), windows.x(i) + windows.width(i),
+                windows.y(i) + windows.height(i) };
+        }
+    };
+}
+
+query_results::query_results(allocator_type alloc)
+    : offsets(1, 0, alloc)
+    , rows(alloc)
+{
+}
+
+spatial_index::level::level(allocator_type alloc)
+    : x0(alloc)
+    , y0(alloc)
+    , x1(alloc)
+    , y1(alloc)
+{
+}
+
+spatial_index::spatial_index(rectangle_store const& rows, allocator_type alloc)
+    : m_levels(alloc)
+    , m_rows(rows.size(), alloc)
+{
+    // sort-tile-recursive packing: the rows are cut into about sqrt(leaves) slices along x by
+    // their centers, and every slice into leaves along y
+    const auto xs = rows.xs(), ys = rows.ys(), ws = rows.widths(), hs = rows.heights();
+    std::iota(m_rows.begin(), m_rows.end(), index_t { 0 });
+    const auto by_center = [](auto origins, auto extents) {
+        // twice the center, which stays integral
+        return [=](index_t i) { return 2 * origins[i] + extents[i]; };
+    };
+    rng::sort(m_rows, std::less<> {}, by_center(xs, ws));
+    const auto leaves    = (rows.size() + fanout - 1) / fanout;
+    const auto slices    = static_cast<std::size_t>(std::ceil(std::sqrt(leaves)));
+    const auto per_slice = slices == 0 ? 0 : (leaves + slices - 1) / slices * fanout;
+    for (std::size_t first = 0; first < m_rows.size(); first += per_slice) {
+        const auto n = std::min(per_slice, m_rows.size() - first);
+        rng::sort(std::span(m_rows).subspan(first, n), std::less<> {}, by_center(ys, hs));
+    }
+
+    auto& bottom = m_levels.emplace_back(alloc);
+    bottom.x0.reserve(rows.size());
+    bottom.y0.reserve(rows.size());
+    bottom.x1.reserve(rows.size());
+    bottom.y1.reserve(rows.size());
+    for (auto i : m_rows) {
+        bottom.x0.push_back(xs[i]);
+        bottom.y0.push_back(ys[i]);
+        bottom.x1.push_back(xs[i] + ws[i]);
+        bottom.y1.push_back(ys[i] + hs[i]);
+    }
+    while (m_levels.back().size() > 1) {
+        level       up(alloc);
+        const auto& below = m_levels.back();
+        for (std::size_t first = 0; first < below.size(); first += fanout) {
+            const auto n = std::min(fanout, below.size() - first);
+            const auto column = [&](auto const& c) { return std::span(c).subspan(first, n); };
+            up.x0.push_back(rng::min(column(below.x0)));
+            up.y0.push_back(rng::min(column(below.y0)));
+            up.x1.push_back(rng::max(column(below.x1)));
+            up.y1.push_back(rng::max(column(below.y1)));
+        }
+        m_levels.push_back(std::move(up));
+    }
+}
+
+// depth first from the root, keeping the nodes to visit in a stack on the stack
+template <typename Query>
+void spatial_index::find(Query const& q, std::pmr::vector<index_t>& found) const
+{
+    found.clear();
+    const auto hits = [&](level const& l, std::size_t i) {
+        return q.hits(l.x0[i], l.y0[i], l.x1[i], l.y1[i]);
+    };
+    if (m_rows.empty() || !hits(m_levels.back(), 0))
+        return;
+    // a single row is the root
+    if (m_levels.size() == 1) {
+        found.push_back(m_rows[0]);
+        return;
+    }
+    std::array<std::pair<std::size_t, std::size_t>, max_levels * fanout> stack;
+    std::size_t                                                        top = 0;
+    stack[top++] = { m_levels.size() - 1, 0 };
+    while (top > 0) {
+        const auto [l, node] = stack[--top];
+        const auto& below    = m_levels[l - 1];
+        const auto  last     = std::min(below.size(), (node + 1) * fanout);
+        for (auto i = node * fanout; i < last; ++i) {
+            if (!hits(below, i))
+                continue;
+            if (l == 1)
+                found.push_back(m_rows[i]);
+            else
+                stack[top++] = { l - 1, i };
+        }
+    }
+    rng::sort(found);
+}
+
+void spatial_index::covering(point p, std::pmr::vector<index_t>& found) const
+{
+    find(point_query { p }, found);
+}
+
+void spatial_index::overlapping(rectangle const& window, std::pmr::vector<index_t>& found) const
+{
+    find(window_query { window.origin().x, window.origin().y, window.origin().x + window.width(),
+             window.origin().y + window.height() },
+        found);
+}
+
+// Descends with the queries that reach a node, narrowed down level by level in a buffer per
+// level, then groups what was found by query.
+template <typename Queries>
+query_results spatial_index::find_all(
+    Queries const& queries, query_results::allocator_type alloc) const
+{
+    query_results result(alloc);
+    result.offsets.assign(queries.size() + 1, 0);
+    if (m_rows.empty() || queries.size() == 0)
+        return result;
+
+    // query and row of every hit
+    std::pmr::vector<std::pair<index_t, index_t>> hits(alloc);
+    // the queries reaching the node visited on every level, which the inner vectors take alloc for
+    std::pmr::vector<std::pmr::vector<index_t>> active(m_levels.size(), alloc);
+    const auto narrow = [&](std::span<const index_t> from, level const& lv, std::size_t i,
+                            std::pmr::vector<index_t>& to) {
+        to.clear();
+        for (auto q : from) {
+            if (queries[q].hits(lv.x0[i], lv.y0[i], lv.x1[i], lv.y1[i]))
+                to.push_back(q);
+        }
+    };
+
+    std::pmr::vector<index_t> all(queries.size(), alloc);
+    std::iota(all.begin(), all.end(), index_t { 0 });
+    auto& root = active[m_levels.size() - 1];
+    narrow(all, m_levels.back(), 0, root);
+    const auto visit = [&](auto& self, std::size_t l, std::size_t node) -> void {
+        if (l == 0) {
+            for (auto q : active[0])
+                hits.emplace_back(q, m_rows[node]);
+            return;
+        }
+        const auto& below = m_levels[l - 1];
+        const auto  last  = std::min(below.size(), (node + 1) * fanout);
+        for (auto i = node * fanout; i < last; ++i) {
+            narrow(active[l], below, i, active[l - 1]);
+            if (!active[l - 1].empty())
+                self(self, l - 1, i);
+        }
+    };
+    if (!root.empty())
+        visit(visit, m_levels.size() - 1, 0);
+
+    // counting sort by query, then every query's rows in order
+    for (const auto& h : hits)
+        ++result.offsets[h.first + 1];
+    std::partial_sum(result.offsets.begin(), result.offsets.end(), result.offsets.begin());
+    result.rows.resize(hits.size());
+    auto next = result.offsets;
+    for (const auto& h : hits)
+        result.rows[next[h.first]++] = h.second;
+    for (std::size_t q = 0; q < queries.size(); ++q) {
+        const auto first = result.rows.begin() + static_cast<std::ptrdiff_t>(result.offsets[q]);
+        const auto last  = result.rows.begin() + static_cast<std::ptrdiff_t>(result.offsets[q + 1]);
+        std::sort(first, last);
+    }
+    return result;
+}
+
+query_results spatial_index::covering(
+    std::span<const point> points, query_results::allocator_type alloc) const
+{
+    return find_all(point_queries { points }, alloc);
+}
+
+query_results spatial_index::overlapping(
+    rectangle_store const& windows, query_results::allocator_type alloc) const
+{
+    return find_all(window_queries { windows }, alloc);
+}
+
+}
@@ -0,0 +1,55 @@
+#include <algorithm>
+#include <nitro/stats.hpp>
+
+#include <nlohmann/json.hpp>
+
+namespace nitro {
+
+namespace {
+    double seconds(std::chrono::nanoseconds d)
+    {
+        return std::chrono::duration<double>(d).count();
+    }
+}
+
+build_stats& build_stats::operator+=(build_stats const& other) noexcept
+{
+    subtrees += other.subtrees;
+    slices += other.slices;
+    rows_sliced += other.rows_sliced;
+    read_off += other.read_off;
+    orientation_changes += other.orientation_changes;
+    max_pending = std::max(max_pending, other.max_pending);
+    bytes_allocated += other.bytes_allocated;
+    peak_bytes = std::max(peak_bytes, other.peak_bytes);
+    build_time += other.build_time;
+    return *this;
+}
+
+void phase_times::add(std::string phase, duration d)
+{
+    auto it = std::find_if(
+        phases.begin(), phases.end(), [&](auto const& p) { return p.first == phase; });
+    if (it == phases.end())
+        phases.emplace_back(std::move(phase), d);
+    else
+        it->second += d;
+}
+
+void to_json(nlohmann::json& j, build_stats const& stats)
+{
+    j = nlohmann::json { { "subtrees", stats.subtrees }, { "slices", stats.slices },
+        { "rows_sliced", stats.rows_sliced }, { "read_off", stats.read_off },
+        { "orientation_changes", stats.orientation_changes },
+        { "max_pending", stats.max_pending }, { "bytes_allocated", stats.bytes_allocated },
+        { "peak_bytes", stats.peak_bytes }, { "build_seconds", seconds(stats.build_time) } };
+}
+
+void to_json(nlohmann::json& j, phase_times const& times)
+{
+    j = nlohmann::json::object();
+    for (const auto& [phase, d] : times.phases)
+        j[phase] = seconds(d);
+}
+
+}
@@ -0,0 +1,234 @@
+#include "nitro/exceptions.hpp"
+#include "nitro/fwd.hpp"
+#include "nitro/rectangle.hpp"
+#include <algorithm>
+#include <cassert>
+#include <memory_resource>
+#include <nitro/deadline.hpp>
+#include <nitro/sweep_line.hpp>
+#include <numeric>
+#include <ranges>
+#include <set>
+#include <span>
+#include <vector>
+
+namespace nitro {
+
+using index_t = rectangle_store::index_t;
+
+namespace {
+    // segment tree over the elementary y intervals [ys[i], ys[i+1]), every node holding the
+    // rectangles which cover its whole range but not the range of its parent. Next to it the
+    // y edges of the rectangles in the tree, the cuts: neighbouring intervals not separated by
+    // one have the same cover, so the intervals form runs of equal covers between the cuts.
+    struct cover_tree {
+        using leaf_range = std::pair<std::size_t, std::size_t>;
+        using cover_t    = std::pmr::vector<index_t>;
+
+        explicit cover_tree(std::pmr::vector<coordinate_t> ys)
+            : m_ys(std::move(ys))
+            , m_leaves(m_ys.size() - 1)
+            , m_nodes(4 * m_leaves, m_ys.get_allocator())
+            , m_edges(m_ys.size(), m_ys.get_allocator())
+            , m_cuts(m_ys.get_allocator())
+        {
+            assert(m_ys.size() > 1);
+        }
+
+        [[nodiscard]] leaf_range leaves_of(rectangle const& r) const
+        {
+            const auto first = rng::lower_bound(m_ys, r.origin().y);
+            const auto last  = rng::lower_bound(m_ys, r.origin().y + r.height());
+            return { static_cast<std::size_t>(first - m_ys.begin()),
+                static_cast<std::size_t>(last - m_ys.begin()) };
+        }
+
+        void insert(index_t r, rectangle const& rect)
+        {
+            const auto range = leaves_of(rect);
+            update(1, 0, m_leaves, range, [&](cover_t& c) { c.push_back(r); });
+            for (const auto cut : { range.first, range.second }) {
+                if (m_edges[cut]++ == 0)
+                    m_cuts.insert(cut);
+            }
+        }
+
+        void erase(index_t r, rectangle const& rect)
+        {
+            const auto range = leaves_of(rect);
+            update(1, 0, m_leaves, range, [&](cover_t& c) {
+                auto it = rng::find(c, r);
+                assert(it != c.end());
+                *it = c.back();
+                c.pop_back();
+            });
+            for (const auto cut : { range.first, range.second }) {
+                if (--m_edges[cut] == 0)
+                    m_cuts.erase(cut);
+            }
+        }
+
+        // calls f with the covering rectangles of every run of equal covers in [first, last),
+        // once per run; each takes O(log n) and the size of the cover
+        template <typename F> void for_each_run(leaf_range range, F&& f) const
+        {
+            cover_t cover(m_ys.get_allocator());
+            for (auto leaf = range.first; leaf < range.second;) {
+                cover.clear();
+                cover_of(leaf, cover);
+                f(std::as_const(cover));
+                const auto cut = m_cuts.upper_bound(leaf);
+                leaf           = cut == m_cuts.end() ? range.second : *cut;
+            }
+        }
+
+    private:
+        template <typename F>
+        void update(std::size_t node, std::size_t lo, std::size_t hi, leaf_range range, F&& f)
+        {
+            const auto [first, last] = range;
+            if (last <= lo || hi <= first)
+                return;
+            if (first <= lo && hi <= last) {
+                f(m_nodes[node]);
+                return;
+            }
+            const auto mid = std::midpoint(lo, hi);
+            update(2 * node, lo, mid, range, f);
+            update(2 * node + 1, mid, hi, range, f);
+        }
+
+        // appends the rectangles on the path from the root down to the leaf
+        void cover_of(std::size_t leaf, cover_t& cover) const
+        {
+            std::size_t node = 1, lo = 0, hi = m_leaves;
+            for (;;) {
+                cover.insert(cover.end(), m_nodes[node].begin(), m_nodes[node].end());
+                if (hi - lo == 1)
+                    return;
+                const auto mid = std::midpoint(lo, hi);
+                if (leaf < mid) {
+                    node = 2 * node;
+                    hi   = mid;
+                } else {
+                    node = 2 * node + 1;
+                    lo   = mid;
+                }
+            }
+        }
+
+        std::pmr::vector<coordinate_t> m_ys;
+        std::size_t                    m_leaves;
+        std::pmr::vector<cover_t>      m_nodes;
+        // how many rectangles in the tree have an edge at ys[i], the cuts being those above 0
+        std::pmr::vector<std::size_t>  m_edges;
+        std::pmr::set<std::size_t>     m_cuts;
+    };
+
+    struct edge {
+        coordinate_t x;
+        bool         opening;
+        index_t      rect;
+    };
+
+    auto compressed_ys(rectangles_list const& rects, std::pmr::memory_resource* resource)
+    {
+        std::pmr::vector<coordinate_t> ys(resource);
+        ys.reserve(2 * rects.size());
+        for (const auto& r : rects) {
+            ys.push_back(r.origin().y);
+            ys.push_back(r.origin().y + r.height());
+        }
+        rng::sort(ys);
+        auto [first, last] = rng::unique(ys);
+        ys.erase(first, last);
+        return ys;
+    }
+
+    auto sorted_edges(std::span<const rect_ptr> rects, std::pmr::memory_resource* resource)
+    {
+        std::pmr::vector<edge> edges(resource);
+        edges.reserve(2 * rects.size());
+        for (index_t i = 0; i < rects.size(); ++i) {
+            edges.push_back({ rects[i]->origin().x, true, i });
+            edges.push_back({ rects[i]->origin().x + rects[i]->width(), false, i });
+        }
+        rng::sort(edges, std::less<> {}, &edge::x);
+        return edges;
+    }
+
+    // merges overlapping leaf ranges, so that every leaf is visited at most once per event
+    void coalesce(std::pmr::vector<cover_tree::leaf_range>& ranges)
+    {
+        rng::sort(ranges);
+        auto out = ranges.begin();
+        for (auto it = ranges.begin(); it != ranges.end(); ++it) {
+            if (out != ranges.begin() && it->first <= std::prev(out)->second) {
+                std::prev(out)->second = std::max(std::prev(out)->second, it->second);
+            } else {
+                *out++ = *it;
+            }
+        }
+        ranges.erase(out, ranges.end());
+    }
+}
+
+void sweep_line::build()
+{
+    m_roots.reserve(m_rects.size());
+    rng::copy(m_rects | views::transform(address_of_f {}), std::back_inserter(m_roots));
+    m_intersections = intersection_set(m_roots, m_resource);
+    if (m_rects.empty())
+        return;
+    cover_tree                               active(compressed_ys(m_rects, m_resource));
+    const auto                               edges = sorted_edges(m_roots, m_resource);
+    std::pmr::vector<cover_tree::leaf_range> dirty(m_resource);
+    cover_tree::cover_t                      members(m_resource);
+
+    auto add_cover = [&](cover_tree::cover_t const& cover) {
+        if (cover.size() < 2)
+            return;
+        members.assign(cover.begin(), cover.end());
+        m_intersections.insert(members);
+    };
+
+    deadline_poller poller(m_deadline);
+    for (auto first = edges.begin(); first != edges.end();) {
+        poller.poll();
+        const auto last
+            = std::find_if(first, edges.end(), [x = first->x](auto& e) { return e.x != x; });
+        dirty.clear();
+        for (const auto& e : rng::subrange(first, last)) {
+            if (e.opening)
+                active.insert(e.rect, *m_roots[e.rect]);
+            else
+                active.erase(e.rect, *m_roots[e.rect]);
+            dirty.push_back(active.leaves_of(*m_roots[e.rect]));
+        }
+        coalesce(dirty);
+        // every run spanned by a changed rectangle has a new cover, none can be skipped, but the
+        // leaves of a run share it
+        for (const auto& range : dirty)
+            active.for_each_run(range, add_cover);
+        first = last;
+    }
+    m_intersections.sort();
+}
+
+sweep_line::sweep_line(rectangles_list lst, std::optional<secs> timeout,
+    std::pmr::memory_resource* resource, std::stop_token stop)
+    : m_resource(resource)
+    , m_intersections({}, resource)
+    , m_rects(std::move(lst))
+    , m_roots(resource)
+    , m_deadline(timeout, std::move(stop))
+{
+    build();
+}
+
+auto sweep_line::intersections() const -> intersection_set const&
+{
+    return m_intersections;
+}
+
+}
@@ -0,0 +1,134 @@
+#include <algorithm>
+#include <cassert>
+#include <nitro/task_pool.hpp>
+#include <utility>
+
+namespace nitro {
+
+namespace {
+    thread_local task_pool const* current_pool {};
+    thread_local std::size_t      current_index {};
+}
+
+task_pool::task_pool(std::size_t threads)
+{
+    threads = std::max<std::size_t>(threads, 1);
+    for (std::size_t i = 0; i < threads; ++i)
+        m_queues.push_back(std::make_unique<queue>());
+    for (std::size_t i = 0; i < threads; ++i)
+        m_threads.emplace_back([this, i] { worker(i); });
+}
+
+task_pool::~task_pool()
+{
+    {
+        std::lock_guard l(m_mx);
+        m_stop = true;
+    }
+    m_cv.notify_all();
+    m_threads.clear();
+}
+
+std::optional<std::size_t> task_pool::worker_index() const noexcept
+{
+    if (current_pool != this)
+        return std::nullopt;
+    return current_index;
+}
+
+void task_pool::push(task t)
+{
+    std::size_t target {};
+    {
+        std::lock_guard l(m_mx);
+        ++m_pending;
+        ++m_queued;
+        target = worker_index().value_or(m_next_queue++ % m_queues.size());
+    }
+    {
+        auto&           q = *m_queues[target];
+        std::lock_guard l(q.mx);
+        q.tasks.push_back(std::move(t));
+    }
+    m_cv.notify_one();
+}
+
+void task_pool::run(task root)
+{
+    {
+        std::lock_guard l(m_mx);
+        assert(m_pending == 0);
+        m_error = nullptr;
+        m_cancelled.store(false, std::memory_order_relaxed);
+    }
+    push(std::move(root));
+    std::unique_lock l(m_mx);
+    m_done.wait(l, [this] { return m_pending == 0; });
+    if (m_error)
+        std::rethrow_exception(std::exchange(m_error, nullptr));
+}
+
+auto task_pool::pop(std::size_t self) -> std::optional<task>
+{
+    std::optional<task> result;
+    {
+        auto&           own = *m_queues[self];
+        std::lock_guard l(own.mx);
+        if (!own.tasks.empty()) {
+            result.emplace(std::move(own.tasks.back()));
+            own.tasks.pop_back();
+        }
+    }
+    for (std::size_t i = 1; !result && i < m_queues.size(); ++i) {
+        auto&           victim = *m_queues[(self + i) % m_queues.size()];
+        std::lock_guard l(victim.mx);
+        if (!victim.tasks.empty()) {
+            result.emplace(std::move(victim.tasks.front()));
+            victim.tasks.pop_front();
+        }
+    }
+    if (result) {
+        std::lock_guard l(m_mx);
+        --m_queued;
+    }
+    return result;
+}
+
+void task_pool::execute(task& t) noexcept
+{
+    try {
+        if (!cancelled())
+            t();
+    } catch (...) {
+        std::lock_guard l(m_mx);
+        if (!m_error)
+            m_error = std::current_exception();
+        m_cancelled.store(true, std::memory_order_relaxed);
+    }
+    t = nullptr;
+    bool done {};
+    {
+        std::lock_guard l(m_mx);
+        done = --m_pending == 0;
+    }
+    if (done)
+        m_done.notify_all();
+}
+
+void task_pool::worker(std::size_t self)
+{
+    current_pool  = this;
+    current_index = self;
+    while (true) {
+        if (auto t = pop(self)) {
+            execute(*t);
+            continue;
+        }
+        std::unique_lock l(m_mx);
+        m_cv.wait(l, [this] { return m_stop || m_queued > 0; });
+        if (m_stop)
+            return;
+    }
+}
+
+}
@@ -0,0 +1,83 @@
+#include <algorithm>
+#include <nitro/text_writer.hpp>
+
+namespace nitro {
+
+namespace {
+    void write_rect(text_writer& w, std::size_t id, point origin, coordinate_t width,
+        coordinate_t height)
+    {
+        w << "    " << id << ": Rectangle at " << origin << ", w=" << width << ", h=" << height
+          << '.';
+    }
+}
+
+text_writer::text_writer(std::ostream& os, std::size_t capacity)
+    : m_os(os)
+    , m_buffer(std::max<std::size_t>(capacity, 64))
+{
+}
+
+text_writer::~text_writer()
+{
+    // a stream throwing on errors has to be flushed explicitly to see them
+    try {
+        drain();
+    } catch (...) {
+    }
+}
+
+text_writer& text_writer::operator<<(rectangle const& r)
+{
+    write_rect(*this, r.id(), r.origin(), r.width(), r.height());
+    return *this;
+}
+
+void text_writer::flush()
+{
+    drain();
+    m_os.flush();
+}
+
+void text_writer::drain()
+{
+    m_os.write(m_buffer.data(), static_cast<std::streamsize>(m_size));
+    m_size = 0;
+}
+
+text_writer& text_writer::write_through(std::string_view s)
+{
+    drain();
+    m_os.write(s.data(), static_cast<std::streamsize>(s.size()));
+    return *this;
+}
+
+void write_input(text_writer& w, rectangle_store const& rects)
+{
+    w << "Input:\n";
+    for (std::size_t i = 0; i < rects.size(); ++i) {
+        write_rect(w, rects.id(i), { rects.x(i), rects.y(i) }, rects.width(i), rects.height(i));
+        w << '\n';
+    }
+    w << '\n';
+}
+
+void write_intersections(
+    text_writer& w, intersection_set const& intersections, rectangle_store const& areas)
+{
+    w << "Intersections\n";
+    const auto  roots = intersections.roots();
+    std::size_t row   = 0;
+    for (const auto& i : intersections) {
+        // "1, 2 and 3", the members being sorted by id already
+        const auto members = i.members();
+        w << "    Between rectangle " << roots[members[0]]->id();
+        for (std::size_t k = 1; k < members.size(); ++k)
+            w << (k + 1 < members.size() ? ", " : " and ") << roots[members[k]]->id();
+        w << " at " << point { areas.x(row), areas.y(row) } << ", w=" << areas.width(row)
+          << ", h=" << areas.height(row) << ".\n";
+        ++row;
+    }
+}
+
+}
@@ -0,0 +1,297 @@
+#include <nitro/deadline.hpp>
+#include <nitro/exceptions.hpp>
+#include <nitro/sorting_and_orientation.hpp>
+#include <nitro/task_pool.hpp>
+#include <nitro/tiled_tree.hpp>
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <utility>
+
+namespace nitro {
+
+static_assert(std::endian::native == std::endian::little,
+    "tile files are written in the byte order of the host, which has to be little endian");
+
+namespace {
+    using index_t = rectangle_store::index_t;
+
+    // the edges of count slabs of the extent [low, high) along one axis, cut at the quantiles of
+    // the doubled centers
+    std::vector<coordinate_t> cuts(std::span<const coordinate_t> origins,
+        std::span<const coordinate_t> extents, std::size_t count)
+    {
+        if (origins.empty())
+            return { 0, 1 };
+        coordinate_t low = origins[0], high = origins[0] + extents[0];
+        std::vector<coordinate_t> centers(origins.size());
+        for (std::size_t i = 0; i < origins.size(); ++i) {
+            low        = std::min(low, origins[i]);
+            high       = std::max(high, origins[i] + extents[i]);
+            centers[i] = 2 * origins[i] + extents[i];
+        }
+        rng::sort(centers);
+        std::vector<coordinate_t> result { low };
+        for (std::size_t k = 1; k < std::max<std::size_t>(count, 1); ++k) {
+            // halved rounding down, negative centers too
+            const auto cut = centers[centers.size() * k / count] >> 1;
+            if (cut > result.back() && cut < high)
+                result.push_back(cut);
+        }
+        result.push_back(high);
+        return result;
+    }
+
+    template <typename T> void write_column(std::ostream& os, std::span<const T> column)
+    {
+        os.write(reinterpret_cast<char const*>(column.data()),
+            static_cast<std::streamsize>(column.size_bytes()));
+    }
+
+    template <typename T> void read_column(std::istream& is, std::span<T> column)
+    {
+        is.read(reinterpret_cast<char*>(column.data()),
+            static_cast<std::streamsize>(column.size_bytes()));
+        if (is.gcount() != static_cast<std::streamsize>(column.size_bytes()))
+            throw invalid_arg("truncated tile file");
+    }
+}
+
+tile_grid::tile_grid(rectangle_store const& rects, std::size_t columns, std::size_t rows)
+    : m_xs(cuts(rects.xs(), rects.widths(), columns))
+    , m_ys(cuts(rects.ys(), rects.heights(), rows))
+{
+}
+
+tile_grid tile_grid::with_at_most(rectangle_store const& rects, std::size_t rows_per_tile)
+{
+    const auto per_tile = std::max<std::size_t>(rows_per_tile, 1);
+    const auto tiles    = (rects.size() + per_tile - 1) / per_tile;
+    const auto per_axis = static_cast<std::size_t>(std::ceil(std::sqrt(tiles)));
+    return { rects, per_axis, per_axis };
+}
+
+rectangle tile_grid::operator[](std::size_t i) const
+{
+    const auto column = i % columns(), row = i / columns();
+    return rectangle { { m_xs[column], m_ys[row] },
+        { m_xs[column + 1] - m_xs[column], m_ys[row + 1] - m_ys[row] } };
+}
+
+rectangle_store clip(rectangle_store const& rects, rectangle const& tile,
+    std::pmr::vector<index_t>& origins, rectangle_store::allocator_type alloc)
+{
+    const auto  xs = rects.xs(), ys = rects.ys(), ws = rects.widths(), hs = rects.heights();
+    const auto  low = tile.origin();
+    const point high { low.x + tile.width(), low.y + tile.height() };
+    origins.clear();
+    rectangle_store result(alloc);
+    for (std::size_t i = 0; i < rects.size(); ++i) {
+        if (xs[i] >= high.x || xs[i] + ws[i] <= low.x || ys[i] >= high.y
+            || ys[i] + hs[i] <= low.y) {
+            continue;
+        }
+        // overlapping the tile, every cut leaves a part within it
+        const auto r   = rects.rect(i);
+        auto       cut = *r.slice(vertical { low.x }).second;
+        cut            = *cut.slice(vertical { high.x }).first;
+        cut            = *cut.slice(horizontal { low.y }).second;
+        cut            = *cut.slice(horizontal { high.y }).first;
+        result.push_back(cut.origin(), cut.extent(), rects.id(i));
+        origins.push_back(static_cast<index_t>(i));
+    }
+    return result;
+}
+
+tile_intersections::tile_intersections(allocator_type alloc)
+    : members(alloc)
+    , offsets(1, 0, alloc)
+{
+}
+
+tile_intersections build_tile(rectangle_store const& rects, tile_grid const& grid, std::size_t i,
+    std::optional<partition_tree::secs> timeout, std::pmr::memory_resource* resource,
+    std::stop_token stop)
+{
+    if (i >= grid.size()) {
+        throw invalid_arg(
+            "no tile " + std::to_string(i) + " in a grid of " + std::to_string(grid.size()));
+    }
+    tile_intersections result(resource);
+    result.tile       = static_cast<std::uint32_t>(i);
+    result.tiles      = static_cast<std::uint32_t>(grid.size());
+    result.input_rows = rects.size();
+
+    // the clipped rows and the tree are released together with the pool
+    std::pmr::unsynchronized_pool_resource pool(resource);
+    std::pmr::vector<index_t>              origins(&pool);
+    auto                                   clipped = clip(rects, grid[i], origins, &pool);
+    if (clipped.size() < 2)
+        return result;
+    const partition_tree tree(std::move(clipped), timeout, 1, {}, &pool, std::move(stop));
+    // the roots of the tree are the clipped rows, sorted by the same ids as the rows of rects
+    for (const auto isec : tree.intersections()) {
+        for (const auto m : isec.members())
+            result.members.push_back(origins[m]);
+        result.offsets.push_back(result.members.size());
+    }
+    return result;
+}
+
+void write_tile_intersections(std::ostream& os, tile_intersections const& part)
+{
+    const tile_header header { tile_header::magic_value, tile_header::current_version, part.tile,
+        part.tiles, 0, part.input_rows, part.size(), part.members.size() };
+    os.write(reinterpret_cast<char const*>(&header), sizeof(header));
+    write_column(os, std::span(part.offsets));
+    write_column(os, std::span(part.members));
+    if (part.members.size() % 2 != 0) {
+        const index_t padding {};
+        write_column(os, std::span(&padding, 1));
+    }
+}
+
+tile_intersections read_tile_intersections(
+    std::istream& is, tile_intersections::allocator_type alloc)
+{
+    tile_header header {};
+    read_column(is, std::span(&header, 1));
+    if (header.magic != tile_header::magic_value)
+        throw invalid_arg("not a tile file");
+    if (header.version != tile_header::current_version)
+        throw invalid_arg("unsupported tile file version");
+    if (header.tile >= header.tiles)
+        throw invalid_arg("no tile " + std::to_string(header.tile) + " in a grid of "
+            + std::to_string(header.tiles));
+    // every intersection has two members at least
+    if (header.intersections > header.members / 2)
+        throw invalid_arg("corrupt tile file");
+
+    tile_intersections result(alloc);
+    result.tile       = header.tile;
+    result.tiles      = header.tiles;
+    result.input_rows = header.input_rows;
+    // grown as the file delivers, so that a bogus header doesn't allocate it all up front
+    constexpr std::size_t chunk = 1 << 16;
+    const auto            read_grown = [&](auto& column, std::uint64_t count) {
+        for (std::size_t done = column.size(); done < count; done = column.size()) {
+            column.resize(done + std::min<std::uint64_t>(chunk, count - done));
+            read_column(is, std::span(column).subspan(done));
+        }
+    };
+    result.offsets.clear();
+    read_grown(result.offsets, header.intersections + 1);
+    read_grown(result.members, header.members);
+    if (header.members % 2 != 0) {
+        index_t padding {};
+        read_column(is, std::span(&padding, 1));
+    }
+    if (result.offsets.front() != 0 || result.offsets.back() != header.members
+        || !rng::is_sorted(result.offsets)
+        || rng::any_of(result.members, [&](auto m) { return m >= header.input_rows; })) {
+        throw invalid_arg("corrupt tile file");
+    }
+    return result;
+}
+
+tiled_tree::tiled_tree(rectangle_store store, tile_grid const& grid, std::optional<secs> timeout,
+    std::size_t threads, std::pmr::memory_resource* resource, std::stop_token stop)
+    : m_pool(resource)
+    , m_store(std::move(store))
+    , m_rects(&m_pool)
+    , m_roots(&m_pool)
+    , m_intersections({}, &m_pool)
+{
+    bind_roots();
+    // the builds of all tiles share the timeout, and a tile failing stops the others
+    const auto        start = deadline::clock::now();
+    const deadline    overall(timeout, stop);
+    std::stop_source  failed;
+    std::stop_callback forward(stop, [&] { failed.request_stop(); });
+    const auto        left = [&]() -> std::optional<secs> {
+        overall.check();
+        if (!timeout)
+            return std::nullopt;
+        // partition_tree takes whole seconds
+        return std::chrono::ceil<secs>(*timeout - (deadline::clock::now() - start));
+    };
+
+    std::mutex mx;
+    const auto tile = [&](std::size_t i) {
+        try {
+            const auto part = build_tile(m_store, grid, i, left(), &m_pool, failed.get_token());
+            std::lock_guard l(mx);
+            merge(part);
+        } catch (...) {
+            failed.request_stop();
+            throw;
+        }
+    };
+    if (threads < 2) {
+        for (std::size_t i = 0; i < grid.size(); ++i)
+            tile(i);
+    } else {
+        task_pool pool(threads);
+        pool.run([&] {
+            for (std::size_t i = 0; i < grid.size(); ++i)
+                pool.push([&tile, i] { tile(i); });
+        });
+    }
+    m_intersections.sort();
+}
+
+tiled_tree::tiled_tree(rectangle_store store, std::span<const tile_intersections> parts,
+    std::pmr::memory_resource* resource)
+    : m_pool(resource)
+    , m_store(std::move(store))
+    , m_rects(&m_pool)
+    , m_roots(&m_pool)
+    , m_intersections({}, &m_pool)
+{
+    bind_roots();
+    if (parts.empty())
+        throw invalid_arg("no tiles to merge");
+    const auto        tiles = parts.front().tiles;
+    std::vector<bool> seen(tiles);
+    for (const auto& part : parts) {
+        if (part.tiles != tiles || part.tile >= tiles || seen[part.tile])
+            throw invalid_arg("tiles of different grids, or a tile more than once");
+        if (part.input_rows != m_store.size())
+            throw invalid_arg("tile " + std::to_string(part.tile) + " is of another input");
+        seen[part.tile] = true;
+    }
+    if (const auto missing = rng::find(seen, false); missing != seen.end()) {
+        throw invalid_arg(
+            "tile " + std::to_string(missing - seen.begin()) + " is missing");
+    }
+    for (const auto& part : parts)
+        merge(part);
+    m_intersections.sort();
+}
+
+void tiled_tree::bind_roots()
+{
+    m_rects.reserve(m_store.size());
+    for (std::size_t i = 0; i < m_store.size(); ++i)
+        m_rects.push_back(m_store.rect(i));
+    m_roots.reserve(m_rects.size());
+    rng::copy(m_rects | views::transform(address_of_f {}), std::back_inserter(m_roots));
+    m_intersections.rebind(m_roots);
+}
+
+void tiled_tree::merge(tile_intersections const& part)
+{
+    // insert sorts the run in place
+    std::pmr::vector<index_t> members(&m_pool);
+    for (std::size_t i = 0; i < part.size(); ++i) {
+        members.assign(part[i].begin(), part[i].end());
+        m_intersections.insert(members);
+    }
+}
+
+}
@@ -16,10 +16,12 @@ def main():
                         help="baseline expected output text", required=True)
     parser.add_argument("-t", "--timeout",
                         help="timeout value for runtime", type=int, default=60)
+    parser.add_argument("-a", "--app-arg", action="append", default=[],
+                        help="extra option passed to the executable, e.g. --app-arg=--engine=sweep")
     parser.add_argument("input", help="Input json file")
     args = parser.parse_args()
     result = subprocess.check_output(
-        [args.exec, args.input, str(args.timeout)]).decode()
+        [args.exec, *args.app_arg, args.input, str(args.timeout)]).decode()
     result = result.replace('\r\n', '\n')
     result = [l for l in result.splitlines() if l.strip()]
 
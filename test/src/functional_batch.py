@@ -0,0 +1,73 @@
+#!/usr/bin/env python
+
+import argparse
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+
+
+def run(args, *app_args):
+    return subprocess.run([args.exec, "batch", *app_args], capture_output=True, text=True)
+
+
+def lines(text):
+    return [l.strip('\n') for l in text.splitlines() if l.strip()]
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        formatter_class=argparse.ArgumentDefaultsHelpFormatter)
+    parser.add_argument(
+        "-e", "--exec", help="path to executable binary", required=True)
+    parser.add_argument("-b", "--baseline",
+                        help="baseline expected output text", required=True)
+    parser.add_argument("input", help="Input json file")
+    args = parser.parse_args()
+    with open(args.baseline) as fbaseline:
+        baseline = lines(fbaseline.read())
+
+    with tempfile.TemporaryDirectory() as tmp:
+        # an input listed in a manifest next to one given directly, which fails to parse
+        manifest = os.path.join(tmp, "inputs.txt")
+        with open(manifest, "w") as f:
+            f.write(os.path.abspath(args.input) + "\n\n")
+        broken = os.path.join(tmp, "broken.json")
+        with open(broken, "w") as f:
+            f.write('{ "rects": [ { "x": 1 ')
+        out = os.path.join(tmp, "out")
+        result = run(args, out, "@" + manifest, broken)
+        if result.returncode == 0:
+            return "a failed input should make batch fail"
+        if "broken.json" not in result.stderr:
+            return "the failed input isn't reported: " + result.stderr
+        if os.path.exists(os.path.join(out, "broken.json.txt")):
+            return "the output of the failed input is left behind"
+        with open(os.path.join(out, os.path.basename(args.input) + ".txt")) as f:
+            if lines(f.read()) != baseline:
+                return "output of the manifest input differs from baseline"
+
+        # inputs in different directories, but with the same file name
+        other = os.path.join(tmp, "other")
+        os.mkdir(other)
+        shutil.copy(args.input, other)
+        out = os.path.join(tmp, "duplicates")
+        result = run(args, out, args.input, os.path.join(
+            other, os.path.basename(args.input)))
+        if result.returncode == 0 or "same file name" not in result.stderr:
+            return "inputs with the same file name should be rejected"
+        if os.path.exists(out):
+            return "rejected batch created its output directory"
+
+        # an input cut short by its deadline keeps its partial output, but doesn't pass
+        out = os.path.join(tmp, "anytime")
+        result = run(args, "--anytime", "--timeout=0", out, args.input)
+        if result.returncode == 0 or "Timed out" not in result.stderr:
+            return "an incomplete input should be reported and make batch fail"
+        if not os.path.exists(os.path.join(out, os.path.basename(args.input) + ".txt")):
+            return "the partial output of the incomplete input is missing"
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,97 @@
+#include <catch2/catch.hpp>
+
+#include "test_utils.hpp"
+
+#include <nitro/batch_intersect.hpp>
+#include <nitro/partition_tree.hpp>
+#include <nitro/rectangle_store.hpp>
+#include <nitro/sweep_line.hpp>
+
+#include <optional>
+#include <random>
+#include <vector>
+
+using namespace nitro;
+
+namespace {
+auto fold(rectangle_store const& rows)
+{
+    std::optional<rectangle> result = rows.rect(0);
+    for (std::size_t i = 1; i < rows.size(); ++i)
+        result = rectangle::intersect(rows.rect(i), result);
+    return result;
+}
+}
+
+TEST_CASE("batch overlap bounds", "[batch_intersect]")
+{
+    SECTION("no segment")
+    {
+        const auto b = overlap({}, {});
+        REQUIRE(b.first < b.last);
+        REQUIRE_FALSE(intersect(rectangle_store {}));
+    }
+    SECTION("past the vector width and the scalar tail")
+    {
+        std::vector<coordinate_t> origins, extents;
+        // segment i spans [i, 100 - i), so the first n of them overlap on [n - 1, 101 - n)
+        for (coordinate_t i = 0; i < 19; ++i) {
+            origins.push_back(i);
+            extents.push_back(100 - 2 * i);
+        }
+        for (std::size_t n = 1; n <= origins.size(); ++n) {
+            const auto b = overlap(std::span(origins).first(n), std::span(extents).first(n));
+            REQUIRE(b.first == static_cast<coordinate_t>(n - 1));
+            REQUIRE(b.last == static_cast<coordinate_t>(101 - n));
+        }
+    }
+}
+
+TEST_CASE("batch intersect matches the pairwise fold", "[batch_intersect]")
+{
+    std::mt19937                                gen(7);
+    std::uniform_int_distribution<coordinate_t> pos(0, 50);
+    std::uniform_int_distribution<coordinate_t> len(1, 60);
+    std::uniform_int_distribution<std::size_t>  count(1, 24);
+    for (int round = 0; round < 500; ++round) {
+        rectangle_store rows;
+        for (auto n = count(gen); n > 0; --n)
+            rows.push_back({ pos(gen), pos(gen) }, { len(gen), len(gen) }, n);
+        const auto expected = fold(rows);
+        const auto actual   = intersect(rows);
+        REQUIRE(expected.has_value() == actual.has_value());
+        if (expected) {
+            REQUIRE(expected->origin() == actual->origin());
+            REQUIRE(expected->extent() == actual->extent());
+        }
+    }
+}
+
+TEST_CASE("calculate all intersections of a set", "[batch_intersect][partition_tree]")
+{
+    SECTION("concentric")
+    {
+        partition_tree pt(get_concentric_rectangles(40));
+        const auto     areas = partition_tree::calculate_all(pt.intersections());
+        REQUIRE(areas.size() == pt.intersections().size());
+        std::size_t row = 0;
+        for (const auto& i : pt.intersections())
+            REQUIRE(std::is_eq(areas.rect(row++) <=> i.calculate()));
+        check_concentric_rectangles(40, pt.intersections());
+    }
+    SECTION("random")
+    {
+        std::mt19937                                gen(11);
+        std::uniform_int_distribution<coordinate_t> pos(0, 1000);
+        std::uniform_int_distribution<coordinate_t> len(1, 200);
+        rectangles_list                             rects;
+        for (std::size_t id = 1; id <= 200; ++id)
+            rects.push_back(rectangle { { pos(gen), pos(gen) }, { len(gen), len(gen) }, id });
+        sweep_line sl(std::move(rects));
+        const auto areas = partition_tree::calculate_all(sl.intersections());
+        REQUIRE(areas.size() == sl.intersections().size());
+        std::size_t row = 0;
+        for (const auto& i : sl.intersections())
+            REQUIRE(std::is_eq(areas.rect(row++) <=> i.calculate()));
+    }
+}
@@ -0,0 +1,181 @@
+#include <catch2/catch.hpp>
+
+#include "test_utils.hpp"
+
+#include <nitro/binary_io.hpp>
+#include <nitro/io.hpp>
+#include <nitro/partition_tree.hpp>
+#include <nitro/rectangle_store.hpp>
+
+#include <array>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <system_error>
+
+using namespace nitro;
+
+namespace {
+// a file in the temp directory, removed when going out of scope
+struct temp_file {
+    explicit temp_file(std::string const& name)
+        : path(std::filesystem::temp_directory_path() / ("nitro_test_" + name))
+    {
+    }
+    ~temp_file() { std::filesystem::remove(path); }
+
+    void write(rectangle_store const& store) const
+    {
+        std::ofstream ofs(path, std::ios::binary);
+        write_binary_rectangles(ofs, store);
+    }
+    void write(std::string const& bytes) const
+    {
+        std::ofstream ofs(path, std::ios::binary);
+        ofs << bytes;
+    }
+    [[nodiscard]] std::string read() const
+    {
+        std::ifstream      ifs(path, std::ios::binary);
+        std::ostringstream os;
+        os << ifs.rdbuf();
+        return os.str();
+    }
+
+    std::filesystem::path path;
+};
+
+rectangle_store sample_store()
+{
+    rectangle_store store;
+    store.push_back({ 100, 100 }, { 250, 80 }, 1);
+    store.push_back({ 120, 200 }, { 250, 150 }, 2);
+    store.push_back({ -140, 160 }, { 250, 100 }, 3);
+    store.push_back({ 160, 140 }, { 350, 190 }, 4);
+    return store;
+}
+}
+
+TEST_CASE("binary rectangles round trip", "[binary_io][io]")
+{
+    const temp_file file("round_trip.bin");
+    auto            store = sample_store();
+
+    SECTION("implicit ids")
+    {
+        file.write(store);
+        REQUIRE(file.read().size() == sizeof(binary_header) + 4 * 4 * sizeof(coordinate_t));
+
+        const mapped_rectangles mapped(file.path);
+        REQUIRE(mapped.size() == 4);
+        REQUIRE_FALSE(mapped.has_ids());
+        REQUIRE(rng::equal(mapped.xs(), store.xs()));
+        REQUIRE(rng::equal(mapped.heights(), store.heights()));
+        for (std::size_t i = 0; i < store.size(); ++i)
+            REQUIRE(std::is_eq(mapped.rect(i) <=> store.rect(i)));
+
+        const auto loaded = to_rectangle_store(mapped);
+        REQUIRE(rng::equal(loaded.ids(), store.ids()));
+        REQUIRE(loaded.root(3) == 3);
+        REQUIRE(to_rectangle_store(mapped, 2).size() == 2);
+    }
+    SECTION("explicit ids")
+    {
+        store.push_back({ 0, 0 }, { 1, 1 }, 42);
+        file.write(store);
+        const mapped_rectangles mapped(file.path);
+        REQUIRE(mapped.has_ids());
+        REQUIRE(mapped.id(4) == 42);
+        REQUIRE(rng::equal(to_rectangle_store(mapped).ids(), store.ids()));
+    }
+    SECTION("moved mapping")
+    {
+        file.write(store);
+        mapped_rectangles mapped(file.path);
+        mapped_rectangles other(std::move(mapped));
+        REQUIRE(mapped.empty());
+        REQUIRE(other.size() == 4);
+        mapped = std::move(other);
+        REQUIRE(mapped.rect(2).origin() == point { -140, 160 });
+    }
+    SECTION("same intersections as the JSON input")
+    {
+        file.write(store);
+        partition_tree from_binary(to_rectangle_store(mapped_rectangles(file.path)));
+        partition_tree from_store(sample_store());
+        REQUIRE(from_binary.intersections().size() == from_store.intersections().size());
+        REQUIRE(rng::equal(from_binary.intersections(), from_store.intersections(),
+            [](auto const& lhs, auto const& rhs) {
+                return std::is_eq(lhs.calculate() <=> rhs.calculate());
+            }));
+    }
+}
+
+TEST_CASE("binary rectangles format detection", "[binary_io][io]")
+{
+    std::stringstream binary;
+    write_binary_rectangles(binary, sample_store());
+    REQUIRE(is_binary_rectangles(binary));
+    REQUIRE(binary.tellg() == 0);
+
+    std::istringstream json(R"-({"rects": []})-");
+    REQUIRE_FALSE(is_binary_rectangles(json));
+    REQUIRE(read_rectangle_store(json).empty());
+
+    std::istringstream tiny("{}");
+    REQUIRE_FALSE(is_binary_rectangles(tiny));
+}
+
+TEST_CASE("malformed binary rectangles", "[binary_io][io]")
+{
+    const temp_file   file("malformed.bin");
+    std::stringstream os;
+    write_binary_rectangles(os, sample_store());
+    const auto bytes = os.str();
+
+    SECTION("truncated")
+    {
+        file.write(bytes.substr(0, bytes.size() - 1));
+        REQUIRE_THROWS_AS(mapped_rectangles(file.path), invalid_arg);
+        file.write(bytes.substr(0, 10));
+        REQUIRE_THROWS_AS(mapped_rectangles(file.path), invalid_arg);
+    }
+    SECTION("wrong magic")
+    {
+        file.write("X" + bytes.substr(1));
+        REQUIRE_THROWS_AS(mapped_rectangles(file.path), invalid_arg);
+    }
+    SECTION("invalid extent")
+    {
+        auto patched = bytes;
+        // first height, the fourth column
+        const coordinate_t zero = 0;
+        patched.replace(sizeof(binary_header) + 3 * 4 * sizeof(coordinate_t), sizeof(zero),
+            reinterpret_cast<char const*>(&zero), sizeof(zero));
+        file.write(patched);
+        REQUIRE_THROWS_AS(mapped_rectangles(file.path), invalid_arg);
+    }
+    SECTION("invalid ids")
+    {
+        const auto with_ids = [](std::initializer_list<std::size_t> ids) {
+            rectangle_store store;
+            for (const auto id : ids)
+                store.push_back({ 0, 0 }, { 10, 10 }, id);
+            std::stringstream os;
+            write_binary_rectangles(os, store);
+            return os.str();
+        };
+        for (const auto& ids : { with_ids({ 7, 3, 7 }), with_ids({ 3, 7, 7 }),
+                 with_ids({ 0, 5, 9 }), with_ids({ 5, 0 }) }) {
+            file.write(ids);
+            REQUIRE_THROWS_AS(mapped_rectangles(file.path), invalid_arg);
+        }
+        file.write(with_ids({ 9, 4, 6 }));
+        REQUIRE(mapped_rectangles(file.path).id(0) == 9);
+    }
+    SECTION("missing file")
+    {
+        REQUIRE_THROWS_AS(mapped_rectangles(file.path), std::system_error);
+    }
+}
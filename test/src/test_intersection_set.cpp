@@ -0,0 +1,115 @@
+#include <catch2/catch.hpp>
+
+#include "test_utils.hpp"
+
+#include <nitro/exceptions.hpp>
+#include <nitro/intersection_set.hpp>
+#include <nitro/rectangle.hpp>
+
+#include <vector>
+
+using namespace nitro;
+
+namespace {
+using index = intersection_set::index_t;
+
+auto id_sets(intersection_set const& set)
+{
+    std::vector<std::vector<std::size_t>> out;
+    for (const auto& i : set) {
+        auto& ids = out.emplace_back();
+        rng::transform(i.constituents(), std::back_inserter(ids), [](auto p) { return p->id(); });
+    }
+    return out;
+}
+}
+
+TEST_CASE("intersection set runs", "[intersection_set][intersection]")
+{
+    // ids in reverse to the root indices
+    std::vector<rectangle> rects;
+    for (coordinate_t i = 0; i < 40; ++i)
+        rects.emplace_back(point { i, i }, point { 100, 100 }, id(40 - i));
+    std::vector<rect_ptr> roots;
+    rng::copy(rects | views::transform(address_of_f {}), std::back_inserter(roots));
+    intersection_set      set(roots);
+    REQUIRE(set.empty());
+
+    SECTION("members are kept sorted by id")
+    {
+        std::vector<index> members { 3, 0, 5, 3 };
+        REQUIRE(set.insert(members));
+        REQUIRE(set.size() == 1);
+        REQUIRE(rng::equal(set.at(0).members(), std::vector<index> { 5, 3, 0 }));
+        REQUIRE(id_sets(set) == std::vector<std::vector<std::size_t>> { { 35, 37, 40 } });
+    }
+    SECTION("duplicates are dropped")
+    {
+        std::vector<index> first { 1, 2 }, same { 2, 1 }, other { 1, 3 };
+        REQUIRE(set.insert(first));
+        REQUIRE_FALSE(set.insert(same));
+        REQUIRE(set.insert(other));
+        REQUIRE(set.size() == 2);
+    }
+    SECTION("a single rectangle is no intersection")
+    {
+        std::vector<index> members { 4, 4 };
+        REQUIRE_THROWS_AS(set.insert(members), invalid_arg);
+        REQUIRE(set.empty());
+    }
+    SECTION("lookup by hash")
+    {
+        std::vector<index> members { 7, 9 };
+        set.insert(members);
+        const auto hash = intersection_set::id_key(33) + intersection_set::id_key(31);
+        std::size_t compared {};
+        REQUIRE(set.contains(hash, [&](auto const& i) {
+            ++compared;
+            return rng::equal(i.members(), std::vector<index> { 9, 7 });
+        }));
+        REQUIRE(compared == 1);
+        REQUIRE_FALSE(set.contains(hash + 1, [](auto const&) { return true; }));
+    }
+    SECTION("sorted by size, then by ids")
+    {
+        std::vector<std::vector<index>> runs { { 1, 2, 3 }, { 39, 38 }, { 0, 1 }, { 5, 6, 7, 8 },
+            { 4, 5, 6 } };
+        for (auto& r : runs)
+            set.insert(r);
+        set.sort();
+        REQUIRE(id_sets(set)
+            == std::vector<std::vector<std::size_t>> {
+                { 1, 2 }, { 39, 40 }, { 34, 35, 36 }, { 37, 38, 39 }, { 32, 33, 34, 35 } });
+        REQUIRE(rng::is_sorted(set, std::less<> {}));
+        REQUIRE(set.rbegin()->constituents().size() == 4);
+    }
+    SECTION("growing the index keeps every run")
+    {
+        for (index i = 0; i < 39; ++i) {
+            for (index j = i + 1; j < 40; ++j) {
+                std::vector<index> members { i, j };
+                REQUIRE(set.insert(members));
+            }
+        }
+        REQUIRE(set.size() == 40 * 39 / 2);
+        std::vector<index> members { 21, 12 };
+        REQUIRE_FALSE(set.insert(members));
+        REQUIRE(set.memory_usage() >= set.size() * 2 * sizeof(index));
+    }
+    SECTION("merge and copy")
+    {
+        intersection_set   other(roots);
+        std::vector<index> a { 1, 2 }, b { 2, 3 }, c { 1, 2 }, d { 3, 4 };
+        set.insert(a);
+        set.insert(b);
+        other.insert(c);
+        other.insert(d);
+        set.merge(other);
+        set.sort();
+        REQUIRE(set.size() == 3);
+
+        const auto copy = set;
+        REQUIRE(id_sets(copy) == id_sets(set));
+        REQUIRE((*copy.begin()).calculate().origin() == point { 4, 4 });
+    }
+}
@@ -0,0 +1,125 @@
+#include <catch2/catch.hpp>
+
+#include "test_utils.hpp"
+
+#include <nitro/memory_resource.hpp>
+#include <nitro/partition_tree.hpp>
+#include <nitro/sweep_line.hpp>
+
+#include <memory_resource>
+#include <optional>
+#include <thread>
+#include <vector>
+
+using namespace nitro;
+
+TEST_CASE("stats resource", "[memory_resource]")
+{
+    stats_resource res;
+    {
+        std::pmr::vector<int> a(100, &res);
+        std::pmr::vector<int> b(50, &res);
+        REQUIRE(res.stats().allocations == 2);
+        REQUIRE(res.stats().bytes_in_use == 150 * sizeof(int));
+    }
+    auto stats = res.stats();
+    REQUIRE(stats.deallocations == 2);
+    REQUIRE(stats.bytes_allocated == 150 * sizeof(int));
+    REQUIRE(stats.bytes_in_use == 0);
+    REQUIRE(stats.peak_bytes == 150 * sizeof(int));
+
+    res.reset();
+    std::pmr::vector<int> c(10, &res);
+    stats = res.stats();
+    REQUIRE(stats.allocations == 1);
+    REQUIRE(stats.deallocations == 0);
+    REQUIRE(stats.peak_bytes == 10 * sizeof(int));
+}
+
+TEST_CASE("thread pools", "[memory_resource]")
+{
+    stats_resource upstream;
+    {
+        thread_pools pools(&upstream);
+        const auto   mine = pools.local();
+        REQUIRE(pools.local() == mine);
+        REQUIRE(pools.for_threads(1) == mine);
+        REQUIRE(pools.for_threads(4) == pools.shared());
+
+        // the pool keeps what the vector gave back until the thread exits
+        const auto                 before = upstream.stats().bytes_in_use;
+        std::size_t                held {};
+        std::pmr::memory_resource* theirs {};
+        std::thread([&] {
+            theirs = pools.local();
+            {
+                std::pmr::vector<int> v(1000, theirs);
+            }
+            held = upstream.stats().bytes_in_use;
+            REQUIRE(pools.local() == theirs);
+        }).join();
+        REQUIRE(theirs != mine);
+        REQUIRE(held > before);
+        REQUIRE(upstream.stats().bytes_in_use == before);
+
+        // a thread outliving the thread_pools it took a pool from, and one in its place
+        std::thread([&] {
+            {
+                thread_pools          gone(&upstream);
+                std::pmr::vector<int> v(1000, gone.local());
+            }
+            thread_pools          next(&upstream);
+            std::pmr::vector<int> v(1000, next.local());
+        }).join();
+        REQUIRE(upstream.stats().bytes_in_use == before);
+
+        std::pmr::vector<int> v(1000, mine);
+        REQUIRE(upstream.stats().bytes_in_use > 0);
+    }
+    REQUIRE(upstream.stats().bytes_in_use == 0);
+}
+
+namespace {
+// anything taken from the global default resource throws while it's around
+struct no_default_resource {
+    no_default_resource()
+        : old(std::pmr::set_default_resource(std::pmr::null_memory_resource()))
+    {
+    }
+    ~no_default_resource() { std::pmr::set_default_resource(old); }
+    std::pmr::memory_resource* old;
+};
+}
+
+TEST_CASE("engines allocate from the given resource only", "[memory_resource][partition_tree]")
+{
+    stats_resource upstream;
+    thread_pools   pools(&upstream);
+    const auto     rects = get_concentric_rectangles(100);
+    // the checks calculate the intersections, which is done on the default resource
+    SECTION("serial")
+    {
+        const auto                         r = pools.local();
+        std::optional<no_default_resource> guard(std::in_place);
+        partition_tree                     pt(rectangles_list(rects, r), {}, 1, {}, r);
+        guard.reset();
+        check_concentric_rectangles(100, pt.intersections());
+    }
+    SECTION("parallel")
+    {
+        const auto                         r = pools.shared();
+        std::optional<no_default_resource> guard(std::in_place);
+        partition_tree                     pt(rectangles_list(rects, r), {}, 4, {}, r);
+        guard.reset();
+        check_concentric_rectangles(100, pt.intersections());
+    }
+    SECTION("sweep line")
+    {
+        const auto                         r = pools.local();
+        std::optional<no_default_resource> guard(std::in_place);
+        sweep_line                         sl(rectangles_list(rects, r), {}, r);
+        guard.reset();
+        check_concentric_rectangles(100, sl.intersections());
+    }
+    REQUIRE(upstream.stats().allocations > 0);
+}
@@ -17,7 +17,11 @@
 #include <nitro/partition_tree.hpp>
 
 #include <nlohmann/json.hpp>
+#include <random>
 #include <ranges>
+#include <set>
+#include <stop_token>
+#include <thread>
 
 using namespace nitro;
 
@@ -40,25 +44,21 @@ TEST_CASE("space construction", "[partition_tree]")
 
     SECTION("horizontal ordering")
     {
-        auto h  = sorted<vertical>(rect_view);
-        auto it = h.begin();
-        REQUIRE(it != h.end());
-        REQUIRE((*it++)->id() == 1);
-        REQUIRE((*it++)->id() == 2);
-        REQUIRE((*it++)->id() == 3);
-        REQUIRE((*it++)->id() == 4);
-        REQUIRE(it == h.end());
+        auto h = sorted<vertical>(rect_view);
+        REQUIRE(h.size() == 4);
+        REQUIRE(h[0].id() == 1);
+        REQUIRE(h[1].id() == 2);
+        REQUIRE(h[2].id() == 3);
+        REQUIRE(h[3].id() == 4);
     }
     SECTION("vertical ordering")
     {
-        auto v  = sorted<horizontal>(rect_view);
-        auto it = v.begin();
-        REQUIRE(it != v.end());
-        REQUIRE((*it++)->id() == 1);
-        REQUIRE((*it++)->id() == 4);
-        REQUIRE((*it++)->id() == 3);
-        REQUIRE((*it++)->id() == 2);
-        REQUIRE(it == v.end());
+        auto v = sorted<horizontal>(rect_view);
+        REQUIRE(v.size() == 4);
+        REQUIRE(v[0].id() == 1);
+        REQUIRE(v[1].id() == 4);
+        REQUIRE(v[2].id() == 3);
+        REQUIRE(v[3].id() == 2);
     }
 }
 
@@ -302,100 +302,122 @@ auto test_data()
 }
 template <typename Ord> auto sorted_test_data(Ord ord)
 {
-    auto              td = test_data();
-    sorted_rectangles sr(ordering_t { ord });
-    rng::copy(td | views::transform([](auto& r) { return std::addressof(r); }),
-        std::inserter(sr, sr.begin()));
+    auto                  td = test_data();
+    sorted_rectangles     sr(td | views::transform(address_of_f {}), ord);
     std::vector<rect_ptr> vtd;
     rng::copy(td | views::transform(address_of_f {}), std::back_inserter(vtd));
     return std::tuple { std::move(td), std::move(vtd), std::move(sr) };
 }
+// the rectangle of the test data row i of s has been sliced from
+template <typename Ordering>
+rect_ptr root(
+    std::vector<rect_ptr> const& vtd, sorted_rectangles<Ordering> const& s, std::size_t i)
+{
+    return vtd[s.rows().parent(i)];
+}
 TEST_CASE("space slicing horizontal", "[partition_tree]")
 {
     auto&& [td, vtd, sorted_td]  = sorted_test_data(vertical_sort {});
-    auto&& [rects, below, above] = partition_tree::slice(horizontal { 190 }, sorted_td);
+    auto&& [below, above]        = partition_tree::slice(horizontal { 190 }, sorted_td);
     REQUIRE(below.size() == 3);
     REQUIRE(above.size() == 3);
-    auto it = below.begin();
-    REQUIRE((*it)->id() == 1);
-    REQUIRE((*it)->origin() == point { 100, 100 });
-    REQUIRE((*it)->extent() == point { 250, 80 });
-    REQUIRE((*it)->parent() == nullptr);
+    std::size_t it = 0;
+    REQUIRE(below[it].id() == 1);
+    REQUIRE(below[it].origin() == point { 100, 100 });
+    REQUIRE(below[it].extent() == point { 250, 80 });
+    REQUIRE(root(vtd, below, it) == vtd[0]);
     ++it;
-    REQUIRE((*it)->id() == 4);
-    REQUIRE((*it)->origin() == point { 160, 140 });
-    REQUIRE((*it)->extent() == point { 350, 50 });
-    REQUIRE((*it)->parent() == vtd[3]);
+    REQUIRE(below[it].id() == 4);
+    REQUIRE(below[it].origin() == point { 160, 140 });
+    REQUIRE(below[it].extent() == point { 350, 50 });
+    REQUIRE(root(vtd, below, it) == vtd[3]);
     ++it;
-    REQUIRE((*it)->id() == 3);
-    REQUIRE((*it)->origin() == point { 140, 160 });
-    REQUIRE((*it)->extent() == point { 250, 30 });
-    REQUIRE((*it)->parent() == vtd[2]);
+    REQUIRE(below[it].id() == 3);
+    REQUIRE(below[it].origin() == point { 140, 160 });
+    REQUIRE(below[it].extent() == point { 250, 30 });
+    REQUIRE(root(vtd, below, it) == vtd[2]);
 
     ++it;
-    REQUIRE(it == below.end());
+    REQUIRE(it == below.size());
 
-    auto ait = above.begin();
-    REQUIRE((*ait)->id() == 3);
-    REQUIRE((*ait)->origin() == point { 140, 190 });
-    REQUIRE((*ait)->extent() == point { 250, 70 });
-    REQUIRE((*ait)->parent() == vtd[2]);
+    std::size_t ait = 0;
+    REQUIRE(above[ait].id() == 3);
+    REQUIRE(above[ait].origin() == point { 140, 190 });
+    REQUIRE(above[ait].extent() == point { 250, 70 });
+    REQUIRE(root(vtd, above, ait) == vtd[2]);
 
     ++ait;
-    REQUIRE((*ait)->id() == 4);
-    REQUIRE((*ait)->origin() == point { 160, 190 });
-    REQUIRE((*ait)->extent() == point { 350, 140 });
-    REQUIRE((*ait)->parent() == vtd[3]);
+    REQUIRE(above[ait].id() == 4);
+    REQUIRE(above[ait].origin() == point { 160, 190 });
+    REQUIRE(above[ait].extent() == point { 350, 140 });
+    REQUIRE(root(vtd, above, ait) == vtd[3]);
     ++ait;
-    REQUIRE((*ait)->id() == 2);
-    REQUIRE((*ait)->origin() == point { 120, 200 });
-    REQUIRE((*ait)->extent() == point { 250, 150 });
-    REQUIRE((*ait)->parent() == nullptr);
+    REQUIRE(above[ait].id() == 2);
+    REQUIRE(above[ait].origin() == point { 120, 200 });
+    REQUIRE(above[ait].extent() == point { 250, 150 });
+    REQUIRE(root(vtd, above, ait) == vtd[1]);
     ++ait;
-    REQUIRE(ait == above.end());
+    REQUIRE(ait == above.size());
 }
 
 TEST_CASE("space slicing vertical", "[partition_tree]")
 {
     auto&& [td, vtd, sorted_td]  = sorted_test_data(horizontal_sort {});
-    auto&& [rects, below, above] = partition_tree::slice(vertical { 140 }, sorted_td);
+    auto&& [below, above]        = partition_tree::slice(vertical { 140 }, sorted_td);
     REQUIRE(below.size() == 2);
     REQUIRE(above.size() == 4);
-    auto it = below.begin();
-    REQUIRE((*it)->id() == 1);
-    REQUIRE((*it)->origin() == point { 100, 100 });
-    REQUIRE((*it)->extent() == point { 40, 80 });
-    REQUIRE((*it)->parent() == vtd[0]);
+    std::size_t it = 0;
+    REQUIRE(below[it].id() == 1);
+    REQUIRE(below[it].origin() == point { 100, 100 });
+    REQUIRE(below[it].extent() == point { 40, 80 });
+    REQUIRE(root(vtd, below, it) == vtd[0]);
     ++it;
-    REQUIRE((*it)->id() == 2);
-    REQUIRE((*it)->origin() == point { 120, 200 });
-    REQUIRE((*it)->extent() == point { 20, 150 });
-    REQUIRE((*it)->parent() == vtd[1]);
+    REQUIRE(below[it].id() == 2);
+    REQUIRE(below[it].origin() == point { 120, 200 });
+    REQUIRE(below[it].extent() == point { 20, 150 });
+    REQUIRE(root(vtd, below, it) == vtd[1]);
     ++it;
-    REQUIRE(it == below.end());
+    REQUIRE(it == below.size());
 
-    auto ait = above.begin();
-    REQUIRE((*ait)->id() == 1);
-    REQUIRE((*ait)->origin() == point { 140, 100 });
-    REQUIRE((*ait)->extent() == point { 210, 80 });
-    REQUIRE((*ait)->parent() == vtd[0]);
+    std::size_t ait = 0;
+    REQUIRE(above[ait].id() == 1);
+    REQUIRE(above[ait].origin() == point { 140, 100 });
+    REQUIRE(above[ait].extent() == point { 210, 80 });
+    REQUIRE(root(vtd, above, ait) == vtd[0]);
     ++ait;
-    REQUIRE((*ait)->id() == 3);
-    REQUIRE((*ait)->origin() == point { 140, 160 });
-    REQUIRE((*ait)->extent() == point { 250, 100 });
-    REQUIRE((*ait)->parent() == nullptr);
+    REQUIRE(above[ait].id() == 3);
+    REQUIRE(above[ait].origin() == point { 140, 160 });
+    REQUIRE(above[ait].extent() == point { 250, 100 });
+    REQUIRE(root(vtd, above, ait) == vtd[2]);
     ++ait;
-    REQUIRE((*ait)->id() == 2);
-    REQUIRE((*ait)->origin() == point { 140, 200 });
-    REQUIRE((*ait)->extent() == point { 230, 150 });
-    REQUIRE((*ait)->parent() == vtd[1]);
+    REQUIRE(above[ait].id() == 2);
+    REQUIRE(above[ait].origin() == point { 140, 200 });
+    REQUIRE(above[ait].extent() == point { 230, 150 });
+    REQUIRE(root(vtd, above, ait) == vtd[1]);
     ++ait;
-    REQUIRE((*ait)->id() == 4);
-    REQUIRE((*ait)->origin() == point { 160, 140 });
-    REQUIRE((*ait)->extent() == point { 350, 190 });
-    REQUIRE((*ait)->parent() == nullptr);
+    REQUIRE(above[ait].id() == 4);
+    REQUIRE(above[ait].origin() == point { 160, 140 });
+    REQUIRE(above[ait].extent() == point { 350, 190 });
+    REQUIRE(root(vtd, above, ait) == vtd[3]);
     ++ait;
-    REQUIRE(ait == above.end());
+    REQUIRE(ait == above.size());
+}
+
+template <typename Orientation, typename Sorted>
+concept sliceable = requires(Orientation o, Sorted const& s)
+{
+    partition_tree::slice(o, s);
+};
+
+TEST_CASE("space slicing requires matching ordering", "[partition_tree]")
+{
+    STATIC_REQUIRE(sliceable<horizontal, sorted_rectangles<vertical_sort>>);
+    STATIC_REQUIRE(sliceable<vertical, sorted_rectangles<horizontal_sort>>);
+    STATIC_REQUIRE(sliceable<rev_horizontal, sorted_rectangles<rev_vertical_sort>>);
+    STATIC_REQUIRE(sliceable<rev_vertical, sorted_rectangles<rev_horizontal_sort>>);
+    STATIC_REQUIRE(!sliceable<horizontal, sorted_rectangles<horizontal_sort>>);
+    STATIC_REQUIRE(!sliceable<vertical, sorted_rectangles<rev_horizontal_sort>>);
+    STATIC_REQUIRE(!sliceable<vertical, sorted_rectangles<ordering_t>>);
 }
 
 TEST_CASE("space partitioning example", "[partition_tree]")
@@ -410,8 +432,8 @@ TEST_CASE("space partitioning example", "[partition_tree]")
         auto&      is = vi[0];
         const auto i  = is.calculate();
         REQUIRE(is.constituents().size() == 2);
-        REQUIRE(is.constituents().at(0)->id() == 1);
-        REQUIRE(is.constituents().at(1)->id() == 3);
+        REQUIRE(is.constituents()[0]->id() == 1);
+        REQUIRE(is.constituents()[1]->id() == 3);
         REQUIRE(i.origin() == point { 140, 160 });
         REQUIRE(i.extent() == point { 210, 20 });
     }
@@ -420,8 +442,8 @@ TEST_CASE("space partitioning example", "[partition_tree]")
         auto&      is = vi[1];
         const auto i  = is.calculate();
         REQUIRE(is.constituents().size() == 2);
-        REQUIRE(is.constituents().at(0)->id() == 1);
-        REQUIRE(is.constituents().at(1)->id() == 4);
+        REQUIRE(is.constituents()[0]->id() == 1);
+        REQUIRE(is.constituents()[1]->id() == 4);
         REQUIRE(i.origin() == point { 160, 140 });
         REQUIRE(i.extent() == point { 190, 40 });
     }
@@ -430,8 +452,8 @@ TEST_CASE("space partitioning example", "[partition_tree]")
         auto&      is = vi[2];
         const auto i  = is.calculate();
         REQUIRE(is.constituents().size() == 2);
-        REQUIRE(is.constituents().at(0)->id() == 2);
-        REQUIRE(is.constituents().at(1)->id() == 3);
+        REQUIRE(is.constituents()[0]->id() == 2);
+        REQUIRE(is.constituents()[1]->id() == 3);
         REQUIRE(i.origin() == point { 140, 200 });
         REQUIRE(i.extent() == point { 230, 60 });
     }
@@ -440,8 +462,8 @@ TEST_CASE("space partitioning example", "[partition_tree]")
         auto&      is = vi[3];
         const auto i  = is.calculate();
         REQUIRE(is.constituents().size() == 2);
-        REQUIRE(is.constituents().at(0)->id() == 2);
-        REQUIRE(is.constituents().at(1)->id() == 4);
+        REQUIRE(is.constituents()[0]->id() == 2);
+        REQUIRE(is.constituents()[1]->id() == 4);
         REQUIRE(i.origin() == point { 160, 200 });
         REQUIRE(i.extent() == point { 210, 130 });
     }
@@ -450,8 +472,8 @@ TEST_CASE("space partitioning example", "[partition_tree]")
         auto&      is = vi[4];
         const auto i  = is.calculate();
         REQUIRE(is.constituents().size() == 2);
-        REQUIRE(is.constituents().at(0)->id() == 3);
-        REQUIRE(is.constituents().at(1)->id() == 4);
+        REQUIRE(is.constituents()[0]->id() == 3);
+        REQUIRE(is.constituents()[1]->id() == 4);
         REQUIRE(i.origin() == point { 160, 160 });
         REQUIRE(i.extent() == point { 230, 100 });
     }
@@ -460,9 +482,9 @@ TEST_CASE("space partitioning example", "[partition_tree]")
         auto&      is = vi[5];
         const auto i  = is.calculate();
         REQUIRE(is.constituents().size() == 3);
-        REQUIRE(is.constituents().at(0)->id() == 1);
-        REQUIRE(is.constituents().at(1)->id() == 3);
-        REQUIRE(is.constituents().at(2)->id() == 4);
+        REQUIRE(is.constituents()[0]->id() == 1);
+        REQUIRE(is.constituents()[1]->id() == 3);
+        REQUIRE(is.constituents()[2]->id() == 4);
         REQUIRE(i.origin() == point { 160, 160 });
         REQUIRE(i.extent() == point { 190, 20 });
     }
@@ -471,47 +493,14 @@ TEST_CASE("space partitioning example", "[partition_tree]")
         auto&      is = vi[6];
         const auto i  = is.calculate();
         REQUIRE(is.constituents().size() == 3);
-        REQUIRE(is.constituents().at(0)->id() == 2);
-        REQUIRE(is.constituents().at(1)->id() == 3);
-        REQUIRE(is.constituents().at(2)->id() == 4);
+        REQUIRE(is.constituents()[0]->id() == 2);
+        REQUIRE(is.constituents()[1]->id() == 3);
+        REQUIRE(is.constituents()[2]->id() == 4);
         REQUIRE(i.origin() == point { 160, 200 });
         REQUIRE(i.extent() == point { 210, 60 });
     }
 }
 
-auto get_concentric_rectangles(coordinate_t count)
-{
-
-    nitro::rectangles_list rects;
-    std::generate_n(
-        std::front_inserter(rects), count, [id = 1, x = 0, y = 2 * count - 1]() mutable {
-            auto r = rectangle { { x, x }, { y, y },
-                rectangle::identifier_t(static_cast<size_t>(id++)) };
-            x += 1;
-            y -= 2;
-            return r;
-        });
-    return rects;
-}
-void check_concentric_rectangles(coordinate_t count, partition_tree::intersection_set const& isecs)
-{
-    coordinate_t extent = 0;
-    REQUIRE(isecs.size() == count - 1);
-
-    for (auto it = isecs.rbegin(); it != isecs.rend(); ++it, --count) {
-        REQUIRE(it->constituents().size() == count);
-        auto rid = 1;
-        for (auto& r : it->constituents()) {
-            REQUIRE(r->id() == rid);
-            rid++;
-        }
-        const auto rintersection = it->calculate();
-        REQUIRE(rintersection.origin() == point { count - 1, count - 1 });
-        REQUIRE(rintersection.extent() == point { 2 * extent + 1, 2 * extent + 1 });
-        ++extent;
-    }
-}
-
 TEST_CASE("space partitioning   concentrical rectangles", "[partition_tree]")
 {
     auto old_resource = std::pmr::get_default_resource();
@@ -562,6 +551,17 @@ TEST_CASE("space partitioning   concentrical rectangles", "[partition_tree]")
         REQUIRE(pt.intersections().begin()->calculate().origin() == point { 100, 100 });
         REQUIRE(pt.intersections().begin()->calculate().extent() == point { 100, 100 });
     }
+    SECTION("extents whose areas overflow 64 bits")
+    {
+        // 2^32 * (2^32 + 1) wraps to the area of 2^16 * 2^16
+        constexpr coordinate_t big = coordinate_t { 1 } << 32;
+        rectangles_list        rects { rectangle { { 0, 0 }, { big + 1, big + 2 }, id(1) },
+            rectangle { { 0, 0 }, { big, big + 1 }, id(2) },
+            rectangle { { 0, 0 }, { 1 << 16, 1 << 16 }, id(3) } };
+        for (coordinate_t extent = 40; extent > 0; --extent)
+            rects.push_back(rectangle { { 0, 0 }, { extent, extent }, id(rects.size() + 1) });
+        REQUIRE(found_id_sets(partition_tree(rects).intersections()) == brute_force_id_sets(rects));
+    }
     std::pmr::set_default_resource(old_resource);
 }
 
@@ -589,9 +589,349 @@ TEST_CASE("space partitioning   concentrical rectangles many", "[partition_tree]
         partition_tree pt(std::move(l));
         check_concentric_rectangles(1000, pt.intersections());
     }
+    SECTION("1000 rects parallel")
+    {
+        auto           l = get_concentric_rectangles(1000);
+        partition_tree pt(std::move(l), {}, std::thread::hardware_concurrency());
+        check_concentric_rectangles(1000, pt.intersections());
+    }
     std::pmr::set_default_resource(old_resource);
 }
 
+TEST_CASE("space partitioning random input", "[partition_tree]")
+{
+    using nr = nitro::rectangle;
+    SECTION("equal rectangles shifted against each other")
+    {
+        const rectangles_list rects { nr { { 0, 0 }, { 10, 10 }, id(1) },
+            nr { { 5, 0 }, { 10, 10 }, id(2) }, nr { { 0, 5 }, { 10, 10 }, id(3) } };
+        REQUIRE(found_id_sets(partition_tree(rects).intersections()) == brute_force_id_sets(rects));
+    }
+    SECTION("more rectangles than are read off without slicing")
+    {
+        for (unsigned seed = 1; seed <= 10; ++seed) {
+            const auto rects = random_rectangles(200, 1000, seed);
+            INFO("seed " << seed);
+            REQUIRE(found_id_sets(partition_tree(rects).intersections())
+                == brute_force_id_sets(rects));
+        }
+    }
+}
+
+TEST_CASE("space partitioning parallel", "[partition_tree][parallel]")
+{
+    auto old_resource = std::pmr::get_default_resource();
+    auto pool         = get_default_memory_resource(old_resource);
+    std::pmr::set_default_resource(&pool);
+
+    SECTION("example")
+    {
+        partition_tree serial(test_data());
+        partition_tree parallel(test_data(), {}, 4);
+        REQUIRE(parallel.intersections().size() == serial.intersections().size());
+        REQUIRE(rng::equal(parallel.intersections(), serial.intersections(),
+            [](auto const& lhs, auto const& rhs) { return !(lhs < rhs) && !(rhs < lhs); }));
+    }
+    SECTION("same intersections as the serial build")
+    {
+        // the threads race for the subtrees, none of which may be lost or found twice
+        rectangles_list grid;
+        for (coordinate_t i = 0; i < 40; ++i)
+            for (coordinate_t j = 0; j < 40; ++j)
+                grid.emplace_back(point { 3 * i, 3 * j }, point { 4, 4 }, id(40 * i + j + 1));
+        std::vector inputs { grid };
+        for (unsigned seed = 1; seed <= 5; ++seed)
+            inputs.push_back(random_rectangles(300, 1000, seed));
+        for (const auto& rects : inputs) {
+            partition_tree serial(rects);
+            const auto     expected = found_id_sets(serial.intersections());
+            for (unsigned threads : { 2u, 4u }) {
+                partition_tree parallel(rects, {}, threads);
+                INFO(threads << " threads");
+                REQUIRE(parallel.intersections().size() == serial.intersections().size());
+                REQUIRE(found_id_sets(parallel.intersections()) == expected);
+            }
+        }
+    }
+    SECTION("200 rects")
+    {
+        partition_tree pt(get_concentric_rectangles(200), {}, 4);
+        check_concentric_rectangles(200, pt.intersections());
+    }
+    SECTION("timeout is propagated")
+    {
+        REQUIRE_THROWS_AS(
+            partition_tree(get_concentric_rectangles(200), partition_tree::secs { 0 }, 4),
+            nitro::timeout);
+    }
+    std::pmr::set_default_resource(old_resource);
+}
+
+TEST_CASE("space partitioning progress", "[partition_tree][parallel]")
+{
+    // a grid of rectangles overlapping their neighbours, which splits into many subtrees
+    rectangles_list grid;
+    for (coordinate_t i = 0; i < 256; ++i)
+        for (coordinate_t j = 0; j < 256; ++j)
+            grid.emplace_back(point { 3 * i, 3 * j }, point { 4, 4 }, id(256 * i + j + 1));
+
+    std::vector<partition_tree::progress> serial_calls, parallel_calls;
+    partition_tree serial(grid, {}, 1, [&](auto const& p) { serial_calls.push_back(p); });
+    REQUIRE_FALSE(serial_calls.empty());
+    for (std::size_t i = 0; i < serial_calls.size(); ++i)
+        REQUIRE(serial_calls[i].subtrees == (i + 1) * partition_tree::progress_interval);
+
+    // every subtree is counted once, whichever thread builds it
+    partition_tree parallel(grid, {}, 4, [&](auto const& p) { parallel_calls.push_back(p); });
+    REQUIRE(parallel.intersections().size() == serial.intersections().size());
+    REQUIRE(parallel_calls.size() == serial_calls.size());
+    REQUIRE(rng::all_of(parallel_calls,
+        [](auto const& p) { return p.subtrees % partition_tree::progress_interval == 0; }));
+}
+
+TEST_CASE("space partitioning cancellation", "[partition_tree][parallel]")
+{
+    rectangles_list grid;
+    for (coordinate_t i = 0; i < 256; ++i)
+        for (coordinate_t j = 0; j < 256; ++j)
+            grid.emplace_back(point { 3 * i, 3 * j }, point { 4, 4 }, id(256 * i + j + 1));
+
+    std::stop_source stop;
+    SECTION("stop requested up front")
+    {
+        stop.request_stop();
+        REQUIRE_THROWS_AS(
+            partition_tree(grid, {}, 1, {}, std::pmr::get_default_resource(), stop.get_token()),
+            nitro::cancelled);
+    }
+    // the build stops within a few subtrees of the request, on every thread
+    for (std::size_t threads : { 1, 4 }) {
+        DYNAMIC_SECTION("stop requested while building on " << threads << " threads")
+        {
+            std::size_t calls {};
+            const auto  on_progress = [&](auto const&) {
+                ++calls;
+                stop.request_stop();
+            };
+            REQUIRE_THROWS_AS(partition_tree(grid, {}, threads, on_progress,
+                                  std::pmr::get_default_resource(), stop.get_token()),
+                nitro::cancelled);
+            REQUIRE(calls == 1);
+        }
+    }
+}
+
+TEST_CASE("space partitioning partial results", "[partition_tree][parallel]")
+{
+    rectangles_list grid;
+    for (coordinate_t i = 0; i < 256; ++i)
+        for (coordinate_t j = 0; j < 256; ++j)
+            grid.emplace_back(point { 3 * i, 3 * j }, point { 4, 4 }, id(256 * i + j + 1));
+    const auto     keep = partition_tree::on_deadline::keep_partial;
+    const auto     pmr  = std::pmr::get_default_resource();
+    partition_tree full(grid, {}, 1, {}, pmr, {}, keep);
+    REQUIRE(full.complete());
+    REQUIRE(full.unexplored().empty());
+
+    std::stop_source stop;
+    SECTION("stop requested up front leaves everything unexplored")
+    {
+        stop.request_stop();
+        partition_tree pt(grid, {}, 1, {}, pmr, stop.get_token(), keep);
+        REQUIRE_FALSE(pt.complete());
+        REQUIRE(pt.intersections().empty());
+        REQUIRE(pt.unexplored().size() == 1);
+        REQUIRE(pt.unexplored()[0].rects == grid.size());
+        REQUIRE(pt.unexplored()[0].bounds.origin() == point { 0, 0 });
+        REQUIRE(pt.unexplored()[0].bounds.extent() == point { 769, 769 });
+    }
+    for (std::size_t threads : { 1, 4 }) {
+        DYNAMIC_SECTION("stop requested while building on " << threads << " threads")
+        {
+            const auto on_progress = [&](auto const&) { stop.request_stop(); };
+            partition_tree pt(grid, {}, threads, on_progress, pmr, stop.get_token(), keep);
+            REQUIRE_FALSE(pt.complete());
+            REQUIRE_FALSE(pt.intersections().empty());
+            REQUIRE(pt.intersections().size() < full.intersections().size());
+            // what was found is found for good
+            const auto ids = [](auto const& isecs) {
+                std::set<std::vector<std::size_t>> out;
+                for (const auto& i : isecs) {
+                    std::vector<std::size_t> members;
+                    rng::transform(i.constituents(), std::back_inserter(members),
+                        [](auto p) { return p->id(); });
+                    out.insert(std::move(members));
+                }
+                return out;
+            };
+            REQUIRE(rng::includes(ids(full.intersections()), ids(pt.intersections())));
+        }
+    }
+}
+
+TEST_CASE("intersection stream", "[partition_tree][intersection_stream]")
+{
+    static_assert(rng::input_range<intersection_stream>);
+    const auto ids_of = [](intersection const& i) {
+        std::vector<std::size_t> ids;
+        rng::transform(i.constituents(), std::back_inserter(ids), [](auto p) { return p->id(); });
+        return ids;
+    };
+
+    SECTION("the intersections of the tree, each once, with their areas")
+    {
+        rectangles_list grid;
+        for (coordinate_t i = 0; i < 32; ++i)
+            for (coordinate_t j = 0; j < 32; ++j)
+                grid.emplace_back(point { 3 * i, 5 * j }, point { 4, 7 }, id(32 * i + j + 1));
+        const partition_tree               pt(grid);
+        std::set<std::vector<std::size_t>> expected;
+        for (const auto& i : pt.intersections())
+            expected.insert(ids_of(i));
+
+        intersection_stream                stream(rectangle_store { grid });
+        std::set<std::vector<std::size_t>> streamed;
+        for (const auto& [isec, area] : stream) {
+            REQUIRE(streamed.insert(ids_of(isec)).second);
+            const auto calculated = isec.calculate();
+            REQUIRE(area.origin() == calculated.origin());
+            REQUIRE(area.extent() == calculated.extent());
+        }
+        REQUIRE(streamed == expected);
+    }
+    SECTION("stopping early")
+    {
+        intersection_stream stream(get_concentric_rectangles(1000));
+        std::size_t         pulled {};
+        for (const auto& found : stream | views::take(5)) {
+            REQUIRE(found.isec.members().size() >= 2);
+            ++pulled;
+        }
+        REQUIRE(pulled == 5);
+    }
+    SECTION("nothing to find")
+    {
+        intersection_stream stream(rectangles_list {});
+        REQUIRE(stream.begin() == stream.end());
+    }
+}
+
+TEST_CASE("space partitioning incremental updates", "[partition_tree]")
+{
+    // the ids of the intersections in the order of the set
+    const auto ids_of = [](partition_tree const& pt) {
+        std::vector<std::vector<std::size_t>> out;
+        for (const auto& i : pt.intersections()) {
+            auto& ids = out.emplace_back();
+            rng::transform(
+                i.constituents(), std::back_inserter(ids), [](auto p) { return p->id(); });
+        }
+        return out;
+    };
+    std::mt19937                                gen(5);
+    std::uniform_int_distribution<coordinate_t> pos(0, 300), len(1, 120);
+    rectangles_list                             all;
+    for (std::size_t i = 1; i <= 160; ++i)
+        all.emplace_back(point { pos(gen), pos(gen) }, point { len(gen), len(gen) }, id(i));
+
+    // the first 100 to start with, the others inserted one by one, some of them erased again
+    rectangles_list initial;
+    for (std::size_t i = 0; i < 100; ++i)
+        initial.push_back(all[i]);
+    partition_tree         pt(initial);
+    std::vector<rectangle> current(initial.begin(), initial.end());
+    const auto             rebuilt = [&] {
+        rectangles_list lst;
+        for (const auto& r : current)
+            lst.push_back(r);
+        return partition_tree(lst);
+    };
+    std::size_t next = 100;
+    for (int step = 0; step < 80; ++step) {
+        if (next < all.size() && (step % 3 != 2 || current.empty())) {
+            pt.insert(all[next]);
+            current.push_back(all[next++]);
+        } else {
+            std::uniform_int_distribution<std::size_t> pick(0, current.size() - 1);
+            const auto                                 at = current.begin()
+                + static_cast<std::ptrdiff_t>(pick(gen));
+            REQUIRE(pt.erase(at->id()));
+            current.erase(at);
+        }
+        INFO("step " << step);
+        REQUIRE(ids_of(pt) == ids_of(rebuilt()));
+    }
+    for (const auto& i : pt.intersections())
+        REQUIRE(i.calculate().width() > 0);
+
+    REQUIRE_THROWS_AS(pt.insert(current.front()), invalid_arg);
+    REQUIRE_FALSE(pt.erase(1000));
+    while (!current.empty()) {
+        REQUIRE(pt.erase(current.back().id()));
+        current.pop_back();
+    }
+    REQUIRE(pt.intersections().empty());
+    pt.insert(rectangle { { 0, 0 }, { 2, 2 }, id(1) });
+    pt.insert(rectangle { { 1, 1 }, { 2, 2 }, id(2) });
+    REQUIRE(ids_of(pt) == std::vector<std::vector<std::size_t>> { { 1, 2 } });
+}
+
+TEST_CASE("space partitioning stats", "[partition_tree][stats]")
+{
+    // concentric rectangles are read off as a whole, a grid has to be sliced first
+    rectangles_list grid;
+    for (coordinate_t i = 0; i < 64; ++i)
+        for (coordinate_t j = 0; j < 64; ++j)
+            grid.emplace_back(point { 3 * i, 3 * j }, point { 4, 4 }, id(64 * i + j + 1));
+    partition_tree pt(grid);
+    const auto&    stats = pt.stats();
+    REQUIRE(stats.build_time > std::chrono::nanoseconds::zero());
+    if constexpr (stats_enabled) {
+        // every subtree is either read off, sliced or too small to split, and it turns when its
+        // slice leaves nothing below
+        REQUIRE(stats.subtrees >= stats.read_off + stats.slices);
+        REQUIRE(stats.orientation_changes <= stats.slices);
+        REQUIRE(stats.slices > 0);
+        REQUIRE(stats.rows_sliced >= 2 * stats.slices);
+        REQUIRE(stats.read_off > 0);
+        REQUIRE(stats.max_pending > 0);
+        REQUIRE(stats.max_pending <= partition_tree::max_pending_subtrees);
+        REQUIRE(stats.bytes_allocated >= stats.peak_bytes);
+        REQUIRE(stats.peak_bytes > 0);
+
+        // rectangles stepping along the diagonal, a deep partition of many slices
+        rectangles_list stairs;
+        for (coordinate_t i = 0; i < 200; ++i)
+            stairs.emplace_back(point { i, i }, point { 200, 200 }, id(i + 1));
+        const partition_tree deep(stairs);
+        REQUIRE(deep.stats().slices > 1000);
+        REQUIRE(deep.stats().max_pending <= partition_tree::max_pending_subtrees);
+
+        partition_tree parallel(get_concentric_rectangles(100), {}, 4);
+        REQUIRE(parallel.stats().subtrees > 0);
+        REQUIRE(parallel.stats().bytes_allocated > 0);
+    } else {
+        REQUIRE(stats.subtrees == 0);
+    }
+    const nlohmann::json j = stats;
+    REQUIRE(j["slices"] == stats.slices);
+    REQUIRE(j["build_seconds"].get<double>() > 0);
+}
+
+TEST_CASE("phase times", "[stats]")
+{
+    phase_times times;
+    REQUIRE(times.time("first", [] { return 42; }) == 42);
+    times.time("second", [] {});
+    REQUIRE_THROWS_AS(times.time("first", [] { throw invalid_arg("failed"); }), invalid_arg);
+    REQUIRE(times.phases.size() == 2);
+    REQUIRE(times.phases[0].first == "first");
+    REQUIRE(times.phases[1].first == "second");
+    const nlohmann::json j = times;
+    REQUIRE(j.size() == 2);
+    REQUIRE(j["first"].get<double>() >= 0);
+}
+
 TEST_CASE("rectangle set aligned", "[basic][rectangle]")
 {
     using nr = nitro::rectangle;
@@ -608,7 +948,7 @@ TEST_CASE("rectangle set aligned", "[basic][rectangle]")
         auto       s = sorted<o>(v);
         const auto p = pt::split_point<o>(s);
         REQUIRE(p == 200);
-        auto [rects, below, above] = pt::slice(o { p }, s);
+        auto [below, above] = pt::slice(o { p }, s);
 
         auto rv_below = rect_vec(below);
         auto rv_above = rect_vec(above);
@@ -624,7 +964,7 @@ TEST_CASE("rectangle set aligned", "[basic][rectangle]")
         auto       s = sorted<o>(v);
         const auto p = pt::split_point<o>(s);
         REQUIRE(p == 160);
-        auto [rects, below, above] = pt::slice(o { p }, s);
+        auto [below, above] = pt::slice(o { p }, s);
 
         auto rv_below = rect_vec(below);
         auto rv_above = rect_vec(above);
@@ -645,7 +985,7 @@ TEST_CASE("rectangle set aligned", "[basic][rectangle]")
         REQUIRE(std::is_eq(sp[2] <=> r2));
         const auto p = pt::split_point<o>(s);
         REQUIRE(p == (r2.origin().y + r2.height()));
-        auto [rects, below, above] = pt::slice(o { p }, s);
+        auto [below, above] = pt::slice(o { p }, s);
 
         auto rv_below = rect_vec(below);
         auto rv_above = rect_vec(above);
@@ -670,7 +1010,7 @@ TEST_CASE("rectangle set aligned", "[basic][rectangle]")
         auto       s = sorted<o>(v);
         const auto p = pt::split_point<o>(s);
         REQUIRE(p == 370);
-        auto [rects, below, above] = pt::slice(o { p }, s);
+        auto [below, above] = pt::slice(o { p }, s);
         REQUIRE(below.empty());
         auto rv_above = rect_vec(above);
         REQUIRE(rv_above.size() == 3);
@@ -696,7 +1036,7 @@ TEST_CASE("rectangle set aligned rotated", "[basic][rectangle]")
         auto       s = sorted<o>(v);
         const auto p = pt::split_point<o>(s);
         REQUIRE(p == 160);
-        auto [rects, below, above] = pt::slice(o { p }, s);
+        auto [below, above] = pt::slice(o { p }, s);
         REQUIRE(below.empty());
         auto rv_above = rect_vec(above);
         REQUIRE(rv_above.size() == 3);
@@ -710,7 +1050,7 @@ TEST_CASE("rectangle set aligned rotated", "[basic][rectangle]")
         auto       s = sorted<o>(v);
         const auto p = pt::split_point<o>(s);
         REQUIRE(p == 220);
-        auto [rects, below, above] = pt::slice(o { p }, s);
+        auto [below, above] = pt::slice(o { p }, s);
         auto rv_below              = rect_vec(below);
         auto rv_above              = rect_vec(above);
         REQUIRE(rv_below.size() == 2);
@@ -732,19 +1072,20 @@ TEST_CASE("rectangle set aligned rotated", "[basic][rectangle]")
 
 TEST_CASE("intersection creation", "[partition_tree][intersection]")
 {
-    using ints = nitro::partition_tree::intersection;
-
-    using nr = nitro::rectangle;
+    using nr    = nitro::rectangle;
+    using index = nitro::intersection_set::index_t;
 
     nr r1 { { 160, 200 }, { 210, 150 }, id(1) };
     nr r2 { { 160, 200 }, { 210, 60 }, id(2) };
     nr r3 { { 160, 200 }, { 210, 130 }, id(3) };
 
-    using pt = nitro::partition_tree;
+    std::vector<nitro::rect_ptr> roots { &r1, &r2, &r3 };
+    nitro::intersection_set      set(roots);
     SECTION("intersection is an ordered set")
     {
-        std::vector is { &r2, &r3, &r3, &r1, &r1 };
-        ints        i1(is);
+        std::vector<index> is { 1, 2, 2, 0, 0 };
+        REQUIRE(set.insert(is));
+        const auto i1 = *set.begin();
         REQUIRE(i1.constituents().size() == 3);
         REQUIRE(i1.constituents()[0]->id() == 1);
         REQUIRE(i1.constituents()[1]->id() == 2);
@@ -753,15 +1094,15 @@ TEST_CASE("intersection creation", "[partition_tree][intersection]")
         {
             SECTION("equivalent")
             {
-                std::vector is_eq { &r3, &r2, &r3, &r3, &r1, &r1 };
-                ints        i2(is_eq);
-                REQUIRE_FALSE(i2 < i1);
-                REQUIRE_FALSE(i1 < i2);
+                std::vector<index> is_eq { 2, 1, 2, 2, 0, 0 };
+                REQUIRE_FALSE(set.insert(is_eq));
+                REQUIRE(set.size() == 1);
             }
             SECTION("less or greater")
             {
-                std::vector less { &r3, &r2 };
-                ints        i2(less);
+                std::vector<index> less { 2, 1 };
+                REQUIRE(set.insert(less));
+                const auto i2 = set.at(1);
                 REQUIRE(i2 < i1);
                 REQUIRE_FALSE(i1 < i2);
             }
@@ -784,7 +1125,7 @@ TEST_CASE("error from 1000 concentric", "[partition_tree][edge_case]")
         auto       s = sorted<o>(v);
         const auto p = pt::split_point<o>(s);
         REQUIRE(p == 3);
-        auto [rects, below, above] = pt::slice(o { p }, s);
+        auto [below, above] = pt::slice(o { p }, s);
         REQUIRE(below.size() == 1);
         REQUIRE(above.size() == 2);
         auto rv_below = rect_vec(below);
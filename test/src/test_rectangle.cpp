@@ -6,7 +6,9 @@
 
 #include <nitro/io.hpp>
 #include <nitro/rectangle.hpp>
+#include <nitro/rectangle_store.hpp>
 
+#include <string_view>
 #include <type_traits>
 
 TEST_CASE("test rectangle api", "[geometry][basic]")
@@ -93,6 +95,20 @@ TEST_CASE("full input parsing", "[io][basic]")
     REQUIRE(rects[1].parent() == nullptr);
 }
 
+TEST_CASE("full input parsing keeps every rectangle unless capped", "[io][basic]")
+{
+    nlohmann::json rect_json;
+    for (int i = 0; i < 1500; ++i)
+        rect_json["rects"].push_back({ { "x", i }, { "y", i }, { "w", 2 }, { "h", 2 } });
+    const auto text = rect_json.dump();
+
+    REQUIRE(nitro::to_rectangles(rect_json).size() == 1500);
+    REQUIRE(nitro::to_rectangle_store(rect_json).size() == 1500);
+    REQUIRE(nitro::read_rectangle_store(std::string_view(text)).size() == 1500);
+    REQUIRE(nitro::to_rectangles(rect_json, 1000).size() == 1000);
+    REQUIRE(nitro::read_rectangle_store(std::string_view(text), 1000).size() == 1000);
+}
+
 TEST_CASE("full input parsing invalid input", "[io][basic]")
 {
     const auto rect_json = R"-({})-"_json;
@@ -175,19 +191,63 @@ TEST_CASE("rectangle set", "[basic][rectangle]")
     auto s = nitro::sorted<nitro::vertical>(v);
     REQUIRE(s.size() == 5);
 
-    std::vector<nitro::rect_ptr> lower(s.begin(), s.lower_bound(101));
-    std::vector<nitro::rect_ptr> at(s.lower_bound(101), s.upper_bound(101));
-    std::vector<nitro::rect_ptr> upper(s.upper_bound(101), s.end());
-    REQUIRE(lower.size() == 2);
-    REQUIRE(lower[0]->id() == 1);
-    REQUIRE(lower[1]->id() == 4);
-    REQUIRE(at.size() == 1);
-    REQUIRE(at[0]->id() == 101);
-    REQUIRE(upper.size() == 2);
-    REQUIRE(upper[0]->id() == 3);
-    REQUIRE(upper[1]->id() == 2);
-    REQUIRE(s.find(&r_notinset) == s.end());
-    REQUIRE((*s.find(&r101_copy))->id() == 101);
+    REQUIRE(s.lower_bound(101) == 2);
+    REQUIRE(s.upper_bound(101) == 3);
+    auto rows = rect_vec(s);
+    REQUIRE(rows[0].id() == 1);
+    REQUIRE(rows[1].id() == 4);
+    REQUIRE(rows[2].id() == 101);
+    REQUIRE(rows[3].id() == 3);
+    REQUIRE(rows[4].id() == 2);
+    // the roots are the positions in v, the duplicate of r2 is dropped
+    REQUIRE(s.rows().parent(4) == 1);
+
+    nitro::rectangle_store more;
+    more.push_back(r101_copy);
+    more.push_back(r_notinset);
+    s.merge(std::move(more));
+    REQUIRE(s.size() == 6);
+    REQUIRE(s[3].id() == 102);
+}
+
+TEST_CASE("rectangle set bulk operations", "[basic][rectangle]")
+{
+    using nr = nitro::rectangle;
+
+    nr r1 { { 100, 200 }, { 10, 20 }, id(1) };
+    nr r2 { { 102, 201 }, { 10, 20 }, id(2) };
+    nr r3 { { 102, 200 }, { 10, 20 }, id(3) };
+    nr r4 { { 100, 200 }, { 10, 20 }, id(4) };
+    nr r5 { { 101, 200 }, { 10, 20 }, id(5) };
+
+    std::vector v { &r3, &r1 };
+    auto        s    = nitro::sorted<nitro::vertical>(v);
+    auto        rows = [](auto const&... rs) {
+        nitro::rectangle_store store;
+        (store.push_back(*rs), ...);
+        return store;
+    };
+    SECTION("merging keeps the set ordered and unique")
+    {
+        s.merge(rows(&r2, &r5, &r1, &r4, &r2));
+        REQUIRE(s.size() == 5);
+        auto ids = rect_vec(s);
+        REQUIRE(ids[0].id() == 1);
+        REQUIRE(ids[1].id() == 4);
+        REQUIRE(ids[2].id() == 5);
+        REQUIRE(ids[3].id() == 3);
+        REQUIRE(ids[4].id() == 2);
+    }
+    SECTION("tail keeps the ordering")
+    {
+        s.merge(rows(&r2, &r5, &r4));
+        auto t = s.tail(s.lower_bound(101));
+        REQUIRE(t.size() == 3);
+        REQUIRE(t[0].id() == 5);
+        REQUIRE(t[1].id() == 3);
+        REQUIRE(t[2].id() == 2);
+        REQUIRE(t.lower_bound(102) == 1);
+    }
 }
 
 TEST_CASE("rectangle set rev vertical", "[basic][rectangle]")
@@ -200,8 +260,27 @@ TEST_CASE("rectangle set rev vertical", "[basic][rectangle]")
     std::vector v { &r1, &r2 };
     auto        s = nitro::sorted<nitro::rev_vertical>(v);
     REQUIRE(s.size() == 2);
-    REQUIRE((*s.begin())->id() == 2);
-    REQUIRE((*std::next(s.begin()))->id() == 1);
+    REQUIRE(s[0].id() == 2);
+    REQUIRE(s[1].id() == 1);
+}
+
+TEST_CASE("rectangle set rev vertical by top edge", "[basic][rectangle]")
+{
+    using nr = nitro::rectangle;
+
+    // r1's top edge is above r2's although r2 starts higher
+    nr r1 { { 0, 0 }, { 5, 10 }, id(1) };
+    nr r2 { { 0, 3 }, { 5, 5 }, id(2) };
+
+    const nitro::rev_vertical_sort ord;
+    REQUIRE(ord.compare(r1, r2) == std::strong_ordering::less);
+    REQUIRE(ord.compare(r2, r1) == std::strong_ordering::greater);
+
+    std::vector v { &r2, &r1 };
+    auto        s = nitro::sorted<nitro::rev_vertical>(v);
+    REQUIRE(s.size() == 2);
+    REQUIRE(s[0].id() == 1);
+    REQUIRE(s[1].id() == 2);
 }
 
 TEST_CASE("rectangle set rev horizintal", "[basic][rectangle]")
@@ -214,8 +293,8 @@ TEST_CASE("rectangle set rev horizintal", "[basic][rectangle]")
     std::vector v { &r1, &r2 };
     auto        s = nitro::sorted<nitro::rev_horizontal>(v);
     REQUIRE(s.size() == 2);
-    REQUIRE((*s.begin())->id() == 2);
-    REQUIRE((*std::next(s.begin()))->id() == 1);
+    REQUIRE(s[0].id() == 2);
+    REQUIRE(s[1].id() == 1);
 }
 
 TEST_CASE("rectangle intersection", "[intesection][rectangle]")
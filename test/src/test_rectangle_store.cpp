@@ -0,0 +1,168 @@
+#include <catch2/catch.hpp>
+
+#include "test_utils.hpp"
+
+#include <nitro/io.hpp>
+#include <nitro/partition_tree.hpp>
+#include <nitro/rectangle_store.hpp>
+
+#include <array>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+using namespace nitro;
+
+TEST_CASE("rectangle store rows", "[rectangle_store]")
+{
+    rectangle_store store;
+    REQUIRE(store.empty());
+    REQUIRE(store.push_back({ 1, 2 }, { 3, 4 }, 7) == 0);
+    REQUIRE(store.push_back(rectangle { { 5, 6 }, { 7, 8 }, id(8) }) == 1);
+    REQUIRE(store.push_back({ 2, 3 }, { 1, 1 }, 7, 0) == 2);
+    REQUIRE(store.size() == 3);
+
+    SECTION("columns")
+    {
+        REQUIRE(rng::equal(store.xs(), std::array<coordinate_t, 3> { 1, 5, 2 }));
+        REQUIRE(rng::equal(store.ys(), std::array<coordinate_t, 3> { 2, 6, 3 }));
+        REQUIRE(rng::equal(store.origins(axis::x), store.xs()));
+        REQUIRE(rng::equal(store.extents(axis::y), store.heights()));
+        REQUIRE(std::is_eq(store.rect(1) <=> rectangle { { 5, 6 }, { 7, 8 }, id(8) }));
+    }
+    SECTION("roots")
+    {
+        REQUIRE(store.parent(0) == rectangle_store::no_parent);
+        REQUIRE(store.root(0) == 0);
+        REQUIRE(store.root(1) == 1);
+        REQUIRE(store.root(2) == 0);
+    }
+    SECTION("permute and append")
+    {
+        const std::vector<rectangle_store::index_t> order { 2, 0, 1 };
+        store.permute(order);
+        REQUIRE(rng::equal(store.ids(), std::array<std::size_t, 3> { 7, 7, 8 }));
+        REQUIRE(store.parent(0) == 0);
+
+        rectangle_store other;
+        other.append(store, 1, 3);
+        other.append(store, 0);
+        REQUIRE(rng::equal(other.xs(), std::array<coordinate_t, 3> { 1, 5, 2 }));
+    }
+    SECTION("append columns")
+    {
+        const std::array<coordinate_t, 2> xs { 10, 11 }, ys { 20, 21 }, ws { 1, 2 }, hs { 3, 4 };
+        store.append(xs, ys, ws, hs);
+        REQUIRE(store.size() == 5);
+        REQUIRE(std::is_eq(store.rect(4) <=> rectangle { { 11, 21 }, { 2, 4 }, id(5) }));
+        REQUIRE(store.root(4) == 4);
+
+        const std::array<std::size_t, 2> ids { 40, 41 };
+        store.append(xs, ys, ws, hs, ids);
+        REQUIRE(store.id(6) == 41);
+
+        const std::array<coordinate_t, 2> bad { 1, 0 };
+        REQUIRE_THROWS_AS(store.append(xs, ys, ws, bad), invalid_arg);
+        REQUIRE(store.size() == 7);
+    }
+    SECTION("invalid extent")
+    {
+        REQUIRE_THROWS_AS(store.push_back({ 0, 0 }, { 0, 1 }, 9), invalid_arg);
+        REQUIRE_THROWS_AS(store.push_back({ 0, 0 }, { 1, -1 }, 9), invalid_arg);
+        REQUIRE(store.size() == 3);
+    }
+}
+
+TEST_CASE("rectangle store parsing", "[rectangle_store][io]")
+{
+    const auto input = R"-(
+        {
+"rects": [
+{"x": 100, "y": 100, "w": 250, "h": 80 },
+{"x": 120, "y": 200, "w": 250, "h": 150 },
+{"x": 140, "y": 160, "w": 250, "h": 100 },
+{"x": 160, "y": 140, "w": 350, "h": 190 }
+]
+}
+    )-"_json;
+
+    const auto store = to_rectangle_store(input);
+    const auto rects = to_rectangles(input);
+    REQUIRE(store.size() == rects.size());
+    std::size_t i = 0;
+    for (const auto& r : rects) {
+        REQUIRE(std::is_eq(store.rect(i) <=> r));
+        REQUIRE(store.root(i) == i);
+        ++i;
+    }
+    REQUIRE(to_rectangle_store(input, 2).size() == 2);
+
+    partition_tree from_store(to_rectangle_store(input));
+    partition_tree from_list(to_rectangles(input));
+    REQUIRE(from_store.intersections().size() == 7);
+    REQUIRE(rng::equal(from_store.intersections(), from_list.intersections(),
+        [](auto const& lhs, auto const& rhs) {
+            return rng::equal(lhs.constituents(), rhs.constituents(), {},
+                partition_tree::intersection::to_id(), partition_tree::intersection::to_id());
+        }));
+}
+
+TEST_CASE("streaming rectangle store parsing", "[rectangle_store][io]")
+{
+    const std::string text = R"-(
+{
+"name": "sample", "meta": { "rects": 3, "list": [1, {"x": 0}] },
+"rects": [
+{"x": 100, "y": 100, "w": 250, "h": 80, "tag": "first" },
+{"h": 150, "x": 120, "y": 200, "w": 250, "extra": [{"x": -1}, [2]] },
+{"x": 140, "y": 160.0, "w": 250, "h": 100 },
+{"x": -160, "y": 140, "w": 350, "h": 190 }
+],
+"after": null
+}
+)-";
+
+    const auto store = read_rectangle_store(std::string_view(text));
+    const auto dom   = to_rectangle_store(nlohmann::json::parse(text));
+    REQUIRE(store.size() == 4);
+    for (std::size_t i = 0; i < dom.size(); ++i) {
+        REQUIRE(std::is_eq(store.rect(i) <=> dom.rect(i)));
+        REQUIRE(store.root(i) == i);
+    }
+
+    std::istringstream is(text);
+    REQUIRE(rng::equal(read_rectangle_store(is).xs(), store.xs()));
+    REQUIRE(read_rectangle_store(std::string_view(text), 2).size() == 2);
+    REQUIRE(rng::equal(to_rectangles(store), to_rectangles(nlohmann::json::parse(text)),
+        [](auto const& lhs, auto const& rhs) { return std::is_eq(lhs <=> rhs); }));
+
+    SECTION("invalid input")
+    {
+        for (std::string_view bad : { R"-({})-", R"-([])-", R"-({"rects": {}})-",
+                 R"-({"rects": 1})-", R"-({"rects": [1]})-", R"-({"rects": [[]]})-",
+                 R"-({"rects": [{"x": 1, "y": 1, "w": 1}]})-",
+                 R"-({"rects": [{"x": "1", "y": 1, "w": 1, "h": 1}]})-",
+                 R"-({"rects": [{"x": 1, "y": 1, "w": 0, "h": 1}]})-",
+                 R"-({"rects": [{"x": 1, "y": 1, "w": 1, "h": 1})-" }) {
+            REQUIRE_THROWS_AS(read_rectangle_store(bad), invalid_arg);
+        }
+    }
+    SECTION("coordinates that aren't 64 bit integers")
+    {
+        for (std::string_view bad : { R"-({"rects": [{"x": 1.5, "y": 1, "w": 1, "h": 1}]})-",
+                 R"-({"rects": [{"x": 1, "y": -0.25, "w": 1, "h": 1}]})-",
+                 R"-({"rects": [{"x": 1, "y": 1, "w": 1e30, "h": 1}]})-",
+                 R"-({"rects": [{"x": 1, "y": 1, "w": 1, "h": 9223372036854775808}]})-" }) {
+            REQUIRE_THROWS_WITH(
+                read_rectangle_store(bad), "rectangle coordinates must be 64 bit integers");
+        }
+        // fractions elsewhere aren't coordinates
+        const auto ok = read_rectangle_store(
+            std::string_view(R"-({"scale": 0.5, "rects": [{"x": 2.0, "y": -3e0, "w": 1, "h": 1,
+                "weight": 0.1}]})-"));
+        REQUIRE(ok.size() == 1);
+        REQUIRE(ok.rect(0).origin() == point { 2, -3 });
+    }
+}
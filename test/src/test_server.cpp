@@ -0,0 +1,222 @@
+#include <catch2/catch.hpp>
+
+#include "test_utils.hpp"
+
+#include <nitro/binary_io.hpp>
+#include <nitro/io.hpp>
+#include <nitro/partition_tree.hpp>
+#include <nitro/rectangle_store.hpp>
+#include <nitro/server.hpp>
+#include <nitro/text_writer.hpp>
+
+#include <filesystem>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include <unistd.h>
+
+using namespace nitro;
+
+namespace {
+std::filesystem::path socket_path()
+{
+    return std::filesystem::temp_directory_path()
+        / ("nitro_test_" + std::to_string(::getpid()) + ".sock");
+}
+
+// what nitro_app prints of the intersections
+std::string expected_text(rectangle_store const& rects)
+{
+    const partition_tree pt(rects);
+    const auto           areas = partition_tree::calculate_all(pt.intersections());
+    std::ostringstream   os;
+    {
+        text_writer w(os);
+        write_intersections(w, pt.intersections(), areas);
+    }
+    return os.str();
+}
+
+std::string binary_of(rectangle_store const& rects)
+{
+    std::ostringstream os;
+    write_binary_rectangles(os, rects);
+    return os.str();
+}
+
+// pairs of overlapping rectangles in a row, which build at once but whose answer is several
+// times what a socket buffers
+rectangle_store overlapping_pairs(std::size_t pairs)
+{
+    rectangle_store rects;
+    for (std::size_t i = 0; i < pairs; ++i) {
+        const auto x = static_cast<coordinate_t>(10 * i);
+        rects.push_back({ x, 0 }, { 4, 4 }, 2 * i + 1);
+        rects.push_back({ x + 2, 2 }, { 4, 4 }, 2 * i + 2);
+    }
+    return rects;
+}
+}
+
+TEST_CASE("server answers", "[server]")
+{
+    const auto   path = socket_path();
+    server       srv(path, { .workers = 2 });
+    std::jthread runner([&](std::stop_token stop) { srv.run(stop); });
+    client       c(path);
+
+    const std::string json = R"-(
+        {
+"rects": [
+{"x": 100, "y": 100, "w": 250, "h": 80 },
+{"x": 120, "y": 200, "w": 250, "h": 150 },
+{"x": 140, "y": 160, "w": 250, "h": 100 },
+{"x": 160, "y": 140, "w": 350, "h": 190 }
+]
+}
+    )-";
+
+    SECTION("JSON")
+    {
+        c.send(std::as_bytes(std::span(json)), input_format::json);
+        const auto answer = c.receive();
+        REQUIRE(answer.status == response_status::ok);
+        REQUIRE(answer.text == expected_text(read_rectangle_store(std::string_view(json))));
+    }
+    SECTION("pipelined requests in order, binary and JSON")
+    {
+        std::mt19937                                gen(11);
+        std::uniform_int_distribution<coordinate_t> pos(-1000, 1000), len(1, 400);
+        std::vector<rectangle_store>                inputs(5);
+        for (auto& rects : inputs) {
+            for (std::size_t i = 1; i <= 200; ++i)
+                rects.push_back({ pos(gen), pos(gen) }, { len(gen), len(gen) }, i);
+        }
+        for (const auto& rects : inputs) {
+            const auto bytes = binary_of(rects);
+            c.send(std::as_bytes(std::span(bytes)), input_format::binary);
+        }
+        c.send(std::as_bytes(std::span(json)), input_format::json);
+        for (const auto& rects : inputs) {
+            const auto answer = c.receive();
+            REQUIRE(answer.status == response_status::ok);
+            REQUIRE(answer.text == expected_text(rects));
+        }
+        REQUIRE(c.receive().status == response_status::ok);
+    }
+    SECTION("bad requests keep the connection")
+    {
+        const std::string broken = R"({"rects": [{"x": 1, "y": 2}]})";
+        c.send(std::as_bytes(std::span(broken)), input_format::json);
+        c.send(std::as_bytes(std::span(json)), input_format::binary);
+        c.send(std::as_bytes(std::span(json)), input_format { 7 });
+        for (int i = 0; i < 3; ++i) {
+            const auto answer = c.receive();
+            REQUIRE(answer.status == response_status::invalid);
+            REQUIRE(!answer.text.empty());
+        }
+        c.send(std::as_bytes(std::span(json)), input_format::json);
+        REQUIRE(c.receive().status == response_status::ok);
+    }
+    SECTION("connections at once")
+    {
+        client other(path);
+        other.send(std::as_bytes(std::span(json)), input_format::json);
+        c.send(std::as_bytes(std::span(json)), input_format::json);
+        REQUIRE(c.receive().text == other.receive().text);
+    }
+}
+
+TEST_CASE("server request size", "[server]")
+{
+    // rectangles side by side, an input of several read chunks which builds at once
+    rectangle_store rects;
+    for (std::size_t i = 1; i <= 5000; ++i)
+        rects.push_back({ static_cast<coordinate_t>(2 * i), 0 }, { 3, 3 }, i);
+    const auto bytes = binary_of(rects);
+
+    const auto   path = socket_path();
+    server       srv(path, { .max_request_bytes = bytes.size() });
+    std::jthread runner([&](std::stop_token stop) { srv.run(stop); });
+    client       c(path);
+
+    c.send(std::as_bytes(std::span(bytes)), input_format::binary);
+    const auto answer = c.receive();
+    REQUIRE(answer.status == response_status::ok);
+    REQUIRE(answer.text == expected_text(rects));
+
+    const auto longer = bytes + ' ';
+    c.send(std::as_bytes(std::span(longer)), input_format::binary);
+    REQUIRE(c.receive().status == response_status::invalid);
+}
+
+TEST_CASE("server answers larger than the socket buffer", "[server]")
+{
+    const auto   rects = overlapping_pairs(20000);
+    const auto   bytes = binary_of(rects);
+    const auto   path  = socket_path();
+    server       srv(path);
+    std::jthread runner([&](std::stop_token stop) { srv.run(stop); });
+    client       c(path);
+
+    // the server writes the first answer while the second request is sent
+    for (int i = 0; i < 3; ++i)
+        c.send(std::as_bytes(std::span(bytes)), input_format::binary);
+    const auto expected = expected_text(rects);
+    REQUIRE(expected.size() > (std::size_t { 1 } << 20));
+    for (int i = 0; i < 3; ++i) {
+        const auto answer = c.receive();
+        REQUIRE(answer.status == response_status::ok);
+        REQUIRE(answer.text == expected);
+    }
+}
+
+TEST_CASE("server stops while a client doesn't read", "[server]")
+{
+    const auto bytes = binary_of(overlapping_pairs(20000));
+    const auto path  = socket_path();
+    server     srv(path);
+    client     c(path);
+    {
+        std::jthread runner([&](std::stop_token stop) { srv.run(stop); });
+        c.send(std::as_bytes(std::span(bytes)), input_format::binary);
+        // most likely until the answer filled the socket and the worker waits to write the rest
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    }
+    // run returned, the server closed the connection in the middle of the answer, or, on a slow
+    // build, cancelled it before there was one
+    auto status = response_status::cancelled;
+    try {
+        status = c.receive().status;
+    } catch (const std::runtime_error&) {
+    }
+    REQUIRE(status == response_status::cancelled);
+}
+
+TEST_CASE("server timeout and stop", "[server][slow]")
+{
+    const auto   path = socket_path();
+    server       srv(path);
+    std::jthread runner([&](std::stop_token stop) { srv.run(stop); });
+    client       c(path);
+
+    // a lot of overlap, which takes the tree well over a second
+    std::mt19937                                gen(3);
+    std::uniform_int_distribution<coordinate_t> pos(0, 2000), len(500, 2000);
+    rectangle_store                             rects;
+    for (std::size_t i = 1; i <= 3000; ++i)
+        rects.push_back({ pos(gen), pos(gen) }, { len(gen), len(gen) }, i);
+    const auto bytes = binary_of(rects);
+
+    c.send(std::as_bytes(std::span(bytes)), input_format::binary, 1);
+    const auto answer = c.receive();
+    REQUIRE(answer.status == response_status::timeout);
+
+    // a build in progress is cancelled when the server stops
+    c.send(std::as_bytes(std::span(bytes)), input_format::binary, 600);
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    runner.request_stop();
+    REQUIRE(c.receive().status == response_status::cancelled);
+}
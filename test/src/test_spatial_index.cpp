@@ -0,0 +1,128 @@
+#include <catch2/catch.hpp>
+
+#include <nitro/partition_tree.hpp>
+#include <nitro/rectangle_store.hpp>
+#include <nitro/spatial_index.hpp>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+using namespace nitro;
+
+namespace {
+using index_t = spatial_index::index_t;
+
+std::vector<index_t> covering(rectangle_store const& rows, point p)
+{
+    std::vector<index_t> found;
+    for (std::size_t i = 0; i < rows.size(); ++i) {
+        if (rows.x(i) <= p.x && p.x < rows.x(i) + rows.width(i) && rows.y(i) <= p.y
+            && p.y < rows.y(i) + rows.height(i)) {
+            found.push_back(static_cast<index_t>(i));
+        }
+    }
+    return found;
+}
+
+std::vector<index_t> overlapping(rectangle_store const& rows, rectangle const& w)
+{
+    std::vector<index_t> found;
+    for (std::size_t i = 0; i < rows.size(); ++i) {
+        if (rows.x(i) < w.origin().x + w.width() && w.origin().x < rows.x(i) + rows.width(i)
+            && rows.y(i) < w.origin().y + w.height() && w.origin().y < rows.y(i) + rows.height(i)) {
+            found.push_back(static_cast<index_t>(i));
+        }
+    }
+    return found;
+}
+
+template <typename Found> std::vector<index_t> to_vector(Found const& found)
+{
+    return { found.begin(), found.end() };
+}
+}
+
+TEST_CASE("spatial index queries", "[spatial_index]")
+{
+    std::mt19937                                gen(5);
+    std::uniform_int_distribution<coordinate_t> pos(-500, 500), len(1, 120);
+    std::pmr::vector<index_t>                   found;
+
+    SECTION("empty and single row")
+    {
+        const spatial_index none { rectangle_store {} };
+        none.covering({ 0, 0 }, found);
+        REQUIRE(found.empty());
+        REQUIRE(none.covering(std::vector<point> { { 0, 0 } }).size() == 1);
+        REQUIRE(none.covering(std::vector<point> { { 0, 0 } })[0].empty());
+
+        rectangle_store one;
+        one.push_back({ 10, 10 }, { 5, 5 }, 1);
+        const spatial_index single(one);
+        single.covering({ 10, 10 }, found);
+        REQUIRE(to_vector(found) == std::vector<index_t> { 0 });
+        // the edges right and above don't cover
+        single.covering({ 15, 12 }, found);
+        REQUIRE(found.empty());
+        single.overlapping(rectangle { { 15, 10 }, { 5, 5 } }, found);
+        REQUIRE(found.empty());
+        single.overlapping(rectangle { { 14, 14 }, { 5, 5 } }, found);
+        REQUIRE(to_vector(found) == std::vector<index_t> { 0 });
+    }
+    SECTION("random rows as brute force finds them, one at a time and batched")
+    {
+        for (const std::size_t n : { 7, 16, 17, 300, 2000 }) {
+            rectangle_store rows;
+            for (std::size_t i = 1; i <= n; ++i)
+                rows.push_back({ pos(gen), pos(gen) }, { len(gen), len(gen) }, i);
+            const spatial_index index(rows);
+            REQUIRE(index.size() == n);
+
+            std::vector<point> points;
+            rectangle_store    windows;
+            for (std::size_t i = 0; i < 200; ++i) {
+                points.push_back({ pos(gen), pos(gen) });
+                windows.push_back({ pos(gen), pos(gen) }, { len(gen), len(gen) }, i + 1);
+            }
+            // the corners of the rows themselves
+            for (std::size_t i = 0; i < std::min<std::size_t>(n, 50); ++i) {
+                points.push_back({ rows.x(i), rows.y(i) });
+                points.push_back({ rows.x(i) + rows.width(i), rows.y(i) + rows.height(i) });
+            }
+
+            const auto by_point = index.covering(points);
+            REQUIRE(by_point.size() == points.size());
+            for (std::size_t q = 0; q < points.size(); ++q) {
+                const auto expected = covering(rows, points[q]);
+                index.covering(points[q], found);
+                REQUIRE(to_vector(found) == expected);
+                REQUIRE(to_vector(by_point[q]) == expected);
+            }
+            const auto by_window = index.overlapping(windows);
+            REQUIRE(by_window.size() == windows.size());
+            for (std::size_t q = 0; q < windows.size(); ++q) {
+                const auto expected = overlapping(rows, windows.rect(q));
+                index.overlapping(windows.rect(q), found);
+                REQUIRE(to_vector(found) == expected);
+                REQUIRE(to_vector(by_window[q]) == expected);
+            }
+        }
+    }
+    SECTION("intersection areas of a tree")
+    {
+        rectangle_store rects;
+        for (std::size_t i = 1; i <= 150; ++i)
+            rects.push_back({ pos(gen), pos(gen) }, { len(gen), len(gen) }, i);
+        const partition_tree pt(rects);
+        const auto           areas = partition_tree::calculate_all(pt.intersections());
+        REQUIRE(areas.size() > 0);
+        const spatial_index index(areas);
+        for (std::size_t i = 0; i < areas.size(); ++i) {
+            const point corner { areas.x(i), areas.y(i) };
+            index.covering(corner, found);
+            REQUIRE(to_vector(found) == covering(areas, corner));
+            REQUIRE(rng::binary_search(found, static_cast<index_t>(i)));
+        }
+    }
+}
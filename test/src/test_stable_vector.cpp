@@ -0,0 +1,99 @@
+#include <catch2/catch.hpp>
+
+#include "test_utils.hpp"
+
+#include <nitro/rectangle.hpp>
+#include <nitro/stable_vector.hpp>
+
+#include <memory_resource>
+#include <string>
+#include <vector>
+
+using namespace nitro;
+
+namespace {
+struct counting_resource : std::pmr::memory_resource {
+    std::size_t allocations {};
+    std::size_t live {};
+
+private:
+    void* do_allocate(std::size_t bytes, std::size_t align) override
+    {
+        ++allocations;
+        ++live;
+        return std::pmr::new_delete_resource()->allocate(bytes, align);
+    }
+    void do_deallocate(void* p, std::size_t bytes, std::size_t align) override
+    {
+        --live;
+        std::pmr::new_delete_resource()->deallocate(p, bytes, align);
+    }
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+    {
+        return this == &other;
+    }
+};
+}
+
+TEST_CASE("stable vector", "[stable_vector]")
+{
+    counting_resource             res;
+    stable_vector<rectangle, 4>   rects(&res);
+    std::vector<rectangle const*> addresses;
+    for (coordinate_t i = 0; i < 10; ++i)
+        addresses.push_back(&rects.emplace_back(point { i, i }, point { 1, 1 }, id(i)));
+
+    SECTION("elements never move")
+    {
+        REQUIRE(rects.size() == 10);
+        REQUIRE(rects.capacity() == 12);
+        for (std::size_t i = 0; i < rects.size(); ++i) {
+            REQUIRE(&rects[i] == addresses[i]);
+            REQUIRE(rects[i].id() == i);
+        }
+        REQUIRE(rng::equal(rects | views::transform(address_of_f {}), addresses));
+        REQUIRE(rects.end() - rects.begin() == 10);
+        REQUIRE(rng::prev(rects.end())->id() == 9);
+        REQUIRE(rects.front().id() == 0);
+        REQUIRE(rects.back().id() == 9);
+    }
+    SECTION("one allocation per chunk, all given back on clear")
+    {
+        // three chunks and the table pointing at them
+        REQUIRE(res.live == 3 + 1);
+        rects.clear();
+        REQUIRE(rects.empty());
+        REQUIRE(res.live == 1);
+        res.allocations = 0;
+        rects.reserve(8);
+        for (coordinate_t i = 0; i < 8; ++i)
+            rects.emplace_back(point { i, i }, point { 1, 1 }, id(i));
+        REQUIRE(res.allocations == 2);
+    }
+    SECTION("copy and move")
+    {
+        counting_resource other_res;
+        const auto        copy = stable_vector<rectangle, 4>(rects, &other_res);
+        REQUIRE(copy.get_allocator().resource() == &other_res);
+        REQUIRE(rng::equal(
+            copy, rects, [](auto const& l, auto const& r) { return std::is_eq(l <=> r); }));
+
+        stable_vector<rectangle, 4> same(&res);
+        same = std::move(rects);
+        REQUIRE(rects.empty());
+        REQUIRE(&same[3] == addresses[3]);
+
+        stable_vector<rectangle, 4> other(&other_res);
+        other = std::move(same);
+        REQUIRE(same.empty());
+        REQUIRE(other.size() == 10);
+        REQUIRE(other[7].id() == 7);
+        REQUIRE(res.live == 1);
+    }
+    SECTION("initializer list")
+    {
+        const stable_vector<std::string, 2> strings { "a", "b", "c" };
+        REQUIRE(strings.size() == 3);
+        REQUIRE(rng::equal(strings, std::vector<std::string> { "a", "b", "c" }));
+    }
+}
@@ -0,0 +1,152 @@
+#include <catch2/catch.hpp>
+
+#include "nitro/fwd.hpp"
+#include "nitro/memory_resource.hpp"
+#include "nitro/rectangle.hpp"
+#include "test_utils.hpp"
+
+#include <algorithm>
+#include <nitro/io.hpp>
+#include <nitro/partition_tree.hpp>
+#include <nitro/sweep_line.hpp>
+#include <set>
+#include <stop_token>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+using namespace nitro;
+
+namespace {
+auto id_sets(partition_tree::intersection_set const& isecs)
+{
+    std::vector<std::vector<std::size_t>> out;
+    for (const auto& i : isecs) {
+        auto& ids = out.emplace_back();
+        rng::transform(i.constituents(), std::back_inserter(ids), [](auto p) { return p->id(); });
+    }
+    return out;
+}
+}
+
+TEST_CASE("sweep line example", "[sweep_line]")
+{
+    const auto input = R"-(
+        {
+"rects": [
+{"x": 100, "y": 100, "w": 250, "h": 80 },
+{"x": 120, "y": 200, "w": 250, "h": 150 },
+{"x": 140, "y": 160, "w": 250, "h": 100 },
+{"x": 160, "y": 140, "w": 350, "h": 190 }
+]
+}
+    )-"_json;
+
+    sweep_line     sl(to_rectangles(input));
+    partition_tree pt(to_rectangles(input));
+    REQUIRE(sl.intersections().size() == 7);
+    REQUIRE(id_sets(sl.intersections()) == id_sets(pt.intersections()));
+    for (auto [s, p] = std::pair { sl.intersections().begin(), pt.intersections().begin() };
+         s != sl.intersections().end(); ++s, ++p) {
+        REQUIRE(std::is_eq(s->calculate() <=> p->calculate()));
+    }
+}
+
+TEST_CASE("sweep line concentrical rectangles", "[sweep_line]")
+{
+    SECTION("3 rects")
+    {
+        sweep_line sl(get_concentric_rectangles(3));
+        REQUIRE(sl.intersections().size() == 2);
+        check_concentric_rectangles(3, sl.intersections());
+    }
+    SECTION("200 rects")
+    {
+        sweep_line sl(get_concentric_rectangles(200));
+        check_concentric_rectangles(200, sl.intersections());
+    }
+    SECTION("1000 rects")
+    {
+        sweep_line sl(get_concentric_rectangles(1000));
+        check_concentric_rectangles(1000, sl.intersections());
+    }
+    SECTION("100 rects same extent")
+    {
+        rectangles_list rects;
+        std::generate_n(std::back_inserter(rects), 100, [idd = 1]() mutable {
+            return rectangle { { 100, 100 }, { 100, 100 }, id(idd++) };
+        });
+        sweep_line sl(std::move(rects));
+        REQUIRE(sl.intersections().size() == 1);
+        REQUIRE(sl.intersections().begin()->constituents().size() == 100);
+    }
+}
+
+TEST_CASE("sweep line edge cases", "[sweep_line]")
+{
+    using nr = nitro::rectangle;
+    SECTION("empty input") { REQUIRE(sweep_line(rectangles_list {}).intersections().empty()); }
+    SECTION("touching edges do not intersect")
+    {
+        sweep_line sl(rectangles_list { nr { { 0, 0 }, { 10, 10 }, id(1) },
+            nr { { 10, 0 }, { 10, 10 }, id(2) }, nr { { 0, 10 }, { 10, 10 }, id(3) } });
+        REQUIRE(sl.intersections().empty());
+    }
+    SECTION("disjoint rectangles on the same column")
+    {
+        sweep_line sl(rectangles_list { nr { { 0, 0 }, { 1, 1 }, id(1) },
+            nr { { 0, 5 }, { 1, 1 }, id(2) } });
+        REQUIRE(sl.intersections().empty());
+    }    SECTION("shared edges and rectangles replacing each other at the same x")
+    {
+        // 2 closes where 3 and 4 open, 4 on the y range of 2, 5 sharing edges with all of them
+        const rectangles_list rects { nr { { 0, 0 }, { 30, 10 }, id(1) },
+            nr { { 5, 0 }, { 10, 10 }, id(2) }, nr { { 15, 5 }, { 10, 5 }, id(3) },
+            nr { { 15, 0 }, { 10, 10 }, id(4) }, nr { { 5, 0 }, { 20, 5 }, id(5) } };
+        sweep_line sl(rects);
+        const auto ids = id_sets(sl.intersections());
+        REQUIRE(std::set(ids.begin(), ids.end()) == brute_force_id_sets(rects));
+    }
+}
+
+TEST_CASE("sweep line cancellation", "[sweep_line]")
+{
+    std::stop_source stop;
+    stop.request_stop();
+    REQUIRE_THROWS_AS(sweep_line(random_rectangles(30, 100, 1), {},
+                          std::pmr::get_default_resource(), stop.get_token()),
+        nitro::cancelled);
+    REQUIRE_THROWS_AS(sweep_line(random_rectangles(30, 100, 1), sweep_line::secs { 0 }),
+        nitro::timeout);
+}
+
+TEST_CASE("sweep line random input", "[sweep_line]")
+{
+    // the small extent makes many rectangles share their edges
+    for (unsigned seed = 1; seed <= 20; ++seed) {
+        const auto rects = random_rectangles(30, seed % 2 == 0 ? 100 : 12, seed);
+        sweep_line sl(rects);
+        const auto ids = id_sets(sl.intersections());
+        INFO("seed " << seed);
+        REQUIRE(std::set(ids.begin(), ids.end()) == brute_force_id_sets(rects));
+    }
+}
+
+TEST_CASE("sweep line agrees with partition tree", "[sweep_line][partition_tree]")
+{
+    SECTION("random input")
+    {
+        for (unsigned seed = 1; seed <= 10; ++seed) {
+            const auto rects = random_rectangles(300, 1000, seed);
+            INFO("seed " << seed);
+            REQUIRE(found_id_sets(sweep_line(rects).intersections())
+                == found_id_sets(partition_tree(rects).intersections()));
+        }
+    }
+    SECTION("concentric rectangles")
+    {
+        const auto rects = get_concentric_rectangles(100);
+        REQUIRE(found_id_sets(sweep_line(rects).intersections())
+            == found_id_sets(partition_tree(rects).intersections()));
+    }
+}
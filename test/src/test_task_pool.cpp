@@ -0,0 +1,55 @@
+#include <catch2/catch.hpp>
+
+#include <atomic>
+#include <nitro/exceptions.hpp>
+#include <nitro/task_pool.hpp>
+
+using namespace nitro;
+
+namespace {
+void spawn_tree(task_pool& pool, int depth, std::atomic_int& count)
+{
+    ++count;
+    if (depth == 0)
+        return;
+    pool.push([&pool, depth, &count] { spawn_tree(pool, depth - 1, count); });
+    spawn_tree(pool, depth - 1, count);
+}
+}
+
+TEST_CASE("task pool", "[task_pool]")
+{
+    task_pool pool(4);
+    REQUIRE(pool.size() == 4);
+    REQUIRE_FALSE(pool.worker_index());
+
+    SECTION("runs nested tasks to completion")
+    {
+        std::atomic_int count {};
+        pool.run([&] { spawn_tree(pool, 10, count); });
+        REQUIRE(count == (1 << 11) - 1);
+        SECTION("and can be reused")
+        {
+            count = 0;
+            pool.run([&] { spawn_tree(pool, 4, count); });
+            REQUIRE(count == (1 << 5) - 1);
+        }
+    }
+    SECTION("tasks know their worker")
+    {
+        std::atomic_bool inside {};
+        pool.run([&] { inside = pool.worker_index() < pool.size(); });
+        REQUIRE(inside);
+    }
+    SECTION("first exception is rethrown")
+    {
+        REQUIRE_THROWS_AS(pool.run([&] {
+            pool.push([] { throw timeout("from a subtask"); });
+        }),
+            timeout);
+        REQUIRE(pool.cancelled());
+        std::atomic_int count {};
+        pool.run([&] { spawn_tree(pool, 2, count); });
+        REQUIRE(count == 7);
+    }
+}
@@ -0,0 +1,123 @@
+#include <catch2/catch.hpp>
+
+#include "test_utils.hpp"
+
+#include <nitro/io.hpp>
+#include <nitro/partition_tree.hpp>
+#include <nitro/rectangle_store.hpp>
+#include <nitro/text_writer.hpp>
+
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <string>
+
+#include <nlohmann/json.hpp>
+
+using namespace nitro;
+
+namespace {
+// the output as nitro_app wrote it through std::ostream before
+std::string streamed(rectangle_store const& rects, intersection_set const& intersections,
+    rectangle_store const& areas)
+{
+    std::ostringstream os;
+    os << "Input:\n";
+    for (std::size_t i = 0; i < rects.size(); ++i)
+        os << rects.rect(i) << '\n';
+    os << "\nIntersections\n";
+    std::size_t row = 0;
+    for (const auto& i : intersections) {
+        os << "    Between rectangle ";
+        const auto c = i.constituents();
+        for (auto it = c.begin(); it != c.end(); ++it) {
+            os << (*it)->id();
+            if (rng::next(it) != c.end())
+                os << (rng::next(it, 2) != c.end() ? ", " : " and ");
+        }
+        const auto r = areas.rect(row++);
+        os << " at " << r.origin() << ", w=" << r.width() << ", h=" << r.height() << ".\n";
+    }
+    return os.str();
+}
+
+std::string written(rectangle_store const& rects, intersection_set const& intersections,
+    rectangle_store const& areas, std::size_t capacity)
+{
+    std::ostringstream os;
+    {
+        text_writer w(os, capacity);
+        write_input(w, rects);
+        write_intersections(w, intersections, areas);
+    }
+    return os.str();
+}
+}
+
+TEST_CASE("text writer output", "[text_writer]")
+{
+    SECTION("the example")
+    {
+        const auto input = R"-(
+        {
+"rects": [
+{"x": 100, "y": 100, "w": 250, "h": 80 },
+{"x": 120, "y": 200, "w": 250, "h": 150 },
+{"x": 140, "y": 160, "w": 250, "h": 100 },
+{"x": 160, "y": 140, "w": 350, "h": 190 }
+]
+}
+    )-"_json;
+        const auto           rects = to_rectangle_store(input);
+        const partition_tree pt(rects);
+        const auto           areas = partition_tree::calculate_all(pt.intersections());
+        REQUIRE(written(rects, pt.intersections(), areas, text_writer::default_capacity)
+            == "Input:\n"
+               "    1: Rectangle at (100,100), w=250, h=80.\n"
+               "    2: Rectangle at (120,200), w=250, h=150.\n"
+               "    3: Rectangle at (140,160), w=250, h=100.\n"
+               "    4: Rectangle at (160,140), w=350, h=190.\n"
+               "\n"
+               "Intersections\n"
+               "    Between rectangle 1 and 3 at (140,160), w=210, h=20.\n"
+               "    Between rectangle 1 and 4 at (160,140), w=190, h=40.\n"
+               "    Between rectangle 2 and 3 at (140,200), w=230, h=60.\n"
+               "    Between rectangle 2 and 4 at (160,200), w=210, h=130.\n"
+               "    Between rectangle 3 and 4 at (160,160), w=230, h=100.\n"
+               "    Between rectangle 1, 3 and 4 at (160,160), w=190, h=20.\n"
+               "    Between rectangle 2, 3 and 4 at (160,200), w=210, h=60.\n");
+    }
+    SECTION("same as streamed, whatever the buffer size")
+    {
+        std::mt19937                                gen(7);
+        std::uniform_int_distribution<coordinate_t> pos(-1000, 1000), len(1, 400);
+        rectangle_store                             rects;
+        for (std::size_t i = 1; i <= 300; ++i)
+            rects.push_back({ pos(gen), pos(gen) }, { len(gen), len(gen) }, i);
+        const partition_tree pt(rects);
+        const auto           areas    = partition_tree::calculate_all(pt.intersections());
+        const auto           expected = streamed(rects, pt.intersections(), areas);
+        for (std::size_t capacity : { std::size_t { 1 }, std::size_t { 100 }, std::size_t { 4096 },
+                 text_writer::default_capacity }) {
+            INFO("capacity " << capacity);
+            REQUIRE(written(rects, pt.intersections(), areas, capacity) == expected);
+        }
+    }
+}
+
+TEST_CASE("text writer numbers and strings", "[text_writer]")
+{
+    std::ostringstream os;
+    {
+        text_writer w(os, 64);
+        w << std::numeric_limits<std::int64_t>::min() << ' '
+          << std::numeric_limits<std::uint64_t>::max() << ' ' << point { -3, 0 } << ' '
+          << std::string(200, 'x');
+        w.flush();
+        REQUIRE(os.str().size() == 20 + 1 + 20 + 1 + 6 + 1 + 200);
+        w << "end";
+    }
+    REQUIRE(os.str()
+        == "-9223372036854775808 18446744073709551615 (-3,0) " + std::string(200, 'x') + "end");
+}
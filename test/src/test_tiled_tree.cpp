@@ -0,0 +1,125 @@
+#include <catch2/catch.hpp>
+
+#include <nitro/exceptions.hpp>
+#include <nitro/partition_tree.hpp>
+#include <nitro/rectangle_store.hpp>
+#include <nitro/tiled_tree.hpp>
+
+#include <random>
+#include <sstream>
+#include <vector>
+
+using namespace nitro;
+
+namespace {
+// the ids of every intersection, in set order
+std::vector<std::vector<std::size_t>> ids_of(intersection_set const& set)
+{
+    std::vector<std::vector<std::size_t>> result;
+    for (const auto isec : set) {
+        auto& ids = result.emplace_back();
+        for (const auto r : isec.constituents())
+            ids.push_back(r->id());
+    }
+    return result;
+}
+
+rectangle_store random_rects(std::mt19937& gen, std::size_t n, coordinate_t max_len)
+{
+    std::uniform_int_distribution<coordinate_t> pos(-300, 300), len(1, max_len);
+    rectangle_store                             rects;
+    for (std::size_t i = 1; i <= n; ++i)
+        rects.push_back({ pos(gen), pos(gen) }, { len(gen), len(gen) }, 3 * i);
+    return rects;
+}
+
+std::vector<tile_intersections> tile_files(rectangle_store const& rects, tile_grid const& grid)
+{
+    std::vector<tile_intersections> parts;
+    for (std::size_t i = 0; i < grid.size(); ++i) {
+        std::stringstream ss;
+        write_tile_intersections(ss, build_tile(rects, grid, i));
+        parts.push_back(read_tile_intersections(ss));
+    }
+    return parts;
+}
+}
+
+TEST_CASE("tile grid and clipping", "[tiled_tree]")
+{
+    rectangle_store rects;
+    rects.push_back({ 0, 0 }, { 10, 10 }, 1);
+    rects.push_back({ 5, 5 }, { 20, 10 }, 2);
+    rects.push_back({ 30, 0 }, { 10, 30 }, 3);
+
+    SECTION("the tiles cover the bounding box")
+    {
+        const tile_grid grid(rects, 2, 3);
+        REQUIRE(grid.columns() == 2);
+        REQUIRE(grid.rows() == 3);
+        REQUIRE(grid[0].origin() == point { 0, 0 });
+        const auto last = grid[grid.size() - 1];
+        REQUIRE(last.origin().x + last.width() == 40);
+        REQUIRE(last.origin().y + last.height() == 30);
+    }
+    SECTION("cuts don't repeat")
+    {
+        rectangle_store same;
+        for (std::size_t i = 1; i <= 10; ++i)
+            same.push_back({ 0, 0 }, { 4, 4 }, i);
+        const tile_grid grid(same, 8, 8);
+        REQUIRE(grid.size() == 4);
+        REQUIRE(tile_grid(rectangle_store {}, 4, 4).size() == 1);
+        REQUIRE(tile_grid::with_at_most(rects, 1).size() == 4);
+    }
+    SECTION("clipped rows keep their ids, touching edges don't count")
+    {
+        std::pmr::vector<rectangle_store::index_t> origins;
+        const auto clipped = clip(rects, rectangle { { 10, 0 }, { 20, 10 } }, origins);
+        REQUIRE(clipped.size() == 1);
+        REQUIRE(origins[0] == 1);
+        REQUIRE(clipped.id(0) == 2);
+        REQUIRE(clipped.rect(0).origin() == point { 10, 5 });
+        REQUIRE(clipped.rect(0).extent() == point { 15, 5 });
+    }
+}
+
+TEST_CASE("tiled tree", "[tiled_tree]")
+{
+    std::mt19937 gen(17);
+
+    SECTION("the intersections of a single tree, however tiled")
+    {
+        for (const coordinate_t max_len : { 40, 150, 500 }) {
+            const auto           rects = random_rects(gen, 300, max_len);
+            const partition_tree pt(rects);
+            const auto           expected = ids_of(pt.intersections());
+            for (const std::size_t tiles : { 1, 2, 5 }) {
+                const tile_grid grid(rects, tiles, tiles + 1);
+                REQUIRE(ids_of(tiled_tree(rects, grid).intersections()) == expected);
+                REQUIRE(ids_of(tiled_tree(rects, grid, {}, 3).intersections()) == expected);
+                REQUIRE(ids_of(tiled_tree(rects, tile_files(rects, grid)).intersections())
+                    == expected);
+            }
+        }
+    }
+    SECTION("merging wants every tile once, of the same input")
+    {
+        const auto      rects = random_rects(gen, 100, 100);
+        const tile_grid grid(rects, 2, 2);
+        auto            parts = tile_files(rects, grid);
+        REQUIRE_THROWS_AS(tiled_tree(rects, std::span(parts).first(3)), invalid_arg);
+        parts[3] = build_tile(rects, grid, 2);
+        REQUIRE_THROWS_AS(tiled_tree(rects, parts), invalid_arg);
+        parts[3] = build_tile(rects, grid, 3);
+        REQUIRE_THROWS_AS(tiled_tree(random_rects(gen, 99, 100), parts), invalid_arg);
+        REQUIRE_THROWS_AS(build_tile(rects, grid, 4), invalid_arg);
+
+        std::stringstream ss;
+        write_tile_intersections(ss, parts[0]);
+        auto bytes = ss.str();
+        bytes.resize(bytes.size() - 4);
+        std::istringstream truncated(bytes);
+        REQUIRE_THROWS_AS(read_tile_intersections(truncated), invalid_arg);
+    }
+}
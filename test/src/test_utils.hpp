@@ -1,7 +1,14 @@
+#include <catch2/catch.hpp>
+
 #include <nitro/fwd.hpp>
+#include <nitro/partition_tree.hpp>
 #include <nitro/rectangle.hpp>
 #include <nitro/sorting_and_orientation.hpp>
 
+#include <algorithm>
+#include <iterator>
+#include <random>
+#include <set>
 #include <type_traits>
 #include <vector>
 
@@ -13,10 +20,96 @@ template <typename T> auto id(T t)
         return nitro::rectangle::identifier_t(t);
 }
 
-inline auto rect_vec(nitro::sorted_rectangles const& sr)
+template <typename Ordering> auto rect_vec(nitro::sorted_rectangles<Ordering> const& sr)
 {
     std::vector<nitro::rectangle> out;
-    for (auto p : sr)
-        out.push_back(*p);
+    for (std::size_t i = 0; i < sr.size(); ++i)
+        out.push_back(sr[i]);
     return out;
-}
\ No newline at end of file
+}
+
+inline auto get_concentric_rectangles(nitro::coordinate_t count)
+{
+
+    // innermost first
+    nitro::rectangles_list rects;
+    std::generate_n(
+        std::back_inserter(rects), count, [id = count, x = count - 1, y = 1]() mutable {
+            auto r = nitro::rectangle { { x, x }, { y, y },
+                nitro::rectangle::identifier_t(static_cast<size_t>(id--)) };
+            x -= 1;
+            y += 2;
+            return r;
+        });
+    return rects;
+}
+
+inline void check_concentric_rectangles(
+    nitro::coordinate_t count, nitro::partition_tree::intersection_set const& isecs)
+{
+    nitro::coordinate_t extent = 0;
+    REQUIRE(isecs.size() == count - 1);
+
+    for (auto it = isecs.rbegin(); it != isecs.rend(); ++it, --count) {
+        REQUIRE(it->constituents().size() == count);
+        auto rid = 1;
+        for (auto r : it->constituents()) {
+            REQUIRE(r->id() == rid);
+            rid++;
+        }
+        const auto rintersection = it->calculate();
+        REQUIRE(rintersection.origin() == nitro::point { count - 1, count - 1 });
+        REQUIRE(rintersection.extent() == nitro::point { 2 * extent + 1, 2 * extent + 1 });
+        ++extent;
+    }
+}
+inline auto random_rectangles(std::size_t count, nitro::coordinate_t extent, unsigned seed)
+{
+    std::mt19937                                       gen(seed);
+    std::uniform_int_distribution<nitro::coordinate_t> pos(0, extent);
+    std::uniform_int_distribution<nitro::coordinate_t> len(1, extent / 2);
+    nitro::rectangles_list                             rects;
+    for (std::size_t i = 1; i <= count; ++i) {
+        rects.push_back(nitro::rectangle { { pos(gen), pos(gen) }, { len(gen), len(gen) }, id(i) });
+    }
+    return rects;
+}
+
+// distinct covers of the cells of the grid spanned by all the rectangle edges
+inline auto brute_force_id_sets(nitro::rectangles_list const& rects)
+{
+    std::vector<nitro::coordinate_t> xs, ys;
+    for (const auto& r : rects) {
+        xs.insert(xs.end(), { r.origin().x, r.origin().x + r.width() });
+        ys.insert(ys.end(), { r.origin().y, r.origin().y + r.height() });
+    }
+    std::ranges::sort(xs);
+    std::ranges::sort(ys);
+    std::set<std::vector<std::size_t>> covers;
+    for (auto x = xs.begin(); std::next(x) != xs.end(); ++x) {
+        for (auto y = ys.begin(); std::next(y) != ys.end(); ++y) {
+            std::vector<std::size_t> ids;
+            for (const auto& r : rects) {
+                if (r.origin().x <= *x && *std::next(x) <= r.origin().x + r.width()
+                    && r.origin().y <= *y && *std::next(y) <= r.origin().y + r.height())
+                    ids.push_back(r.id());
+            }
+            if (*x != *std::next(x) && *y != *std::next(y) && ids.size() > 1)
+                covers.insert(ids);
+        }
+    }
+    return covers;
+}
+
+// the ids of the constituents of every intersection found, to compare with the above
+inline auto found_id_sets(nitro::partition_tree::intersection_set const& isecs)
+{
+    std::set<std::vector<std::size_t>> out;
+    for (const auto& i : isecs) {
+        std::vector<std::size_t> ids;
+        for (auto p : i.constituents())
+            ids.push_back(p->id());
+        out.insert(std::move(ids));
+    }
+    return out;
+}